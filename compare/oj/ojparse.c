@@ -1,8 +1,11 @@
 // Copyright (c) 2020 by Peter Ohler, ALL RIGHTS RESERVED
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include "oj/oj.h"
@@ -96,6 +99,20 @@ validate(const char *filename, long long iter) {
     }
 }
 
+// Validates the file a block at a time without loading it.
+static void
+validate_file(const char *filename, long long iter) {
+    int64_t		dt;
+    struct _ojErr	err = OJ_ERR_INIT;
+    int64_t		start = clock_micro();
+
+    for (int i = iter; 0 < i; i--) {
+	oj_validate_file(&err, filename);
+    }
+    dt = clock_micro() - start;
+    form_result(iter, dt, &err);
+}
+
 static void
 parse(const char *filename, long long iter) {
     int64_t		dt;
@@ -115,6 +132,91 @@ parse(const char *filename, long long iter) {
     }
 }
 
+// Parses the file from disk each iteration with the array split across
+// every core.
+static void
+parse_array(const char *filename, long long iter) {
+    int64_t		dt;
+    int64_t		start = clock_micro();
+    struct _ojReuser	r;
+    struct _ojErr	err = OJ_ERR_INIT;
+
+    for (int i = iter; 0 < i; i--) {
+	oj_parse_file_array(&err, filename, 0, &r);
+	oj_reuse(&r);
+    }
+    dt = clock_micro() - start;
+    form_result(iter, dt, &err);
+}
+
+static void
+parse_indexed(const char *filename, long long iter) {
+    int64_t		dt;
+    char		*buf = load_file(filename);
+    int64_t		start = clock_micro();
+    struct _ojReuser	r;
+    struct _ojErr	err = OJ_ERR_INIT;
+
+    for (int i = iter; 0 < i; i--) {
+	oj_parse_indexed(&err, buf, &r);
+	oj_reuse(&r);
+    }
+    dt = clock_micro() - start;
+    form_result(iter, dt, &err);
+    if (NULL != buf) {
+	free(buf);
+    }
+}
+
+static void
+parse_lazy(const char *filename, long long iter) {
+    oj_lazy_num = true;
+    parse(filename, iter);
+    oj_lazy_num = false;
+}
+
+// The buffer is modified by the parse so a fresh copy is made for each
+// iteration. The copy is included in the time.
+static void
+parse_insitu(const char *filename, long long iter) {
+    int64_t		dt;
+    char		*buf = load_file(filename);
+    size_t		len = strlen(buf) + 1;
+    char		*copy = (char*)malloc(len);
+    int64_t		start = clock_micro();
+    struct _ojReuser	r;
+    struct _ojErr	err = OJ_ERR_INIT;
+
+    for (int i = iter; 0 < i; i--) {
+	memcpy(copy, buf, len);
+	oj_parse_str_insitu(&err, copy, &r);
+	oj_reuse(&r);
+    }
+    dt = clock_micro() - start;
+    form_result(iter, dt, &err);
+    free(copy);
+    if (NULL != buf) {
+	free(buf);
+    }
+}
+
+static void
+parse_doc(const char *filename, long long iter) {
+    int64_t		dt;
+    char		*buf = load_file(filename);
+    int64_t		start = clock_micro();
+    struct _ojErr	err = OJ_ERR_INIT;
+
+    for (int i = iter; 0 < i; i--) {
+	oj_doc_destroy(oj_doc_parse(&err, buf));
+    }
+    dt = clock_micro() - start;
+    form_result(iter, dt, &err);
+    if (NULL != buf) {
+	free(buf);
+    }
+}
+
 typedef struct _cnt {
     long long	iter;
     int		depth;
@@ -184,6 +286,249 @@ parse_heavy(const char *filename, long long iter) {
     form_result(iter, dt, &err);
 }
 
+static ojCallbackOp
+parallel_cb(ojVal val, void *ctx) {
+    int64_t	done = clock_micro() + 8;
+
+    while (clock_micro() < done) {
+	continue;
+    }
+    walk(val);
+    atomic_fetch_add((atomic_llong*)ctx, 1);
+
+    return OJ_DESTROY;
+}
+
+// Same work as multiple-heavy but the callbacks are made from a pool with
+// a worker on each core but the parser's.
+static void
+parse_pool(const char *filename, long long iter) {
+    int64_t		dt;
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+    atomic_llong	cnt;
+
+    atomic_init(&cnt, 0);
+    oj_caller_start_pool(&err, &caller, 0, false, parallel_cb, &cnt);
+
+    int64_t	start = clock_micro();
+
+    oj_parse_file_call(&err, filename, &caller);
+    oj_caller_wait(&caller);
+    dt = clock_micro() - start;
+    form_result(atomic_load(&cnt), dt, &err);
+}
+
+// Same work as multiple-heavy but the documents are parsed and handled on
+// every core.
+static void
+parse_parallel(const char *filename, long long iter) {
+    int64_t		dt;
+    struct _ojErr	err = OJ_ERR_INIT;
+    atomic_llong	cnt;
+
+    atomic_init(&cnt, 0);
+
+    int64_t	start = clock_micro();
+
+    oj_parse_file_parallel(&err, filename, 0, false, parallel_cb, &cnt);
+    dt = clock_micro() - start;
+    form_result(atomic_load(&cnt), dt, &err);
+}
+
+#define INGEST_WRITERS	4
+
+typedef struct _ingest {
+    const char		**starts;	// part of the file for each connection
+    const char		**ends;
+    int			*wds;
+    int			cnt;
+    atomic_llong	docs;
+    atomic_int		ended;
+    struct _ojErr	err;
+} *Ingest;
+
+typedef struct _writer {
+    Ingest		ing;
+    int			first;
+} *Writer;
+
+static ojCallbackOp
+ingest_cb(ojVal val, void *ctx) {
+    walk(val);
+    atomic_fetch_add(&((Ingest)ctx)->docs, 1);
+
+    return OJ_DESTROY;
+}
+
+static void
+ingest_end(int fd, ojErr err, void *ctx) {
+    Ingest	ing = (Ingest)ctx;
+
+    if (OJ_OK != err->code) {
+	ing->err = *err;
+    }
+    atomic_fetch_add(&ing->ended, 1);
+}
+
+// Each writer takes turns writing up to 64K to each of its connections.
+static void*
+ingest_write(void *ctx) {
+    Writer	w = (Writer)ctx;
+    Ingest	ing = w->ing;
+    bool	more = true;
+
+    while (more) {
+	more = false;
+	for (int i = w->first; i < ing->cnt; i += INGEST_WRITERS) {
+	    const char	*s = ing->starts[i];
+	    size_t	n = ing->ends[i] - s;
+	    ssize_t	wn;
+
+	    if (0 == n) {
+		continue;
+	    }
+	    if (65536 < n) {
+		n = 65536;
+	    }
+	    if ((wn = write(ing->wds[i], s, n)) <= 0) {
+		wn = ing->ends[i] - s;
+	    }
+	    if (ing->ends[i] <= (ing->starts[i] = s + wn)) {
+		close(ing->wds[i]);
+	    } else {
+		more = true;
+	    }
+	}
+    }
+    return NULL;
+}
+
+// The file is split at newlines into iter parts and each part is written to
+// its own connection over a socketpair. All the connections are read by an
+// ingest engine with a thread per core so the result shows how the
+// throughput holds up as the connections increase.
+static void
+parse_ingest(const char *filename, long long iter) {
+    char		*buf = load_file(filename);
+    size_t		len = (NULL == buf) ? 0 : strlen(buf);
+    struct _ingest	ing = { .cnt = (iter < 1) ? 1 : (int)iter, .err = OJ_ERR_INIT };
+    struct _writer	writers[INGEST_WRITERS];
+    pthread_t		threads[INGEST_WRITERS];
+    ojIngest		engine;
+    const char		*s = buf;
+    int			sv[2];
+
+    atomic_init(&ing.docs, 0);
+    atomic_init(&ing.ended, 0);
+    if (NULL == (engine = oj_ingest_start(&ing.err, 0))) {
+	form_result(0, 0, &ing.err);
+	free(buf);
+	return;
+    }
+    ing.starts = (const char**)calloc(ing.cnt, sizeof(char*));
+    ing.ends = (const char**)calloc(ing.cnt, sizeof(char*));
+    ing.wds = (int*)calloc(ing.cnt, sizeof(int));
+    for (int i = 0; i < ing.cnt; i++) {
+	const char	*e = buf + len * (i + 1) / ing.cnt;
+
+	if (e < s) {
+	    e = s;
+	}
+	for (; e < buf + len && '\n' != *e; e++) {
+	}
+	if (e < buf + len) {
+	    e++;
+	}
+	ing.starts[i] = s;
+	ing.ends[i] = e;
+	s = e;
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+	    perror("socketpair");
+	    exit(1);
+	}
+	ing.wds[i] = sv[0];
+	oj_ingest_add(&ing.err, engine, sv[1], ingest_cb, ingest_end, &ing);
+    }
+    int64_t	start = clock_micro();
+
+    for (int i = 0; i < INGEST_WRITERS; i++) {
+	writers[i].ing = &ing;
+	writers[i].first = i;
+	pthread_create(threads + i, NULL, ingest_write, writers + i);
+    }
+    for (int i = 0; i < INGEST_WRITERS; i++) {
+	pthread_join(threads[i], NULL);
+    }
+    while (atomic_load(&ing.ended) < ing.cnt) {
+	usleep(100);
+    }
+    int64_t	dt = clock_micro() - start;
+
+    oj_ingest_stop(engine);
+    form_result(atomic_load(&ing.docs), dt, &ing.err);
+    free(ing.starts);
+    free(ing.ends);
+    free(ing.wds);
+    free(buf);
+}
+
+// The file should be an array of numbers. After timing the parse each
+// number is parsed alone and compared to strtod() of the same text.
+static void
+round_trip(const char *filename, long long iter) {
+    int64_t		dt;
+    char		*buf = load_file(filename);
+    struct _ojReuser	r;
+    struct _ojErr	err = OJ_ERR_INIT;
+    int64_t		start = clock_micro();
+    long		cnt = 0;
+    long		miss = 0;
+    char		first[64] = "";
+
+    for (int i = iter; 0 < i; i--) {
+	oj_parse_str(&err, buf, &r);
+	oj_reuse(&r);
+    }
+    dt = clock_micro() - start;
+    for (char *s = strtok(buf, "[], \t\r\n"); NULL != s; s = strtok(NULL, "[], \t\r\n")) {
+	ojVal	val = oj_parse_str(&err, s, NULL);
+	double	d = strtod(s, NULL);
+	double	x;
+
+	if (NULL == val) {
+	    continue;
+	}
+	switch (val->type) {
+	case OJ_INT:
+	    x = (double)oj_int_get(val);
+	    break;
+	case OJ_DECIMAL:
+	    x = (double)oj_double_get(val, true);
+	    break;
+	default:
+	    oj_destroy(val);
+	    continue;
+	}
+	cnt++;
+	if (0 != memcmp(&x, &d, sizeof(d))) {
+	    if (0 == miss) {
+		strncpy(first, s, sizeof(first) - 1);
+	    }
+	    miss++;
+	}
+	oj_destroy(val);
+    }
+    if (0 < miss) {
+	err.code = OJ_ERR_PARSE;
+	snprintf(err.msg, sizeof(err.msg), "%ld of %ld numbers differ from strtod, first %s", miss, cnt, first);
+    }
+    form_result(iter, dt, &err);
+    if (NULL != buf) {
+	free(buf);
+    }
+}
+
 static void
 test(const char *filename, long long iter) {
     char		*buf = load_file(filename);
@@ -200,9 +545,19 @@ test(const char *filename, long long iter) {
 
 static struct _mode	mode_map[] = {
     { .key = "validate", .func = validate },
+    { .key = "validate-file", .func = validate_file },
     { .key = "parse", .func = parse },
+    { .key = "parse-indexed", .func = parse_indexed },
+    { .key = "parse-array", .func = parse_array },
+    { .key = "parse-doc", .func = parse_doc },
+    { .key = "parse-insitu", .func = parse_insitu },
+    { .key = "parse-lazy", .func = parse_lazy },
+    { .key = "round-trip", .func = round_trip },
     { .key = "multiple-light", .func = parse_light },
     { .key = "multiple-heavy", .func = parse_heavy },
+    { .key = "multiple-pool", .func = parse_pool },
+    { .key = "multiple-parallel", .func = parse_parallel },
+    { .key = "multiple-ingest", .func = parse_ingest },
     { .key = "test", .func = test },
     { .key = NULL },
 };
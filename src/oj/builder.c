@@ -24,6 +24,7 @@ push(ojBuilder b, const char *key, ojVal v) {
 		    break;
 		}
 		v->key.len = 0;
+		v->key.borrow = false;
 		if (NULL == parent->list.head) {
 		    parent->list.head = v;
 		} else {
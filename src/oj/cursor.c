@@ -0,0 +1,768 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj.h"
+#include "intern.h"
+#include "debug.h"
+
+// The cursor reads the JSON directly instead of going through the parser
+// modes so that a value can be looked at without being read and a value
+// that is passed over is only checked. Like the indexed parser, the line
+// and column are only worked out when there is an error.
+
+static ojStatus
+cursor_error(ojCursor c, const byte *b, int code, const char *fmt, ...) {
+    va_list	ap;
+    const byte	*json = (const byte*)c->json;
+    int		off = (int)(b - json);
+    int		nl = 0;
+
+    c->err.line = 1;
+    for (const byte *s = json; NULL != (s = memchr(s, '\n', b - s)); s++) {
+	c->err.line++;
+	nl = (int)(s - json);
+    }
+    c->err.col = off - nl + 1;
+    va_start(ap, fmt);
+    vsnprintf(c->err.msg, sizeof(c->err.msg), fmt, ap);
+    va_end(ap);
+    c->err.code = code;
+    c->in_val = false;
+
+    return c->err.code;
+}
+
+static ojStatus
+unexpected(ojCursor c, const byte *b) {
+    if ('\0' == *b) {
+	return cursor_error(c, b, OJ_ERR_PARSE, "incomplete JSON");
+    }
+    return cursor_error(c, b, OJ_ERR_PARSE, "unexpected character '%c'", *b);
+}
+
+static inline const byte*
+skip_space(const byte *b) {
+    int		lines;
+    const byte	*nl;
+
+    for (const byte *end = b + 8; b < end; b++) {
+	switch (*b) {
+	case ' ':
+	case '\t':
+	case '\r':
+	case '\n':
+	    break;
+	default:
+	    return b;
+	}
+    }
+    return _oj_skip_space(b, &lines, &nl);
+}
+
+static inline void
+set_kind(ojCursor c, int depth, bool obj) {
+    if (obj) {
+	c->objs[depth / 64] |= 1ULL << (depth % 64);
+    } else {
+	c->objs[depth / 64] &= ~(1ULL << (depth % 64));
+    }
+}
+
+static inline bool
+is_obj(ojCursor c, int depth) {
+    return 0 != (c->objs[depth / 64] & (1ULL << (depth % 64)));
+}
+
+static bool
+is_term(byte b) {
+    switch (b) {
+    case '\0':
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+    case ',':
+    case ']':
+    case '}':
+	return true;
+    }
+    return false;
+}
+
+static int
+hex_val(byte b) {
+    if ('0' <= b && b <= '9') {
+	return b - '0';
+    }
+    if ('a' <= b && b <= 'f') {
+	return b - 'a' + 10;
+    }
+    if ('A' <= b && b <= 'F') {
+	return b - 'A' + 10;
+    }
+    return -1;
+}
+
+// Reads the 4 hex digits of a checked \u escape.
+static uint32_t
+hex4(const byte *b) {
+    return (uint32_t)(hex_val(b[0]) << 12 | hex_val(b[1]) << 8 | hex_val(b[2]) << 4 | hex_val(b[3]));
+}
+
+// Checks a string starting just after the opening quote. Returns the byte
+// after the closing quote or NULL on an error. If escp is not NULL it is
+// set to true if there are escapes in the string.
+static const byte*
+skip_str(ojCursor c, const byte *b, bool *escp) {
+    int	follow;
+
+    while (true) {
+	b = _oj_scan_str(b);
+	switch (*b) {
+	case '"':
+	    return b + 1;
+	case '\\':
+	    if (NULL != escp) {
+		*escp = true;
+	    }
+	    b++;
+	    switch (*b) {
+	    case '"':
+	    case '\\':
+	    case '/':
+	    case 'b':
+	    case 'f':
+	    case 'n':
+	    case 'r':
+	    case 't':
+		b++;
+		break;
+	    case 'u':
+		for (int i = 1; i <= 4; i++) {
+		    if (hex_val(b[i]) < 0) {
+			unexpected(c, b + i);
+			return NULL;
+		    }
+		}
+		b += 5;
+		break;
+	    default:
+		unexpected(c, b);
+		return NULL;
+	    }
+	    break;
+	default:
+	    if (0xC0 <= *b && *b <= 0xDF) {
+		follow = 1;
+	    } else if (0xE0 <= *b && *b <= 0xEF) {
+		follow = 2;
+	    } else if (0xF0 <= *b && *b <= 0xF7) {
+		follow = 3;
+	    } else if ('\0' == *b) {
+		cursor_error(c, b, OJ_ERR_PARSE, "incomplete JSON");
+		return NULL;
+	    } else {
+		cursor_error(c, b, OJ_ERR_PARSE, "invalid JSON character 0x%02x", *b);
+		return NULL;
+	    }
+	    for (int i = 1; i <= follow; i++) {
+		if (0x80 != (0xC0 & b[i])) {
+		    cursor_error(c, b + i, OJ_ERR_PARSE, "invalid JSON character 0x%02x", b[i]);
+		    return NULL;
+		}
+	    }
+	    b += follow + 1;
+	    break;
+	}
+    }
+}
+
+// Reads a number with the same rules as the parser. If v is not NULL the
+// number is left in it uncalculated. Numbers that don't fit in a fixnum
+// with a limited exponent are left as OJ_BIG with no text. Returns the byte
+// after the number or NULL on an error.
+static const byte*
+read_num(ojCursor c, const byte *b, ojVal v) {
+    int64_t	fixnum = 0;
+    int		shift = 0;
+    int		exp = 0;
+    bool	neg = false;
+    bool	exp_neg = false;
+    bool	big = false;
+    ojType	type = OJ_INT;
+    uint64_t	x;
+
+    if ('-' == *b) {
+	neg = true;
+	b++;
+    }
+    if ('0' == *b) {
+	b++;
+    } else if ('1' <= *b && *b <= '9') {
+	for (; '0' <= *b && *b <= '9'; b++) {
+	    x = (uint64_t)fixnum * 10 + (uint64_t)(*b - '0');
+	    if (0 == (0x8000000000000000ULL & x)) {
+		fixnum = (int64_t)x;
+	    } else {
+		big = true;
+	    }
+	}
+    } else {
+	unexpected(c, b);
+	return NULL;
+    }
+    if ('.' == *b) {
+	type = OJ_DECIMAL;
+	b++;
+	if (*b < '0' || '9' < *b) {
+	    unexpected(c, b);
+	    return NULL;
+	}
+	for (; '0' <= *b && *b <= '9'; b++) {
+	    x = (uint64_t)fixnum * 10 + (uint64_t)(*b - '0');
+	    if (0 == (0x8000000000000000ULL & x) && shift < UINT8_MAX) {
+		fixnum = (int64_t)x;
+		shift++;
+	    } else {
+		big = true;
+	    }
+	}
+    }
+    if ('e' == *b || 'E' == *b) {
+	type = OJ_DECIMAL;
+	b++;
+	if ('-' == *b || '+' == *b) {
+	    exp_neg = ('-' == *b);
+	    b++;
+	}
+	if (*b < '0' || '9' < *b) {
+	    unexpected(c, b);
+	    return NULL;
+	}
+	for (; '0' <= *b && *b <= '9'; b++) {
+	    int	e = exp * 10 + (*b - '0');
+
+	    if (e <= MAX_EXP) {
+		exp = e;
+	    } else {
+		big = true;
+	    }
+	}
+    }
+    if (!is_term(*b)) {
+	unexpected(c, b);
+	return NULL;
+    }
+    if (NULL != v) {
+	v->type = big ? OJ_BIG : type;
+	v->num.fixnum = fixnum;
+	v->num.shift = (uint8_t)shift;
+	v->num.exp = (int16_t)exp;
+	v->num.neg = neg;
+	v->num.exp_neg = exp_neg;
+	v->num.calc = false;
+	v->num.len = 0;
+    }
+    return b;
+}
+
+static const byte*
+read_word(ojCursor c, const byte *b, const char *word, int len) {
+    if (0 != strncmp((const char*)b, word, len) || !is_term(b[len])) {
+	cursor_error(c, b, OJ_ERR_PARSE, "expected %s", word);
+	return NULL;
+    }
+    return b + len;
+}
+
+// Reads a key and the colon after it with b on the opening quote. The
+// cursor is left on the member value.
+static bool
+read_key(ojCursor c, const byte *b) {
+    const byte	*end;
+
+    if ('"' != *b) {
+	unexpected(c, b);
+	return false;
+    }
+    c->kesc = false;
+    if (NULL == (end = skip_str(c, b + 1, &c->kesc))) {
+	return false;
+    }
+    c->key = (const char*)b + 1;
+    c->klen = (int)(end - b - 2);
+    b = skip_space(end);
+    if (':' != *b) {
+	unexpected(c, b);
+	return false;
+    }
+    c->pos = (const char*)skip_space(b + 1);
+    c->in_val = true;
+
+    return true;
+}
+
+// Skips the value at b, checking it along the way. Containers in the value
+// use the same kind bits as the cursor above the current depth. Returns the
+// byte after the value or NULL on an error.
+static const byte*
+skip_val(ojCursor c, const byte *b) {
+    int		depth = c->depth;
+
+    while (true) {
+	// b is at the start of a value
+	switch (*b) {
+	case '{':
+	case '[':
+	    if (OJ_CURSOR_DEPTH <= depth) {
+		cursor_error(c, b, OJ_ERR_PARSE, "too deeply nested");
+		return NULL;
+	    }
+	    set_kind(c, depth, '{' == *b);
+	    depth++;
+	    b = skip_space(b + 1);
+	    if ('}' == *b || ']' == *b) {
+		break; // an empty container, closed below
+	    }
+	    if (is_obj(c, depth - 1)) {
+		if ('"' != *b) {
+		    unexpected(c, b);
+		    return NULL;
+		}
+		if (NULL == (b = skip_str(c, b + 1, NULL))) {
+		    return NULL;
+		}
+		if (':' != *(b = skip_space(b))) {
+		    unexpected(c, b);
+		    return NULL;
+		}
+		b = skip_space(b + 1);
+	    }
+	    continue;
+	case '"':
+	    if (NULL == (b = skip_str(c, b + 1, NULL))) {
+		return NULL;
+	    }
+	    break;
+	case 't':
+	    if (NULL == (b = read_word(c, b, "true", 4))) {
+		return NULL;
+	    }
+	    break;
+	case 'f':
+	    if (NULL == (b = read_word(c, b, "false", 5))) {
+		return NULL;
+	    }
+	    break;
+	case 'n':
+	    if (NULL == (b = read_word(c, b, "null", 4))) {
+		return NULL;
+	    }
+	    break;
+	default:
+	    if (NULL == (b = read_num(c, b, NULL))) {
+		return NULL;
+	    }
+	    break;
+	}
+	// After a value; close containers until there is a comma or the
+	// value started at is done.
+	while (true) {
+	    if (c->depth == depth) {
+		return b;
+	    }
+	    b = skip_space(b);
+	    if (',' == *b) {
+		b = skip_space(b + 1);
+		if (is_obj(c, depth - 1)) {
+		    if ('"' != *b) {
+			unexpected(c, b);
+			return NULL;
+		    }
+		    if (NULL == (b = skip_str(c, b + 1, NULL))) {
+			return NULL;
+		    }
+		    if (':' != *(b = skip_space(b))) {
+			unexpected(c, b);
+			return NULL;
+		    }
+		    b = skip_space(b + 1);
+		}
+		break;
+	    }
+	    if ('}' == *b || ']' == *b) {
+		if (('}' == *b) != is_obj(c, depth - 1)) {
+		    cursor_error(c, b, OJ_ERR_PARSE, "unexpected %s close", ('}' == *b) ? "object" : "array");
+		    return NULL;
+		}
+		depth--;
+		b++;
+		continue;
+	    }
+	    unexpected(c, b);
+	    return NULL;
+	}
+    }
+}
+
+// Moves past the current value if the cursor is on one.
+static bool
+pass_val(ojCursor c) {
+    const byte	*b;
+
+    if (c->in_val) {
+	if (NULL == (b = skip_val(c, (const byte*)c->pos))) {
+	    return false;
+	}
+	c->pos = (const char*)b;
+	c->in_val = false;
+    }
+    return true;
+}
+
+ojStatus
+oj_cursor_init(ojCursor c, const char *json) {
+    memset(c, 0, sizeof(struct _ojCursor));
+    c->json = json;
+    c->pos = (const char*)skip_space((const byte*)json);
+    if ('\0' == *c->pos) {
+	return cursor_error(c, (const byte*)c->pos, OJ_ERR_PARSE, "incomplete JSON");
+    }
+    c->in_val = true;
+
+    return OJ_OK;
+}
+
+void
+oj_cursor_cleanup(ojCursor c) {
+    OJ_FREE(c->sbuf);
+    c->sbuf = NULL;
+    c->scap = 0;
+}
+
+ojType
+oj_cursor_type(ojCursor c) {
+    struct _ojVal	v;
+
+    if (!c->in_val) {
+	return OJ_NONE;
+    }
+    switch (*c->pos) {
+    case '{':
+	return OJ_OBJECT;
+    case '[':
+	return OJ_ARRAY;
+    case '"':
+	return OJ_STRING;
+    case 't':
+	return OJ_TRUE;
+    case 'f':
+	return OJ_FALSE;
+    case 'n':
+	return OJ_NULL;
+    }
+    if (NULL == read_num(c, (const byte*)c->pos, &v)) {
+	return OJ_NONE;
+    }
+    return v.type;
+}
+
+const char*
+oj_cursor_key(ojCursor c, int *lenp) {
+    if (!c->in_val || 0 == c->depth || !is_obj(c, c->depth - 1)) {
+	return NULL;
+    }
+    if (NULL != lenp) {
+	*lenp = c->klen;
+    }
+    return c->key;
+}
+
+bool
+oj_cursor_enter(ojCursor c) {
+    const byte	*b = (const byte*)c->pos;
+
+    if (!c->in_val) {
+	return false;
+    }
+    if ('{' != *b && '[' != *b) {
+	cursor_error(c, b, OJ_ERR_TYPE, "not an object or array");
+	return false;
+    }
+    if (OJ_CURSOR_DEPTH <= c->depth) {
+	cursor_error(c, b, OJ_ERR_PARSE, "too deeply nested");
+	return false;
+    }
+    set_kind(c, c->depth, '{' == *b);
+    c->depth++;
+    b = skip_space(b + 1);
+    if ('}' == *b || ']' == *b) {
+	if (('}' == *b) != is_obj(c, c->depth - 1)) {
+	    cursor_error(c, b, OJ_ERR_PARSE, "unexpected %s close", ('}' == *b) ? "object" : "array");
+	    return false;
+	}
+	c->depth--;
+	c->pos = (const char*)b + 1;
+	c->in_val = false;
+	return false;
+    }
+    if (is_obj(c, c->depth - 1)) {
+	return read_key(c, b);
+    }
+    c->pos = (const char*)b;
+
+    return true;
+}
+
+bool
+oj_cursor_next(ojCursor c) {
+    const byte	*b;
+
+    if (OJ_OK != c->err.code || !pass_val(c)) {
+	return false;
+    }
+    b = skip_space((const byte*)c->pos);
+    if (0 == c->depth) {
+	if ('\0' != *b) {
+	    unexpected(c, b);
+	}
+	c->pos = (const char*)b;
+	return false;
+    }
+    switch (*b) {
+    case ',':
+	b = skip_space(b + 1);
+	if (is_obj(c, c->depth - 1)) {
+	    return read_key(c, b);
+	}
+	c->pos = (const char*)b;
+	c->in_val = true;
+	return true;
+    case '}':
+    case ']':
+	if (('}' == *b) != is_obj(c, c->depth - 1)) {
+	    cursor_error(c, b, OJ_ERR_PARSE, "unexpected %s close", ('}' == *b) ? "object" : "array");
+	    return false;
+	}
+	c->depth--;
+	c->pos = (const char*)b + 1;
+	return false;
+    }
+    unexpected(c, b);
+
+    return false;
+}
+
+const char*
+oj_cursor_skip(ojCursor c, int *lenp) {
+    const char	*start = c->pos;
+
+    if (!c->in_val || !pass_val(c)) {
+	return NULL;
+    }
+    if (NULL != lenp) {
+	*lenp = (int)(c->pos - start);
+    }
+    return start;
+}
+
+// Decodes the string of len bytes at s that has escapes into sbuf and sets
+// *lenp to the decoded length. The string has already been checked.
+static const char*
+decode_str(ojCursor c, const byte *s, int len, int *lenp) {
+    const byte	*end = s + len;
+    byte	*d;
+
+    if (c->scap <= (size_t)len) {
+	c->scap = len + 1;
+	if (NULL == (c->sbuf = (char*)OJ_REALLOC(c->sbuf, c->scap))) {
+	    OJ_ERR_MEM(&c->err, "string");
+	    c->scap = 0;
+	    return NULL;
+	}
+    }
+    // An escape is never shorter than what it is decoded to so the
+    // decoded string fits.
+    for (d = (byte*)c->sbuf; s < end; s++) {
+	if ('\\' != *s) {
+	    *d++ = *s;
+	    continue;
+	}
+	s++;
+	switch (*s) {
+	case 'b':
+	    *d++ = '\b';
+	    break;
+	case 'f':
+	    *d++ = '\f';
+	    break;
+	case 'n':
+	    *d++ = '\n';
+	    break;
+	case 'r':
+	    *d++ = '\r';
+	    break;
+	case 't':
+	    *d++ = '\t';
+	    break;
+	case 'u':
+	    // Each escape is decoded on its own the same as the parser does.
+	    d += _oj_unicode_to_utf8(hex4(s + 1), d);
+	    s += 4;
+	    break;
+	default:
+	    *d++ = *s;
+	    break;
+	}
+    }
+    *d = '\0';
+    *lenp = (int)(d - (byte*)c->sbuf);
+
+    return c->sbuf;
+}
+
+bool
+oj_cursor_find(ojCursor c, const char *key, int len) {
+    if (0 == c->depth || !is_obj(c, c->depth - 1)) {
+	return false;
+    }
+    for (bool more = c->in_val || oj_cursor_next(c); more; more = oj_cursor_next(c)) {
+	if (c->kesc) {
+	    int		klen;
+	    const char	*k = decode_str(c, (const byte*)c->key, c->klen, &klen);
+
+	    if (NULL != k && len == klen && 0 == memcmp(key, k, len)) {
+		return true;
+	    }
+	} else if (len == c->klen && 0 == memcmp(key, c->key, len)) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+static bool
+is_num(ojCursor c) {
+    if ('-' == *c->pos || ('0' <= *c->pos && *c->pos <= '9')) {
+	return true;
+    }
+    cursor_error(c, (const byte*)c->pos, OJ_ERR_TYPE, "not a number");
+
+    return false;
+}
+
+int64_t
+oj_cursor_int(ojCursor c) {
+    struct _ojVal	v;
+    const byte		*b;
+
+    if (!c->in_val || !is_num(c)) {
+	return 0;
+    }
+    if (NULL == (b = read_num(c, (const byte*)c->pos, &v))) {
+	return 0;
+    }
+    if (OJ_INT != v.type) {
+	cursor_error(c, (const byte*)c->pos, OJ_ERR_TYPE, "not an integer");
+	return 0;
+    }
+    c->pos = (const char*)b;
+    c->in_val = false;
+
+    return v.num.neg ? -v.num.fixnum : v.num.fixnum;
+}
+
+double
+oj_cursor_double(ojCursor c) {
+    struct _ojVal	v;
+    const byte		*b;
+    double		d;
+
+    if (!c->in_val || !is_num(c)) {
+	return 0.0;
+    }
+    if (NULL == (b = read_num(c, (const byte*)c->pos, &v))) {
+	return 0.0;
+    }
+    switch (v.type) {
+    case OJ_INT:
+	d = (double)(v.num.neg ? -v.num.fixnum : v.num.fixnum);
+	break;
+    case OJ_DECIMAL:
+	_oj_calc_num(&v);
+	d = (double)v.num.dub;
+	break;
+    default:
+	d = strtod(c->pos, NULL);
+	break;
+    }
+    c->pos = (const char*)b;
+    c->in_val = false;
+
+    return d;
+}
+
+const char*
+oj_cursor_str(ojCursor c, int *lenp) {
+    const byte	*b = (const byte*)c->pos;
+    const byte	*end;
+    const char	*s = (const char*)b + 1;
+    int		len = 0;
+    bool	esc = false;
+
+    if (!c->in_val) {
+	return NULL;
+    }
+    if ('"' != *b) {
+	cursor_error(c, b, OJ_ERR_TYPE, "not a string");
+	return NULL;
+    }
+    if (NULL == (end = skip_str(c, b + 1, &esc))) {
+	return NULL;
+    }
+    if (!esc) {
+	len = (int)(end - b - 2);
+    } else if (NULL == (s = decode_str(c, b + 1, (int)(end - b - 2), &len))) {
+	return NULL;
+    }
+    if (NULL != lenp) {
+	*lenp = len;
+    }
+    c->pos = (const char*)end;
+    c->in_val = false;
+
+    return s;
+}
+
+bool
+oj_cursor_bool(ojCursor c) {
+    const byte	*b = (const byte*)c->pos;
+    bool	val = ('t' == *b);
+
+    if (!c->in_val) {
+	return false;
+    }
+    switch (*b) {
+    case 't':
+	b = read_word(c, b, "true", 4);
+	break;
+    case 'f':
+	b = read_word(c, b, "false", 5);
+	break;
+    default:
+	cursor_error(c, b, OJ_ERR_TYPE, "not a boolean");
+	return false;
+    }
+    if (NULL == b) {
+	return false;
+    }
+    c->pos = (const char*)b;
+    c->in_val = false;
+
+    return val;
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "oj.h"
+#include "buf.h"
+#include "debug.h"
+#include "intern.h"
+
+// Returns the entry after e and all of its members.
+static inline ojEntry
+entry_next(ojDoc doc, ojEntry e) {
+    if (OJ_ARRAY == e->type || OJ_OBJECT == e->type) {
+	return doc->tape + e->list.end;
+    }
+    return e + 1;
+}
+
+static uint32_t
+arena_len(ojDoc doc, uint32_t off) {
+    uint32_t	len;
+
+    memcpy(&len, doc->arena + off - sizeof(len), sizeof(len));
+
+    return len;
+}
+
+void
+oj_doc_destroy(ojDoc doc) {
+    if (NULL != doc) {
+	OJ_FREE(doc->tape);
+	OJ_FREE(doc->arena);
+	OJ_FREE(doc);
+    }
+}
+
+ojEntry
+oj_doc_root(ojDoc doc) {
+    if (NULL == doc || 0 == doc->cnt) {
+	return NULL;
+    }
+    return doc->tape;
+}
+
+const char*
+oj_doc_key(ojDoc doc, ojEntry e) {
+    if (NULL == e || 0 == e->key) {
+	return NULL;
+    }
+    return doc->arena + e->key;
+}
+
+const char*
+oj_doc_str(ojDoc doc, ojEntry e) {
+    if (NULL == e || OJ_STRING != e->type) {
+	return NULL;
+    }
+    return doc->arena + e->str.off;
+}
+
+int64_t
+oj_doc_int(ojEntry e) {
+    if (NULL == e || OJ_INT != e->type) {
+	return 0;
+    }
+    return e->fixnum;
+}
+
+long double
+oj_doc_double(ojEntry e) {
+    struct _ojVal	v;
+
+    if (NULL == e || OJ_DECIMAL != e->type) {
+	return 0.0;
+    }
+    // Calculated the same way as the parser does so the result matches an
+    // ojVal from the same JSON.
+    v.type = OJ_DECIMAL;
+    v.num.fixnum = e->fixnum;
+    v.num.neg = e->neg;
+    v.num.shift = e->shift;
+    v.num.exp = e->exp;
+    v.num.exp_neg = e->exp_neg;
+    _oj_calc_num(&v);
+
+    return v.num.dub;
+}
+
+const char*
+oj_doc_bignum(ojDoc doc, ojEntry e) {
+    if (NULL == e || OJ_BIG != e->type) {
+	return NULL;
+    }
+    return doc->arena + e->str.off;
+}
+
+int
+oj_doc_len(ojEntry e) {
+    if (NULL == e || (OJ_ARRAY != e->type && OJ_OBJECT != e->type)) {
+	return 0;
+    }
+    return (int)e->list.cnt;
+}
+
+ojEntry
+oj_doc_array_nth(ojDoc doc, ojEntry e, int n) {
+    if (NULL == e || OJ_ARRAY != e->type || n < 0 || (int)e->list.cnt <= n) {
+	return NULL;
+    }
+    for (e++; 0 < n; n--) {
+	e = entry_next(doc, e);
+    }
+    return e;
+}
+
+ojEntry
+oj_doc_object_get(ojDoc doc, ojEntry e, const char *key, int len) {
+    ojEntry	end;
+
+    if (NULL == e || OJ_OBJECT != e->type) {
+	return NULL;
+    }
+    end = doc->tape + e->list.end;
+    for (e++; e < end; e = entry_next(doc, e)) {
+	if ((uint32_t)len == arena_len(doc, e->key) && 0 == memcmp(key, doc->arena + e->key, len)) {
+	    return e;
+	}
+    }
+    return NULL;
+}
+
+ojEntry
+oj_doc_each(ojDoc doc, ojEntry e, bool (*cb)(ojDoc doc, ojEntry e, void* ctx), void *ctx) {
+    ojEntry	end;
+
+    if (NULL == e || (OJ_ARRAY != e->type && OJ_OBJECT != e->type)) {
+	return NULL;
+    }
+    end = doc->tape + e->list.end;
+    for (e++; e < end; e = entry_next(doc, e)) {
+	if (!cb(doc, e, ctx)) {
+	    return e;
+	}
+    }
+    return NULL;
+}
+
+static void
+doc_buf(ojBuf buf, ojDoc doc, ojEntry e) {
+    char	num[64];
+    int		len;
+    ojEntry	end;
+
+    switch (e->type) {
+    case OJ_NULL:
+	oj_buf_append_string(buf, "null", 4);
+	break;
+    case OJ_TRUE:
+	oj_buf_append_string(buf, "true", 4);
+	break;
+    case OJ_FALSE:
+	oj_buf_append_string(buf, "false", 5);
+	break;
+    case OJ_INT:
+	len = snprintf(num, sizeof(num), "%lld", (long long)e->fixnum);
+	oj_buf_append_string(buf, num, len);
+	break;
+    case OJ_DECIMAL:
+	len = snprintf(num, sizeof(num), "%Lg", oj_doc_double(e));
+	oj_buf_append_string(buf, num, len);
+	break;
+    case OJ_BIG:
+	oj_buf_append_string(buf, doc->arena + e->str.off, e->str.len);
+	break;
+    case OJ_STRING:
+	oj_buf_append(buf, '"');
+	_oj_buf_append_json(buf, doc->arena + e->str.off);
+	oj_buf_append(buf, '"');
+	break;
+    case OJ_ARRAY:
+    case OJ_OBJECT:
+	oj_buf_append(buf, OJ_ARRAY == e->type ? '[' : '{');
+	end = doc->tape + e->list.end;
+	for (ojEntry m = e + 1; m < end; m = entry_next(doc, m)) {
+	    if (e + 1 < m) {
+		oj_buf_append(buf, ',');
+	    }
+	    if (0 != m->key) {
+		oj_buf_append(buf, '"');
+		_oj_buf_append_json(buf, doc->arena + m->key);
+		oj_buf_append(buf, '"');
+		oj_buf_append(buf, ':');
+	    }
+	    doc_buf(buf, doc, m);
+	}
+	oj_buf_append(buf, OJ_ARRAY == e->type ? ']' : '}');
+	break;
+    }
+}
+
+char*
+oj_doc_to_str(ojDoc doc, ojEntry e) {
+    struct _ojBuf	buf;
+
+    oj_buf_init(&buf, 0);
+    if (NULL != e) {
+	doc_buf(&buf, doc, e);
+    }
+    oj_buf_append(&buf, '\0');
+    if (buf.base == buf.head) {
+	return strdup(buf.head);
+    }
+    return buf.head;
+}
@@ -0,0 +1,1038 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj.h"
+#include "intern.h"
+#include "debug.h"
+
+// The indexed parser works in two passes. The first classifies the input 64
+// bytes at a time and records the offset of every structural character, the
+// opening quote of every string, and the first byte of every other token
+// outside of strings. The second pass walks those offsets to build the
+// values. Strings and numbers are still checked byte by byte but everything
+// in between is skipped.
+
+#define ODD_BITS	0xAAAAAAAAAAAAAAAAULL
+#define STACK_INC	64
+
+typedef struct _ojIndexer {
+    const byte		*json;
+    size_t		len;
+    uint32_t		*tokens;
+    uint32_t		*tend;
+    ojVal		*stack;
+    ojVal		*send;
+    ojVal		root;
+    ojVal		all_head;
+    ojVal		all_tail;
+    ojVal		all_dig;
+    ojParseCallback	cb;
+    void		*ctx;
+    struct _ojErr	err;
+} *ojIndexer;
+
+static uint64_t
+prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+
+    return x;
+}
+
+// Marks the bytes that follow an odd length run of backslashes. A run can
+// carry over from the previous block so that is tracked in next_escaped.
+static uint64_t
+escaped_mask(uint64_t slash, uint64_t *next_escaped) {
+    uint64_t	escaped;
+    uint64_t	potential;
+    uint64_t	codes;
+
+    if (0 == slash) {
+	escaped = *next_escaped;
+	*next_escaped = 0;
+	return escaped;
+    }
+    potential = slash & ~*next_escaped;
+    codes = (((potential << 1) | ODD_BITS) - potential) ^ ODD_BITS;
+    escaped = codes ^ (slash | *next_escaped);
+    *next_escaped = (codes & slash) >> 63;
+
+    return escaped;
+}
+
+// Returns 1 if the byte at b follows an odd length run of backslashes.
+static uint64_t
+span_escaped(const byte *base, const byte *b) {
+    const byte	*s = b;
+
+    for (; base < s && '\\' == s[-1]; s--) {
+    }
+    return (uint64_t)((b - s) & 1);
+}
+
+static inline int
+depth_change(byte c) {
+    return ('[' == c || '{' == c) - (']' == c || '}' == c);
+}
+
+void
+_oj_span_count(const byte *base, const byte *b, const byte *end, ojSpan span) {
+    struct _ojMasks	m;
+    byte		tail[64];
+    const byte		*s;
+    uint64_t		next_escaped = span_escaped(base, b);
+    uint64_t		in_str = 0;
+    uint64_t		quote;
+    uint64_t		inside;
+
+    span->depth_out = 0;
+    span->depth_in = 0;
+    for (; b < end; b += 64) {
+	if (end - b < 64) {
+	    memset(tail, ' ', sizeof(tail));
+	    memcpy(tail, b, end - b);
+	    s = tail;
+	} else {
+	    s = b;
+	}
+	_oj_classify(s, &m);
+	quote = m.quote & ~escaped_mask(m.slash, &next_escaped);
+	inside = prefix_xor(quote) ^ in_str;
+	in_str = (uint64_t)((int64_t)inside >> 63);
+	for (uint64_t ops = m.op; 0 != ops; ops &= ops - 1) {
+	    int	i = __builtin_ctzll(ops);
+
+	    if (0 == ((inside >> i) & 1)) {
+		span->depth_out += depth_change(s[i]);
+	    } else {
+		span->depth_in += depth_change(s[i]);
+	    }
+	}
+    }
+    span->odd_quotes = (0 != in_str);
+}
+
+const byte*
+_oj_span_split(const byte *base, const byte *b, const byte *end, bool in_string, long long depth) {
+    struct _ojMasks	m;
+    byte		tail[64];
+    const byte		*s;
+    uint64_t		next_escaped = span_escaped(base, b);
+    uint64_t		in_str = in_string ? ~0ULL : 0;
+    uint64_t		quote;
+    uint64_t		inside;
+
+    for (; b < end; b += 64) {
+	if (end - b < 64) {
+	    memset(tail, ' ', sizeof(tail));
+	    memcpy(tail, b, end - b);
+	    s = tail;
+	} else {
+	    s = b;
+	}
+	_oj_classify(s, &m);
+	quote = m.quote & ~escaped_mask(m.slash, &next_escaped);
+	inside = prefix_xor(quote) ^ in_str;
+	in_str = (uint64_t)((int64_t)inside >> 63);
+	for (uint64_t ops = m.op & ~inside; 0 != ops; ops &= ops - 1) {
+	    int	i = __builtin_ctzll(ops);
+
+	    if (',' == s[i]) {
+		if (1 == depth) {
+		    return b + i + 1;
+		}
+	    } else {
+		depth += depth_change(s[i]);
+	    }
+	}
+    }
+    return NULL;
+}
+
+static ojStatus
+index_build(ojIndexer ix) {
+    const byte		*b = ix->json;
+    const byte		*end = b + ix->len;
+    uint32_t		*t;
+    struct _ojMasks	m;
+    byte		tail[64];
+    uint64_t		next_escaped = 0;
+    uint64_t		in_str = 0;	// all ones if a string is open
+    uint64_t		prev_other = 0;
+    uint64_t		quote;
+    uint64_t		inside;
+    uint64_t		other;
+    uint64_t		tokens;
+    uint32_t		off = 0;
+
+    if (NULL == (ix->tokens = (uint32_t*)OJ_MALLOC(sizeof(uint32_t) * (ix->len + 1)))) {
+	return OJ_ERR_MEM(&ix->err, "index");
+    }
+    t = ix->tokens;
+    for (; b < end; b += 64, off += 64) {
+	if (end - b < 64) {
+	    memset(tail, ' ', sizeof(tail));
+	    memcpy(tail, b, end - b);
+	    _oj_classify(tail, &m);
+	} else {
+	    _oj_classify(b, &m);
+	}
+	quote = m.quote & ~escaped_mask(m.slash, &next_escaped);
+	inside = prefix_xor(quote) ^ in_str;
+	in_str = (uint64_t)((int64_t)inside >> 63);
+	other = ~(m.space | m.op | quote | inside);
+	tokens = (m.op & ~inside) | (quote & inside) | (other & ~((other << 1) | prev_other));
+	prev_other = other >> 63;
+	for (; 0 != tokens; tokens &= tokens - 1) {
+	    *t++ = off + __builtin_ctzll(tokens);
+	}
+    }
+    ix->tend = t;
+    // The terminating '\0' acts as the last token.
+    *t = (uint32_t)ix->len;
+
+    return OJ_OK;
+}
+
+static ojStatus
+index_error(ojIndexer ix, const byte *b, const char *fmt, ...) {
+    va_list	ap;
+    int		off = (int)(b - ix->json);
+    int		nl = 0;
+
+    // Line and column are only needed on an error so they are worked out
+    // here instead of being tracked along the way.
+    ix->err.line = 1;
+    for (const byte *s = ix->json; NULL != (s = memchr(s, '\n', b - s)); s++) {
+	ix->err.line++;
+	nl = (int)(s - ix->json);
+    }
+    ix->err.col = off - nl + 1;
+    va_start(ap, fmt);
+    vsnprintf(ix->err.msg, sizeof(ix->err.msg), fmt, ap);
+    va_end(ap);
+    ix->err.code = OJ_ERR_PARSE;
+
+    return ix->err.code;
+}
+
+static ojStatus
+unexpected(ojIndexer ix, const byte *b) {
+    if ('\0' == *b) {
+	return index_error(ix, b, "incomplete JSON");
+    }
+    return index_error(ix, b, "unexpected character '%c'", *b);
+}
+
+// Same rules as the parser uses for the reuser lists.
+static void
+track(ojIndexer ix, ojVal v) {
+    if ((OJ_STRING == v->type && sizeof(v->str.raw) <= v->str.len) ||
+	(OJ_BIG == v->type && sizeof(v->num.raw) <= v->num.len) ||
+	sizeof(v->key.raw) <= v->key.len) {
+	v->free = ix->all_dig;
+	ix->all_dig = v;
+    } else {
+	v->free = ix->all_head;
+	if (NULL == ix->all_head) {
+	    ix->all_tail = v;
+	}
+	ix->all_head = v;
+    }
+}
+
+static ojVal
+new_val() {
+    ojVal	v = oj_val_create();
+
+    v->next = NULL;
+    v->key.len = 0;
+    v->key.borrow = false;
+    v->type = OJ_NULL;
+    v->mod = 0;
+
+    return v;
+}
+
+// Adds a value to the current array or starts a new document. Object members
+// are created when the key is read.
+static ojVal
+add_val(ojIndexer ix, ojVal *sp) {
+    ojVal	parent;
+    ojVal	v;
+
+    if (sp == ix->stack) {
+	return ix->root = new_val();
+    }
+    if (OJ_OBJECT == (parent = sp[-1])->type) {
+	return parent->list.tail;
+    }
+    v = new_val();
+    if (NULL == parent->list.head) {
+	parent->list.head = v;
+    } else {
+	parent->list.tail->next = v;
+    }
+    parent->list.tail = v;
+
+    return v;
+}
+
+static bool
+is_term(byte b) {
+    switch (b) {
+    case '\0':
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+    case ',':
+    case ':':
+    case ']':
+    case '}':
+    case '[':
+    case '{':
+    case '"':
+	return true;
+    }
+    return false;
+}
+
+static int
+hex_val(byte b) {
+    if ('0' <= b && b <= '9') {
+	return b - '0';
+    }
+    if ('a' <= b && b <= 'f') {
+	return b - 'a' + 10;
+    }
+    if ('A' <= b && b <= 'F') {
+	return b - 'A' + 10;
+    }
+    return -1;
+}
+
+// Reads a string body starting just after the opening quote. Returns a
+// pointer to the closing quote or NULL on error.
+static const byte*
+read_str(ojIndexer ix, ojVal v, bool key, const byte *b) {
+    ojStr	str = key ? &v->key : &v->str;
+    const byte	*start = b;
+    byte	utf8[8];
+    int		follow;
+
+    b = _oj_scan_str(b);
+    if ('"' == *b) {
+	if (key && oj_intern_keys) {
+	    _oj_val_intern_key(v, (const char*)start, b - start);
+	} else if (key) {
+	    _oj_val_set_key(v, (const char*)start, b - start);
+	} else {
+	    _oj_val_set_str(v, (const char*)start, b - start);
+	}
+	return b;
+    }
+    str->len = 0;
+    str->borrow = false;
+    while (true) {
+	if (start < b) {
+	    _oj_append_str(&ix->err, str, start, b - start);
+	}
+	switch (*b) {
+	case '"':
+	    return b;
+	case '\\':
+	    b++;
+	    switch (*b) {
+	    case '"':
+	    case '\\':
+	    case '/':
+		utf8[0] = *b;
+		break;
+	    case 'b':
+		utf8[0] = '\b';
+		break;
+	    case 'f':
+		utf8[0] = '\f';
+		break;
+	    case 'n':
+		utf8[0] = '\n';
+		break;
+	    case 'r':
+		utf8[0] = '\r';
+		break;
+	    case 't':
+		utf8[0] = '\t';
+		break;
+	    case 'u': {
+		uint32_t	code = 0;
+		int		h;
+
+		for (int i = 1; i <= 4; i++) {
+		    if (0 > (h = hex_val(b[i]))) {
+			unexpected(ix, b + i);
+			return NULL;
+		    }
+		    code = code << 4 | (uint32_t)h;
+		}
+		_oj_append_str(&ix->err, str, utf8, _oj_unicode_to_utf8(code, utf8));
+		b += 5;
+		start = b;
+		b = _oj_scan_str(b);
+		continue;
+	    }
+	    default:
+		unexpected(ix, b);
+		return NULL;
+	    }
+	    _oj_append_str(&ix->err, str, utf8, 1);
+	    b++;
+	    break;
+	default:
+	    if (0xC0 <= *b && *b <= 0xDF) {
+		follow = 1;
+	    } else if (0xE0 <= *b && *b <= 0xEF) {
+		follow = 2;
+	    } else if (0xF0 <= *b && *b <= 0xF7) {
+		follow = 3;
+	    } else if ('\0' == *b) {
+		index_error(ix, b, "incomplete JSON");
+		return NULL;
+	    } else {
+		index_error(ix, b, "invalid JSON character 0x%02x", *b);
+		return NULL;
+	    }
+	    for (int i = 1; i <= follow; i++) {
+		if (0x80 != (0xC0 & b[i])) {
+		    index_error(ix, b + i, "invalid JSON character 0x%02x", b[i]);
+		    return NULL;
+		}
+	    }
+	    _oj_append_str(&ix->err, str, b, follow + 1);
+	    b += follow + 1;
+	    break;
+	}
+	start = b;
+	b = _oj_scan_str(b);
+    }
+}
+
+// Reads a number with the same rules as the parser. Numbers that don't fit
+// in a fixnum with a limited exponent are kept as the original text. The
+// value is left uncalculated.
+static const byte*
+read_num(ojIndexer ix, ojVal v, const byte *b) {
+    const byte	*start = b;
+    bool	big = false;
+    uint64_t	x;
+
+    v->type = OJ_INT;
+    v->num.fixnum = 0;
+    v->num.neg = false;
+    v->num.shift = 0;
+    v->num.calc = false;
+    v->num.len = 0;
+    v->num.exp = 0;
+    v->num.exp_neg = false;
+    if ('-' == *b) {
+	v->num.neg = true;
+	b++;
+    }
+    if ('0' == *b) {
+	b++;
+    } else if ('1' <= *b && *b <= '9') {
+	for (; '0' <= *b && *b <= '9'; b++) {
+	    x = (uint64_t)v->num.fixnum * 10 + (uint64_t)(*b - '0');
+	    if (0 == (0x8000000000000000ULL & x)) {
+		v->num.fixnum = (int64_t)x;
+	    } else {
+		big = true;
+	    }
+	}
+    } else {
+	unexpected(ix, b);
+	return NULL;
+    }
+    if ('.' == *b) {
+	v->type = OJ_DECIMAL;
+	b++;
+	if (*b < '0' || '9' < *b) {
+	    unexpected(ix, b);
+	    return NULL;
+	}
+	for (; '0' <= *b && *b <= '9'; b++) {
+	    x = (uint64_t)v->num.fixnum * 10 + (uint64_t)(*b - '0');
+	    if (0 == (0x8000000000000000ULL & x) && v->num.shift < UINT8_MAX) {
+		v->num.fixnum = (int64_t)x;
+		v->num.shift++;
+	    } else {
+		big = true;
+	    }
+	}
+    }
+    if ('e' == *b || 'E' == *b) {
+	v->type = OJ_DECIMAL;
+	b++;
+	if ('-' == *b || '+' == *b) {
+	    v->num.exp_neg = ('-' == *b);
+	    b++;
+	}
+	if (*b < '0' || '9' < *b) {
+	    unexpected(ix, b);
+	    return NULL;
+	}
+	for (; '0' <= *b && *b <= '9'; b++) {
+	    int	e = v->num.exp * 10 + (*b - '0');
+
+	    if (e <= MAX_EXP) {
+		v->num.exp = (int16_t)e;
+	    } else {
+		big = true;
+	    }
+	}
+    }
+    if (!is_term(*b)) {
+	unexpected(ix, b);
+	return NULL;
+    }
+    if (big) {
+	v->type = OJ_BIG;
+	v->num.len = 0;
+	_oj_append_num(&ix->err, &v->num, (const char*)start, b - start);
+    }
+    return b;
+}
+
+static ojStatus
+push_container(ojIndexer ix, ojVal **spp, ojVal v) {
+    v->list.head = NULL;
+    v->list.tail = NULL;
+    if (ix->send <= *spp) {
+	size_t	cnt = ix->send - ix->stack;
+	ojVal	*stack = (ojVal*)OJ_REALLOC(ix->stack, sizeof(ojVal) * (cnt + STACK_INC));
+
+	if (NULL == stack) {
+	    return OJ_ERR_MEM(&ix->err, "stack");
+	}
+	ix->stack = stack;
+	ix->send = stack + cnt + STACK_INC;
+	*spp = stack + cnt;
+    }
+    **spp = v;
+    (*spp)++;
+
+    return OJ_OK;
+}
+
+// Returns true if the document is complete and should stop.
+static bool
+doc_done(ojIndexer ix) {
+    if (NULL != ix->cb) {
+	ojCallbackOp	op = ix->cb(ix->root, ix->ctx);
+
+	if (0 != (OJ_DESTROY & op)) {
+	    struct _ojReuser	r = {
+		.head = ix->all_head,
+		.tail = ix->all_tail,
+		.dig = ix->all_dig,
+	    };
+	    oj_reuse(&r);
+	}
+	ix->root = NULL;
+	ix->all_head = NULL;
+	ix->all_tail = NULL;
+	ix->all_dig = NULL;
+
+	return (0 != (OJ_STOP & op));
+    }
+    return false;
+}
+
+static ojStatus
+index_parse(ojIndexer ix) {
+    const byte	*json = ix->json;
+    const byte	*b;
+    ojVal	*sp = ix->stack;
+    ojVal	v;
+    uint32_t	*t = ix->tokens;
+
+    // Each pass through the loop reads one value and then whatever follows
+    // it up to the start of the next value.
+    while (t < ix->tend) {
+	b = json + *t++;
+	if (NULL != ix->root && ix->stack == sp) {
+	    // A second document is only allowed with a callback.
+	    return unexpected(ix, b);
+	}
+	v = add_val(ix, sp);
+	switch (*b) {
+	case '{':
+	    v->type = OJ_OBJECT;
+	    v->mod = OJ_OBJ_RAW;
+	    track(ix, v);
+	    if (OJ_OK != push_container(ix, &sp, v)) {
+		return ix->err.code;
+	    }
+	    b = json + *t;
+	    if ('}' == *b) {
+		t++;
+		sp--;
+		break;
+	    }
+	    goto KEY;
+	case '[':
+	    v->type = OJ_ARRAY;
+	    track(ix, v);
+	    if (OJ_OK != push_container(ix, &sp, v)) {
+		return ix->err.code;
+	    }
+	    if (']' == json[*t]) {
+		t++;
+		sp--;
+		break;
+	    }
+	    continue;
+	case '"':
+	    v->type = OJ_STRING;
+	    if (NULL == read_str(ix, v, false, b + 1)) {
+		return ix->err.code;
+	    }
+	    track(ix, v);
+	    break;
+	case 't':
+	    if (0 != strncmp("true", (const char*)b, 4)) {
+		return index_error(ix, b + 3, "expected true");
+	    }
+	    if (!is_term(b[4])) {
+		return unexpected(ix, b + 4);
+	    }
+	    v->type = OJ_TRUE;
+	    track(ix, v);
+	    break;
+	case 'f':
+	    if (0 != strncmp("false", (const char*)b, 5)) {
+		return index_error(ix, b + 4, "expected false");
+	    }
+	    if (!is_term(b[5])) {
+		return unexpected(ix, b + 5);
+	    }
+	    v->type = OJ_FALSE;
+	    track(ix, v);
+	    break;
+	case 'n':
+	    if (0 != strncmp("null", (const char*)b, 4)) {
+		return index_error(ix, b + 3, "expected null");
+	    }
+	    if (!is_term(b[4])) {
+		return unexpected(ix, b + 4);
+	    }
+	    v->type = OJ_NULL;
+	    track(ix, v);
+	    break;
+	default:
+	    if (NULL == read_num(ix, v, b)) {
+		return ix->err.code;
+	    }
+	    if (!oj_lazy_num) {
+		_oj_calc_num(v);
+	    }
+	    track(ix, v);
+	    break;
+	}
+	// A value has been read. Close containers until a comma is found.
+	while (true) {
+	    if (ix->stack == sp) {
+		if (doc_done(ix)) {
+		    return OJ_OK;
+		}
+		break;
+	    }
+	    b = json + *t++;
+	    switch (*b) {
+	    case ',':
+		if (OJ_OBJECT == sp[-1]->type) {
+		    goto KEY;
+		}
+		goto NEXT;
+	    case ']':
+		if (OJ_ARRAY != sp[-1]->type) {
+		    return index_error(ix, b, "unexpected array close");
+		}
+		sp--;
+		break;
+	    case '}':
+		if (OJ_OBJECT != sp[-1]->type) {
+		    return index_error(ix, b, "unexpected object close");
+		}
+		sp--;
+		break;
+	    default:
+		return unexpected(ix, b);
+	    }
+	}
+	continue;
+    KEY:
+	// Reads a key and the colon after it then adds the member to the
+	// object on the top of the stack.
+	b = json + *t++;
+	if ('"' != *b) {
+	    return unexpected(ix, b);
+	}
+	v = new_val();
+	if (NULL == sp[-1]->list.head) {
+	    sp[-1]->list.head = v;
+	} else {
+	    sp[-1]->list.tail->next = v;
+	}
+	sp[-1]->list.tail = v;
+	if (NULL == (b = read_str(ix, v, true, b + 1))) {
+	    return ix->err.code;
+	}
+	b = json + *t++;
+	if (':' != *b) {
+	    return unexpected(ix, b);
+	}
+    NEXT:
+	continue;
+    }
+    if (ix->stack != sp) {
+	return unexpected(ix, json + ix->len);
+    }
+    return OJ_OK;
+}
+
+// Copies a string, key, or bignum into the arena and returns the offset of
+// the first byte.
+static uint32_t
+arena_add(ojDoc doc, const char *s, size_t len) {
+    uint32_t	len32 = (uint32_t)len;
+    uint32_t	off = doc->alen + sizeof(len32);
+
+    memcpy(doc->arena + doc->alen, &len32, sizeof(len32));
+    memcpy(doc->arena + off, s, len);
+    doc->arena[off + len] = '\0';
+    doc->alen = off + len32 + 1;
+
+    return off;
+}
+
+// Reads a string body onto the arena. Strings without escapes are copied
+// directly from the input, the rest go through read_str() and the scratch
+// value.
+static const byte*
+tape_str(ojIndexer ix, ojDoc doc, ojVal scratch, const byte *b, uint32_t *offp, uint32_t *lenp) {
+    const byte	*end = _oj_scan_str(b);
+
+    if ('"' == *end) {
+	*lenp = (uint32_t)(end - b);
+	*offp = arena_add(doc, (const char*)b, end - b);
+	return end;
+    }
+    scratch->type = OJ_STRING;
+    scratch->str.len = 0;
+    if (NULL != (end = read_str(ix, scratch, false, b))) {
+	*lenp = (uint32_t)scratch->str.len;
+	*offp = arena_add(doc, oj_str_get(scratch), scratch->str.len);
+    }
+    _oj_val_clear(scratch);
+
+    return end;
+}
+
+static const byte*
+tape_num(ojIndexer ix, ojDoc doc, ojVal scratch, ojEntry e, const byte *b) {
+    if (NULL == (b = read_num(ix, scratch, b))) {
+	_oj_val_clear(scratch);
+	return NULL;
+    }
+    e->type = scratch->type;
+    switch (scratch->type) {
+    case OJ_INT:
+	e->fixnum = scratch->num.neg ? -scratch->num.fixnum : scratch->num.fixnum;
+	break;
+    case OJ_DECIMAL:
+	e->fixnum = scratch->num.fixnum;
+	e->neg = scratch->num.neg;
+	e->shift = scratch->num.shift;
+	e->exp = scratch->num.exp;
+	e->exp_neg = scratch->num.exp_neg;
+	break;
+    case OJ_BIG:
+	e->str.len = scratch->num.len;
+	e->str.off = arena_add(doc, oj_bignum_get(scratch), scratch->num.len);
+	_oj_val_clear(scratch);
+	break;
+    }
+    return b;
+}
+
+// Same flow as index_parse() but entries are appended to the tape. The
+// tape and arena are sized from the index so neither has to grow.
+static ojStatus
+tape_parse(ojIndexer ix, ojDoc doc) {
+    const byte		*json = ix->json;
+    const byte		*b;
+    uint32_t		*stack;
+    uint32_t		*send;
+    uint32_t		*sp;
+    uint32_t		*t = ix->tokens;
+    uint32_t		key = 0;
+    uint32_t		klen;
+    ojEntry		e;
+    struct _ojVal	scratch;
+
+    memset(&scratch, 0, sizeof(scratch));
+    if (NULL == (stack = (uint32_t*)OJ_MALLOC(sizeof(uint32_t) * STACK_INC))) {
+	return OJ_ERR_MEM(&ix->err, "stack");
+    }
+    send = stack + STACK_INC;
+    sp = stack;
+    while (t < ix->tend) {
+	b = json + *t++;
+	if (0 < doc->cnt && stack == sp) {
+	    unexpected(ix, b);
+	    goto DONE;
+	}
+	if (stack < sp) {
+	    doc->tape[sp[-1]].list.cnt++;
+	}
+	e = doc->tape + doc->cnt++;
+	e->type = OJ_NULL;
+	e->shift = 0;
+	e->exp = 0;
+	e->exp_neg = 0;
+	e->neg = 0;
+	e->key = key;
+	key = 0;
+	switch (*b) {
+	case '{':
+	case '[':
+	    e->type = ('{' == *b) ? OJ_OBJECT : OJ_ARRAY;
+	    e->list.cnt = 0;
+	    if (send <= sp) {
+		size_t		cnt = send - stack;
+		uint32_t	*s2 = (uint32_t*)OJ_REALLOC(stack, sizeof(uint32_t) * (cnt + STACK_INC));
+
+		if (NULL == s2) {
+		    OJ_ERR_MEM(&ix->err, "stack");
+		    goto DONE;
+		}
+		stack = s2;
+		send = stack + cnt + STACK_INC;
+		sp = stack + cnt;
+	    }
+	    *sp++ = doc->cnt - 1;
+	    if (('{' == *b && '}' == json[*t]) || ('[' == *b && ']' == json[*t])) {
+		t++;
+		sp--;
+		e->list.end = doc->cnt;
+		break;
+	    }
+	    if ('{' == *b) {
+		goto KEY;
+	    }
+	    continue;
+	case '"':
+	    e->type = OJ_STRING;
+	    if (NULL == tape_str(ix, doc, &scratch, b + 1, &e->str.off, &e->str.len)) {
+		goto DONE;
+	    }
+	    break;
+	case 't':
+	    if (0 != strncmp("true", (const char*)b, 4)) {
+		index_error(ix, b + 3, "expected true");
+		goto DONE;
+	    }
+	    if (!is_term(b[4])) {
+		unexpected(ix, b + 4);
+		goto DONE;
+	    }
+	    e->type = OJ_TRUE;
+	    break;
+	case 'f':
+	    if (0 != strncmp("false", (const char*)b, 5)) {
+		index_error(ix, b + 4, "expected false");
+		goto DONE;
+	    }
+	    if (!is_term(b[5])) {
+		unexpected(ix, b + 5);
+		goto DONE;
+	    }
+	    e->type = OJ_FALSE;
+	    break;
+	case 'n':
+	    if (0 != strncmp("null", (const char*)b, 4)) {
+		index_error(ix, b + 3, "expected null");
+		goto DONE;
+	    }
+	    if (!is_term(b[4])) {
+		unexpected(ix, b + 4);
+		goto DONE;
+	    }
+	    break;
+	default:
+	    if (NULL == tape_num(ix, doc, &scratch, e, b)) {
+		goto DONE;
+	    }
+	    break;
+	}
+	// A value has been read. Close containers until a comma is found.
+	while (stack < sp) {
+	    b = json + *t++;
+	    switch (*b) {
+	    case ',':
+		if (OJ_OBJECT == doc->tape[sp[-1]].type) {
+		    goto KEY;
+		}
+		goto NEXT;
+	    case ']':
+		if (OJ_ARRAY != doc->tape[sp[-1]].type) {
+		    index_error(ix, b, "unexpected array close");
+		    goto DONE;
+		}
+		break;
+	    case '}':
+		if (OJ_OBJECT != doc->tape[sp[-1]].type) {
+		    index_error(ix, b, "unexpected object close");
+		    goto DONE;
+		}
+		break;
+	    default:
+		unexpected(ix, b);
+		goto DONE;
+	    }
+	    sp--;
+	    doc->tape[*sp].list.end = doc->cnt;
+	}
+	continue;
+    KEY:
+	b = json + *t++;
+	if ('"' != *b) {
+	    unexpected(ix, b);
+	    goto DONE;
+	}
+	if (NULL == tape_str(ix, doc, &scratch, b + 1, &key, &klen)) {
+	    goto DONE;
+	}
+	b = json + *t++;
+	if (':' != *b) {
+	    unexpected(ix, b);
+	    goto DONE;
+	}
+    NEXT:
+	continue;
+    }
+    if (stack != sp) {
+	unexpected(ix, json + ix->len);
+    }
+DONE:
+    OJ_FREE(stack);
+
+    return ix->err.code;
+}
+
+static ojStatus
+index_start(ojIndexer ix, const char *json) {
+    ix->err.line = 1;
+    ix->json = (const byte*)json;
+    ix->len = strlen(json);
+    if (UINT32_MAX <= ix->len) {
+	return oj_err_set(&ix->err, OJ_ERR_TOO_MANY, "JSON too large to index");
+    }
+    return index_build(ix);
+}
+
+static ojStatus
+indexed(ojIndexer ix, const char *json) {
+    if (NULL == (ix->stack = (ojVal*)OJ_MALLOC(sizeof(ojVal) * STACK_INC))) {
+	return OJ_ERR_MEM(&ix->err, "stack");
+    }
+    ix->send = ix->stack + STACK_INC;
+    if (OJ_OK == index_start(ix, json)) {
+	index_parse(ix);
+    }
+    OJ_FREE(ix->tokens);
+    OJ_FREE(ix->stack);
+    if (OJ_OK != ix->err.code) {
+	oj_destroy(ix->root);
+	ix->root = NULL;
+	ix->all_head = NULL;
+	ix->all_tail = NULL;
+	ix->all_dig = NULL;
+    }
+    return ix->err.code;
+}
+
+ojVal
+oj_parse_indexed(ojErr err, const char *json, ojReuser reuser) {
+    struct _ojIndexer	ix;
+
+    memset(&ix, 0, sizeof(ix));
+    if (OJ_OK != indexed(&ix, json)) {
+	if (NULL != err) {
+	    *err = ix.err;
+	}
+    }
+    if (NULL != reuser) {
+	reuser->head = ix.all_head;
+	reuser->tail = ix.all_tail;
+	reuser->dig = ix.all_dig;
+    }
+    return ix.root;
+}
+
+ojStatus
+oj_parse_indexed_cb(ojErr err, const char *json, ojParseCallback cb, void *ctx) {
+    struct _ojIndexer	ix;
+
+    memset(&ix, 0, sizeof(ix));
+    ix.cb = cb;
+    ix.ctx = ctx;
+    if (OJ_OK != indexed(&ix, json) && NULL != err) {
+	*err = ix.err;
+    }
+    return ix.err.code;
+}
+
+ojDoc
+oj_doc_parse(ojErr err, const char *json) {
+    struct _ojIndexer	ix;
+    ojDoc		doc;
+    size_t		ntok;
+
+    memset(&ix, 0, sizeof(ix));
+    if (NULL == (doc = (ojDoc)OJ_CALLOC(1, sizeof(struct _ojDoc)))) {
+	OJ_ERR_MEM(&ix.err, "document");
+    } else if (OJ_OK == index_start(&ix, json)) {
+	// There can be no more entries than tokens and an arena string is
+	// never longer than its source plus the length and terminator.
+	ntok = ix.tend - ix.tokens;
+	doc->tape = (ojEntry)OJ_MALLOC(sizeof(struct _ojEntry) * (ntok + 1));
+	doc->arena = (char*)OJ_MALLOC(ix.len + ntok * 5 + 1);
+	if (NULL == doc->tape || NULL == doc->arena) {
+	    OJ_ERR_MEM(&ix.err, "document");
+	} else if (UINT32_MAX <= ix.len + ntok * 5) {
+	    oj_err_set(&ix.err, OJ_ERR_TOO_MANY, "JSON too large to index");
+	} else if (OJ_OK == tape_parse(&ix, doc)) {
+	    doc->tape = (ojEntry)OJ_REALLOC(doc->tape, sizeof(struct _ojEntry) * (doc->cnt + 1));
+	    doc->arena = (char*)OJ_REALLOC(doc->arena, doc->alen + 1);
+	}
+    }
+    OJ_FREE(ix.tokens);
+    if (OJ_OK != ix.err.code) {
+	oj_doc_destroy(doc);
+	doc = NULL;
+	if (NULL != err) {
+	    *err = ix.err;
+	}
+    }
+    return doc;
+}
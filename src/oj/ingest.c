@@ -0,0 +1,273 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "oj.h"
+#include "debug.h"
+#include "intern.h"
+
+// Connections are spread over a few loops, each a thread waiting on its own
+// epoll set. Each connection keeps a push parser so a document can be split
+// over any number of reads. The sets are level triggered and a ready
+// connection gets one block read per wait so a busy connection can't starve
+// the others on the same loop.
+
+#define INGEST_BLOCK_SIZE	(64 * 1024)
+#define INGEST_EVENT_MAX	64
+
+typedef struct _Conn {
+    struct _Conn	*next;
+    struct _Conn	*prev;
+    ojParser		p;
+    int			fd;
+    ojIngestEnd		end;
+    void		*ctx;
+} *Conn;
+
+typedef struct _Loop {
+    pthread_t		thread;
+    int			epoll;
+    Conn		conns;
+    pthread_mutex_t	lock;	// guards conns
+    byte		*buf;
+    bool		started;
+} *Loop;
+
+struct _ojIngest {
+    Loop		loops;
+    int			cnt;
+    int			wake;	// eventfd that stops the loops once written
+    atomic_uint		next;	// loop for the next connection without a caller
+};
+
+static void
+conn_end(Loop loop, Conn c, ojErr err) {
+    epoll_ctl(loop->epoll, EPOLL_CTL_DEL, c->fd, NULL);
+    pthread_mutex_lock(&loop->lock);
+    if (NULL == c->prev) {
+	loop->conns = c->next;
+    } else {
+	c->prev->next = c->next;
+    }
+    if (NULL != c->next) {
+	c->next->prev = c->prev;
+    }
+    pthread_mutex_unlock(&loop->lock);
+    if (NULL != c->end) {
+	c->end(c->fd, err, c->ctx);
+    }
+    close(c->fd);
+    oj_parser_destroy(c->p);
+    OJ_FREE(c);
+}
+
+static void
+conn_read(Loop loop, Conn c) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ssize_t		rsize = read(c->fd, loop->buf, INGEST_BLOCK_SIZE);
+
+    if (0 < rsize) {
+	if (OJ_OK == _oj_parser_block(&err, c->p, loop->buf, rsize)) {
+	    return;
+	}
+    } else if (0 == rsize) {
+	oj_parser_finish(&err, c->p);
+    } else if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+	return;
+    } else {
+	oj_err_no(&err, "read error");
+    }
+    conn_end(loop, c, &err);
+}
+
+static void*
+loop_run(void *ctx) {
+    Loop		loop = (Loop)ctx;
+    struct epoll_event	events[INGEST_EVENT_MAX];
+    int			cnt;
+
+    while (true) {
+	if ((cnt = epoll_wait(loop->epoll, events, INGEST_EVENT_MAX, -1)) < 0) {
+	    if (EINTR == errno) {
+		continue;
+	    }
+	    break;
+	}
+	for (int i = 0; i < cnt; i++) {
+	    // The wake eventfd is the only entry without a connection. It is
+	    // never read so it stays ready until all the loops have seen it.
+	    if (NULL == events[i].data.ptr) {
+		return NULL;
+	    }
+	    conn_read(loop, (Conn)events[i].data.ptr);
+	}
+    }
+    return NULL;
+}
+
+ojIngest
+oj_ingest_start(ojErr err, int threads) {
+    ojIngest		ing;
+    struct epoll_event	ev = { .events = EPOLLIN, .data.ptr = NULL };
+    int			started = 0;
+
+    if (threads < 1) {
+	threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1) {
+	    threads = 1;
+	}
+    }
+    if (NULL == (ing = (ojIngest)OJ_CALLOC(1, sizeof(struct _ojIngest))) ||
+	NULL == (ing->loops = (Loop)OJ_CALLOC(threads, sizeof(struct _Loop)))) {
+	OJ_ERR_MEM(err, "ingest");
+	OJ_FREE(ing);
+	return NULL;
+    }
+    ing->cnt = threads;
+    atomic_init(&ing->next, 0);
+    if ((ing->wake = eventfd(0, EFD_CLOEXEC)) < 0) {
+	oj_err_no(err, "eventfd failed");
+	OJ_FREE(ing->loops);
+	OJ_FREE(ing);
+	return NULL;
+    }
+    // Ended by oj_ingest_stop().
+    if (1 < threads) {
+	_oj_threads_begin();
+    }
+    // Every lock is initialized up front so oj_ingest_stop() can destroy
+    // them all no matter where startup fails.
+    for (int i = 0; i < threads; i++) {
+	pthread_mutex_init(&ing->loops[i].lock, NULL);
+    }
+    for (int i = 0; i < threads; i++) {
+	Loop	loop = ing->loops + i;
+
+	if ((loop->epoll = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+	    0 != epoll_ctl(loop->epoll, EPOLL_CTL_ADD, ing->wake, &ev)) {
+	    oj_err_no(err, "epoll failed");
+	    break;
+	}
+	if (NULL == (loop->buf = (byte*)OJ_MALLOC(INGEST_BLOCK_SIZE + 1))) {
+	    OJ_ERR_MEM(err, "ingest");
+	    break;
+	}
+	if (0 != pthread_create(&loop->thread, NULL, loop_run, loop)) {
+	    oj_err_no(err, "failed to start ingest thread");
+	    break;
+	}
+	loop->started = true;
+	started++;
+    }
+    if (started < threads) {
+	oj_ingest_stop(ing);
+	return NULL;
+    }
+    return ing;
+}
+
+static ojStatus
+ingest_add(ojErr err, ojIngest ing, int fd, ojParser p, Loop loop, ojIngestEnd end, void *ctx) {
+    Conn		c;
+    struct epoll_event	ev = { .events = EPOLLIN | EPOLLRDHUP };
+    int			flags = fcntl(fd, F_GETFL);
+
+    if (NULL == p || NULL == (c = (Conn)OJ_CALLOC(1, sizeof(struct _Conn)))) {
+	oj_parser_destroy(p);
+	return OJ_ERR_MEM(err, "ingest connection");
+    }
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+	oj_parser_destroy(p);
+	OJ_FREE(c);
+	return oj_err_no(err, "fcntl failed");
+    }
+    c->p = p;
+    c->fd = fd;
+    c->end = end;
+    c->ctx = ctx;
+    // The connection is listed before it is added to the epoll set since
+    // the loop may end it as soon as it is added.
+    pthread_mutex_lock(&loop->lock);
+    if (NULL != (c->next = loop->conns)) {
+	c->next->prev = c;
+    }
+    loop->conns = c;
+    pthread_mutex_unlock(&loop->lock);
+
+    ev.data.ptr = c;
+    if (0 != epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &ev)) {
+	ojStatus	status = oj_err_no(err, "epoll_ctl failed");
+
+	pthread_mutex_lock(&loop->lock);
+	if (NULL == c->prev) {
+	    loop->conns = c->next;
+	} else {
+	    c->prev->next = c->next;
+	}
+	if (NULL != c->next) {
+	    c->next->prev = c->prev;
+	}
+	pthread_mutex_unlock(&loop->lock);
+	oj_parser_destroy(p);
+	OJ_FREE(c);
+
+	return status;
+    }
+    return OJ_OK;
+}
+
+ojStatus
+oj_ingest_add(ojErr err, ojIngest ing, int fd, ojParseCallback cb, ojIngestEnd end, void *ctx) {
+    Loop	loop = ing->loops + atomic_fetch_add(&ing->next, 1) % ing->cnt;
+
+    return ingest_add(err, ing, fd, oj_parser_create_cb(err, cb, ctx), loop, end, ctx);
+}
+
+ojStatus
+oj_ingest_add_call(ojErr err, ojIngest ing, int fd, ojCaller caller, ojIngestEnd end, void *ctx) {
+    Loop	loop = ing->loops + ((uintptr_t)caller >> 4) % ing->cnt;
+
+    return ingest_add(err, ing, fd, oj_parser_create_call(err, caller), loop, end, ctx);
+}
+
+void
+oj_ingest_stop(ojIngest ing) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    uint64_t		one = 1;
+
+    if (NULL == ing) {
+	return;
+    }
+    if (write(ing->wake, &one, sizeof(one)) < 0) {
+	// An eventfd write only fails on overflow which can't happen here.
+    }
+    oj_err_set(&err, OJ_ABORT, "ingest stopped");
+    for (int i = 0; i < ing->cnt; i++) {
+	Loop	loop = ing->loops + i;
+
+	if (loop->started) {
+	    pthread_join(loop->thread, NULL);
+	}
+	while (NULL != loop->conns) {
+	    conn_end(loop, loop->conns, &err);
+	}
+	if (0 < loop->epoll) {
+	    close(loop->epoll);
+	}
+	pthread_mutex_destroy(&loop->lock);
+	OJ_FREE(loop->buf);
+    }
+    close(ing->wake);
+    if (1 < ing->cnt) {
+	_oj_threads_end();
+    }
+    OJ_FREE(ing->loops);
+    OJ_FREE(ing);
+}
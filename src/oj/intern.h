@@ -8,6 +8,7 @@ extern "C" {
 #endif
 
 #define OJ_ERR_MEM(err, type) oj_err_memory(err, type, __FILE__, __LINE__)
+#define MAX_EXP		4932
 
     typedef uint8_t	byte;
 
@@ -18,10 +19,88 @@ extern "C" {
 
     extern void		_oj_val_set_str(ojVal val, const char *s, size_t len);
     extern void		_oj_val_set_key(ojVal val, const char *s, size_t len);
+    // Sets the key to the interned copy of s, falling back to a copy if it
+    // is too long to intern.
+    extern void		_oj_val_intern_key(ojVal val, const char *s, size_t len);
     extern void		_oj_append_str(ojErr err, ojStr str, const byte *s, size_t len);
     extern void		_oj_append_num(ojErr err, ojNum num, const char *s, size_t len);
     extern void		_oj_fast_destroy(ojVal head, ojVal tail, ojVal dig);
     extern void		_oj_val_clear(ojVal v);
+    // Like oj_reuse() but the vals are left on the reuser head list for the
+    // caller to keep in its own pool.
+    extern void		_oj_reuse_keep(ojReuser reuser);
+    // Called around anything that creates and frees vals on threads of its
+    // own. Vals are locked while any are running or oj_thread_safe is set.
+    extern void		_oj_threads_begin(void);
+    extern void		_oj_threads_end(void);
+    extern void		_oj_calc_num(ojVal v);
+    // Sets *dp to the correctly rounded double of man * 10^exp10. Returns
+    // false if the value is outside the range of a double.
+    extern bool		_oj_dec_to_double(uint64_t man, int exp10, bool neg, double *dp);
+    extern size_t	_oj_unicode_to_utf8(uint32_t code, byte *buf);
+    extern void		_oj_buf_append_json(ojBuf buf, const char *s);
+
+    // Returns the first byte that is not a plain string byte or part of a
+    // valid multibyte UTF-8 character; '"', '\\', a control character, the
+    // start of an invalid or incomplete character, or the '\0' terminator.
+    extern const byte*	(*_oj_scan_str)(const byte *b);
+    // Skips spaces, tabs, carriage returns, and newlines. The newline count
+    // is added to lines and nl is set to the last newline skipped if any.
+    extern const byte*	(*_oj_skip_space)(const byte *b, int *lines, const byte **nl);
+
+    // One bit per byte of a 64 byte block.
+    typedef struct _ojMasks {
+	uint64_t	quote;
+	uint64_t	slash;
+	uint64_t	space;
+	uint64_t	op;	// {}[]:,
+    } *ojMasks;
+
+    // Classifies the 64 bytes starting at b.
+    extern void		(*_oj_classify)(const byte *b, ojMasks m);
+
+    // Quote parity and depth changes over part of a top level array so the
+    // string state and depth at the start of each part can be found with a
+    // prefix sum before the parts are parsed in parallel. The depth change
+    // depends on whether the part starts inside a string so both are kept.
+    typedef struct _ojSpan {
+	long long	depth_out;
+	long long	depth_in;
+	bool		odd_quotes;
+    } *ojSpan;
+
+    // Fills in span for the bytes from b to end. The bytes before b back to
+    // base are only looked at for an escape.
+    extern void		_oj_span_count(const byte *base, const byte *b, const byte *end, ojSpan span);
+    // Returns the byte after the first comma between b and end that
+    // separates elements of the top level array given the string state and
+    // depth at b, or NULL if there is none.
+    extern const byte*	_oj_span_split(const byte *base,
+				       const byte *b,
+				       const byte *end,
+				       bool in_string,
+				       long long depth);
+
+    // Reads an fd ahead of the parser into a ring of '\0' terminated
+    // blocks. With uring true and a regular file the reads are made with
+    // io_uring if the kernel allows it, otherwise a thread does the reading.
+    typedef struct _ojReader	*ojReader;
+
+    extern ojReader	_oj_reader_start(ojErr err, int fd, bool uring);
+    // Returns the next block and sets lenp to its length, or returns NULL at
+    // the end or on an error. A block stays valid until the next call.
+    extern const byte*	_oj_reader_next(ojErr err, ojReader r, size_t *lenp);
+    extern void		_oj_reader_stop(ojReader r);
+
+    // Parses len bytes at buf with a push parser. The byte at buf[len] is
+    // replaced with a '\0' so it must be writable.
+    extern ojStatus	_oj_parser_block(ojErr err, ojParser p, byte *buf, size_t len);
+
+    // Threads wait on a park for a condition another thread makes true
+    // and then wakes the park. Waiting spins up to oj_wait_spin times
+    // before sleeping on a futex.
+    extern void		_oj_wait(ojPark pk, bool (*ready)(void *ctx), void *ctx);
+    extern void		_oj_wake(ojPark pk);
 
 #ifdef __cplusplus
 }
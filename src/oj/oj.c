@@ -72,8 +72,8 @@ oj_type_str(ojType type) {
     }
 }
 
-static void
-buf_append_json(ojBuf buf, const char *s) {
+void
+_oj_buf_append_json(ojBuf buf, const char *s) {
     // TBD might be faster moving forward until a special char and then appending the string up till then
     for (; '\0' != *s; s++) {
 	if ((byte)*s < 0x20) {
@@ -105,12 +105,18 @@ oj_buf(ojBuf buf, ojVal val, int indent, int depth) {
 	    break;
 	case OJ_INT:
 	    if (0 == val->num.len) {
+		if (!val->num.calc) {
+		    _oj_calc_num(val);
+		}
 		val->num.len = snprintf(val->num.raw, sizeof(val->num.raw), "%lld", (long long)val->num.fixnum);
 	    }
 	    oj_buf_append_string(buf, val->num.raw, (size_t)val->num.len);
 	    break;
 	case OJ_DECIMAL:
 	    if (0 == val->num.len) {
+		if (!val->num.calc) {
+		    _oj_calc_num(val);
+		}
 		val->num.len = snprintf(val->num.raw, sizeof(val->num.raw), "%Lg", val->num.dub);
 	    }
 	    oj_buf_append_string(buf, val->num.raw, (size_t)val->num.len);
@@ -121,15 +127,15 @@ oj_buf(ojBuf buf, ojVal val, int indent, int depth) {
 	case OJ_STRING: {
 	    const char	*s;
 
-	    if (sizeof(union _ojS4k) < val->str.len) {
+	    if (val->str.borrow || sizeof(union _ojS4k) <= val->str.len) {
 		s = val->str.ptr;
-	    } else if (sizeof(val->str.raw) < val->str.len) {
+	    } else if (sizeof(val->str.raw) <= val->str.len) {
 		s = val->str.s4k->str;
 	    } else {
 		s = val->str.raw;
 	    }
 	    oj_buf_append(buf, '"');
-	    buf_append_json(buf, s);
+	    _oj_buf_append_json(buf, s);
 	    oj_buf_append(buf, '"');
 	    break;
 	}
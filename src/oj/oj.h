@@ -21,6 +21,7 @@ extern "C" {
 
 #define OJ_ERR_INIT		{ .code = 0, .line = 0, .col = 0, .msg = { '\0' } }
 #define OJ_ERR_START		300
+#define OJ_CURSOR_DEPTH		1024
 #define OJ_BUILDER_INIT		{ .top = NULL, .stack = NULL, .err = { .code = 0, .line = 0, .col = 0, .msg = { '\0' } } }
 
     typedef enum {
@@ -62,6 +63,20 @@ extern "C" {
 	OJ_OBJ_HASH	= 'h',
     } ojMod;
 
+    typedef enum {
+	OJ_SIMD_NONE	= 0,
+	OJ_SIMD_SSE	= 1,
+	OJ_SIMD_AVX2	= 2,
+    } ojSimd;
+
+    typedef enum {
+	OJ_READ_AUTO	= 0,
+	OJ_READ_BLOCK	= 1,
+	OJ_READ_MAP	= 2,
+	OJ_READ_THREAD	= 3,
+	OJ_READ_URING	= 4,
+    } ojReadMode;
+
     typedef struct _ojBuf {
 	char		*head;
 	char		*end;
@@ -86,6 +101,8 @@ extern "C" {
 
     typedef struct _ojStr {
 	int		len;	// length of raw or ptr excluding \0
+	bool		borrow;	// ptr is into the parsed buffer, not owned
+	bool		intern;	// with borrow, ptr is an interned key and kh is set
 	union {
 	    char	raw[120];
 	    ojS4k	s4k;
@@ -136,6 +153,38 @@ extern "C" {
 	};
     } *ojVal;
 
+    // A tape entry. Arrays and objects are followed by their members and
+    // list.end is the index of the entry after the last of them.
+    typedef struct _ojEntry {
+	uint8_t			type;	// ojType
+	uint8_t			shift;	// decimal places in fixnum
+	unsigned int		exp:14;	// decimal exponent
+	unsigned int		exp_neg:1;
+	unsigned int		neg:1;	// decimals only, ints are signed
+	uint32_t		key;	// arena offset of the key, 0 if none
+	union {
+	    int64_t		fixnum;
+	    struct {
+		uint32_t	off;	// arena offset
+		uint32_t	len;
+	    } str;			// string and bignum
+	    struct {
+		uint32_t	end;
+		uint32_t	cnt;	// number of members
+	    } list;
+	};
+    } *ojEntry;
+
+    // A parsed document stored as a flat tape of entries. Strings, keys, and
+    // bignums are kept in the arena, each preceded by a 4 byte length and
+    // followed by a '\0'.
+    typedef struct _ojDoc {
+	ojEntry			tape;
+	char			*arena;
+	uint32_t		cnt;
+	uint32_t		alen;
+    } *ojDoc;
+
     typedef ojCallbackOp	(*ojParseCallback)(ojVal val, void *ctx);
     typedef void		(*ojPushFunc)(ojVal val, void *ctx);
     typedef void		(*ojPopFunc)(void *ctx);
@@ -146,23 +195,65 @@ extern "C" {
 	ojVal			dig;
     } *ojReuser;
 
+    typedef struct _ojPark {
+	atomic_uint		seq;
+	atomic_uint		waiters;
+    } *ojPark;
+
     typedef struct _ojCall {
 	ojVal			val;
 	struct _ojReuser	reuser;
-	atomic_flag		busy;
+	long long		seq;
     } *ojCall;
 
+    // Documents are published to the caller thread in groups. A group is
+    // closed when it has group_max documents, when group_usec has passed
+    // since it was opened, or at the end of each block of input. Both can
+    // be changed after the caller is started.
     typedef struct _ojCaller {
 	struct _ojCall		queue[256];
 	pthread_t		thread;
 	ojParseCallback		cb;
 	void			*ctx;
-	ojCall			end;
-	ojCall			tail;
-	atomic_flag		starting;
+	long long		written;
+	int64_t			opened;	// when the open group was started
+	atomic_llong		published;
+	atomic_llong		consumed;
+	struct _ojPark		park;
+	int			group_max;
+	int			group_usec;
 	volatile bool		done;
+	atomic_bool		shutdown;
+	struct _ojCallPool	*pool;	// shared by all the workers of a pool
     } *ojCaller;
 
+    // A push parser is fed input as it arrives and keeps its state between
+    // feeds so a document may be split anywhere.
+    typedef struct _ojParser	*ojParser;
+
+    typedef struct _ojFilter	*ojFilter;
+    typedef struct _ojIngest	*ojIngest;
+    typedef void		(*ojIngestEnd)(int fd, ojErr err, void *ctx);
+
+    // A forward only cursor over a '\0' terminated document. The cursor is
+    // either on a value or just after one. Nothing is made from a value until
+    // it is asked for and a value that is passed over is checked but not
+    // read. Once there is an error it is left in err and the cursor is on no
+    // value.
+    typedef struct _ojCursor {
+	const char		*json;
+	const char		*pos;	// the current value or the byte after the last one
+	const char		*key;	// the current member key as it is in the JSON
+	int			klen;
+	int			depth;
+	bool			in_val;	// true if pos is on a value
+	bool			kesc;	// true if the key has escapes
+	uint64_t		objs[OJ_CURSOR_DEPTH / 64]; // set for each object depth
+	char			*sbuf;	// decoded strings
+	size_t			scap;
+	struct _ojErr		err;
+    } *ojCursor;
+
     typedef struct _ojBuilder {
 	ojVal			top;
 	ojVal			stack;
@@ -177,14 +268,42 @@ extern "C" {
     extern void		oj_err_init(ojErr err);
     extern const char*	oj_status_str(ojStatus code);
 
+    // The SIMD level is picked from the CPU features at startup. It can be
+    // lowered but not raised above what the CPU supports.
+    extern ojSimd	oj_simd_get(void);
+    extern void		oj_simd_set(ojSimd level);
+
     extern ojStatus	oj_caller_start(ojErr err, ojCaller caller, ojParseCallback cb, void *ctx);
+    // Starts worker threads that make the callbacks with documents handed
+    // out in turn. If workers is less than one there is one per core less
+    // the one for the parser. With ordered true the callbacks are made one
+    // at a time in document order and only the destroying of documents is
+    // spread over the workers. Vals are locked until the pool is shut down
+    // or waited on.
+    extern ojStatus	oj_caller_start_pool(ojErr		err,
+					     ojCaller		caller,
+					     int		workers,
+					     bool		ordered,
+					     ojParseCallback	cb,
+					     void		*ctx);
     extern void		oj_caller_shutdown(ojCaller caller);
     extern void		oj_caller_wait(ojCaller caller);
 
     extern ojStatus	oj_validate_str(ojErr err, const char *json);
+    // Validates the input a block at a time, read the same way as by
+    // oj_parse_fd(), so memory use does not grow with the size of the input.
+    extern ojStatus	oj_validate_fd(ojErr err, int fd);
+    extern ojStatus	oj_validate_file(ojErr err, const char *filepath);
 
     extern ojVal	oj_parse_str(ojErr err, const char *json, ojReuser reuser);
     extern ojVal	oj_parse_strp(ojErr err, const char **json, ojReuser reuser);
+
+    // Strings and keys without escapes are left in the json buffer and
+    // referenced instead of copied. The closing quotes are replaced with a
+    // '\0' so the buffer must be writable and must outlive the result.
+    extern ojVal	oj_parse_str_insitu(ojErr err, char *json, ojReuser reuser);
+    extern ojVal	oj_parse_strp_insitu(ojErr err, char **json, ojReuser reuser);
+
     extern ojStatus	oj_parse_str_cb(ojErr err, const char *json, ojParseCallback cb, void *ctx);
     extern ojStatus	oj_parse_str_call(ojErr err, const char *json, ojCaller caller);
     extern ojStatus	oj_pp_parse_str(ojErr		err,
@@ -193,6 +312,58 @@ extern "C" {
 					ojPopFunc	pop,
 					void		*ctx);
 
+    // Builds an index of the structural characters in a SIMD pass and then
+    // builds the values from the index. Multiple documents require the
+    // callback version.
+    extern ojVal	oj_parse_indexed(ojErr err, const char *json, ojReuser reuser);
+    extern ojStatus	oj_parse_indexed_cb(ojErr err, const char *json, ojParseCallback cb, void *ctx);
+
+    // Parses a single document onto a tape. Much less memory is used than
+    // with an ojVal tree but the result can not be modified.
+    extern ojDoc	oj_doc_parse(ojErr err, const char *json);
+    extern void		oj_doc_destroy(ojDoc doc);
+
+    extern ojEntry	oj_doc_root(ojDoc doc);
+    extern const char*	oj_doc_key(ojDoc doc, ojEntry e);
+    extern const char*	oj_doc_str(ojDoc doc, ojEntry e);
+    extern int64_t	oj_doc_int(ojEntry e);
+    extern long double	oj_doc_double(ojEntry e);
+    extern const char*	oj_doc_bignum(ojDoc doc, ojEntry e);
+    extern int		oj_doc_len(ojEntry e);
+    extern ojEntry	oj_doc_array_nth(ojDoc doc, ojEntry e, int n);
+    extern ojEntry	oj_doc_object_get(ojDoc doc, ojEntry e, const char *key, int len);
+    // for object and list, if cb return false then stop
+    extern ojEntry	oj_doc_each(ojDoc doc, ojEntry e, bool (*cb)(ojDoc doc, ojEntry e, void* ctx), void *ctx);
+    extern char*	oj_doc_to_str(ojDoc doc, ojEntry e);
+
+    // The cursor starts on the top value. The type of the current value is
+    // found by looking at its first bytes and is OJ_NONE if the cursor is
+    // not on a value. A cursor entered into an object or array is on the
+    // first member or element, or after the container if it is empty.
+    // Moving to the next member passes over the current value and returns
+    // false at the end of the container with the cursor left after it so
+    // the next call continues with the container's parent. Keys are as they
+    // are in the JSON, with any escapes.
+    extern ojStatus	oj_cursor_init(ojCursor c, const char *json);
+    extern void		oj_cursor_cleanup(ojCursor c);
+    extern ojType	oj_cursor_type(ojCursor c);
+    extern const char*	oj_cursor_key(ojCursor c, int *lenp);
+    extern bool		oj_cursor_enter(ojCursor c);
+    extern bool		oj_cursor_next(ojCursor c);
+    // Moves forward through the members of the current object to the one
+    // with key. Returns false if the object ends first.
+    extern bool		oj_cursor_find(ojCursor c, const char *key, int len);
+    // Passes over the current value and returns its bytes in the JSON.
+    extern const char*	oj_cursor_skip(ojCursor c, int *lenp);
+    // Reading a value moves the cursor past it. A value of the wrong type
+    // is an OJ_ERR_TYPE error. A string without escapes is not copied and
+    // is not terminated, otherwise it is decoded into the cursor and is
+    // valid until the next decode or the cursor cleanup.
+    extern int64_t	oj_cursor_int(ojCursor c);
+    extern double	oj_cursor_double(ojCursor c);
+    extern const char*	oj_cursor_str(ojCursor c, int *lenp);
+    extern bool		oj_cursor_bool(ojCursor c);
+
     extern ojVal	oj_parse_fd(ojErr err, int fd, ojReuser reuser);
     extern ojStatus	oj_parse_fd_cb(ojErr err, int fd, ojParseCallback cb, void *ctx);
     extern ojStatus	oj_parse_fd_call(ojErr err, int fd, ojCaller caller);
@@ -211,6 +382,111 @@ extern "C" {
 					 ojPopFunc	pop,
 					 void		*ctx);
 
+    // A filter keeps only the object members on a set of paths such as
+    // "level" or "attachment.user.id". A member at the end of a path is
+    // kept with everything in it. Other members are validated but no vals
+    // are made for them and nothing is copied. The elements of an array are
+    // filtered with the same paths as the array. The paths are a NULL
+    // terminated list.
+    extern ojFilter	oj_filter_create(ojErr err, const char **paths);
+    extern void		oj_filter_destroy(ojFilter filter);
+
+    extern ojVal	oj_parse_str_filter(ojErr err, const char *json, ojFilter filter, ojReuser reuser);
+    extern ojStatus	oj_parse_str_filter_cb(ojErr		err,
+					       const char	*json,
+					       ojFilter		filter,
+					       ojParseCallback	cb,
+					       void		*ctx);
+    extern ojStatus	oj_parse_fd_filter_cb(ojErr		err,
+					      int		fd,
+					      ojFilter		filter,
+					      ojParseCallback	cb,
+					      void		*ctx);
+    extern ojStatus	oj_parse_file_filter_cb(ojErr		err,
+						const char	*filepath,
+						ojFilter	filter,
+						ojParseCallback	cb,
+						void		*ctx);
+
+    // Documents fed to a push parser are given to the callback or handed to
+    // the caller as each one is completed. A number at the top level is only
+    // complete once oj_parser_finish() is called at the end of the input.
+    // After an error or a stop the parser must be reset before it is fed
+    // again. The caller is not ended by the parser.
+    extern ojParser	oj_parser_create_cb(ojErr err, ojParseCallback cb, void *ctx);
+    extern ojParser	oj_parser_create_call(ojErr err, ojCaller caller);
+    extern ojStatus	oj_parser_feed(ojErr err, ojParser p, const char *buf, size_t len);
+    extern ojStatus	oj_parser_finish(ojErr err, ojParser p);
+    // Sets the filter for the documents that follow. It should only be
+    // changed between documents.
+    extern void		oj_parser_set_filter(ojParser p, ojFilter filter);
+    extern void		oj_parser_reset(ojParser p);
+    extern void		oj_parser_destroy(ojParser p);
+
+    // An ingest engine reads documents from many connections on a few
+    // threads that each wait on an epoll set. Each connection has its own
+    // push parser. The end function, if not NULL, is called once for each
+    // connection at the end of its input, on an error, on a stop by the
+    // callback, or when the engine is stopped, and then the fd is closed. A
+    // threads count of 0 or less uses one thread per core. With more than
+    // one thread vals are locked until the engine is stopped.
+    extern ojIngest	oj_ingest_start(ojErr err, int threads);
+    extern ojStatus	oj_ingest_add(ojErr		err,
+				      ojIngest		ing,
+				      int		fd,
+				      ojParseCallback	cb,
+				      ojIngestEnd	end,
+				      void		*ctx);
+    // Connections that share a caller are all read on the same thread since
+    // a caller takes documents from only one thread.
+    extern ojStatus	oj_ingest_add_call(ojErr	err,
+					   ojIngest	ing,
+					   int		fd,
+					   ojCaller	caller,
+					   ojIngestEnd	end,
+					   void		*ctx);
+    extern void		oj_ingest_stop(ojIngest ing);
+
+    // Parses a file of documents that are each on one line with several
+    // threads. The file is split into chunks at newlines and each chunk is
+    // parsed by one of the threads. If ordered the callback is made from the
+    // calling thread in document order, otherwise from the parsing threads
+    // as documents complete. A threads count of 0 or less uses one thread
+    // per core. Vals are locked while it runs. Input that can't be mapped is
+    // parsed on the calling thread.
+    extern ojStatus	oj_parse_fd_parallel(ojErr		err,
+					     int		fd,
+					     int		threads,
+					     bool		ordered,
+					     ojParseCallback	cb,
+					     void		*ctx);
+    extern ojStatus	oj_parse_file_parallel(ojErr		err,
+					       const char	*filepath,
+					       int		threads,
+					       bool		ordered,
+					       ojParseCallback	cb,
+					       void		*ctx);
+
+    // Parses a file that holds one large array with several threads. The
+    // elements are split into chunks at the commas between them and each
+    // chunk is parsed by one of the threads. The elements are either joined
+    // into one array or given to the callback in order from the calling
+    // thread. A threads count of 0 or less uses one thread per core. Vals
+    // are locked while it runs. A document that is not an array is parsed
+    // on the calling thread.
+    extern ojVal	oj_parse_fd_array(ojErr err, int fd, int threads, ojReuser reuser);
+    extern ojStatus	oj_parse_fd_array_cb(ojErr		err,
+					     int		fd,
+					     int		threads,
+					     ojParseCallback	cb,
+					     void		*ctx);
+    extern ojVal	oj_parse_file_array(ojErr err, const char *filepath, int threads, ojReuser reuser);
+    extern ojStatus	oj_parse_file_array_cb(ojErr		err,
+					       const char	*filepath,
+					       int		threads,
+					       ojParseCallback	cb,
+					       void		*ctx);
+
     extern ojVal	oj_val_create();
     extern void		oj_destroy(ojVal val);
     extern void		oj_reuse(ojReuser reuser);
@@ -264,7 +540,41 @@ extern "C" {
     extern ojStatus	oj_build_pop(ojBuilder b);
     extern void		oj_build_popall(ojBuilder b);
 
+    // Locks the shared lists of free vals and strings. Set it when vals are
+    // created or destroyed on more than one thread outside of the parallel
+    // parsers, caller pools, and ingest engines, which lock them only while
+    // they run.
     extern bool		oj_thread_safe;
+    // Regular files over 100K may be parsed through a sliding window of
+    // mapped pages instead of being read. This is the window size in bytes.
+    extern size_t	oj_map_window;
+    // How the fd parse functions get input. OJ_READ_BLOCK reads on the
+    // calling thread, OJ_READ_MAP maps regular files, OJ_READ_THREAD reads
+    // ahead on a separate thread and OJ_READ_URING keeps several reads in
+    // flight with io_uring, falling back to a thread if that is not
+    // available. OJ_READ_AUTO picks based on the fd type and size.
+    extern ojReadMode	oj_read_mode;
+    // Threads handing work to each other spin this many times before
+    // sleeping. Higher values lower latency and lower ones save CPU when
+    // the other side is slow. Zero sleeps right away.
+    extern int		oj_wait_spin;
+    // When true numbers are left as digits and exponents by the parser and
+    // converted the first time they are read with oj_int_get(),
+    // oj_double_get(), or oj_bignum_get() or written.
+    extern bool		oj_lazy_num;
+    // When true keys of up to 64 bytes without escapes are interned by the
+    // parsers. Each distinct key is stored once and shared by every val
+    // with that key, with its hash already set. The keys are kept until
+    // oj_cleanup() which must not be called while vals with interned keys
+    // are still in use. Parsers that read a stream of documents also
+    // predict keys from the earlier documents when this is set at the time
+    // the parse starts or the ojParser is created.
+    extern bool		oj_intern_keys;
+    // When true the parsers do not count lines as they go. The line and
+    // column of an error are found from the input before it only when an
+    // error is reported, and input read a block at a time counts the lines
+    // of each block once it is parsed. Set it before starting a parse.
+    extern bool		oj_lazy_lines;
 
 #ifdef __cplusplus
 }
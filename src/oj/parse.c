@@ -9,32 +9,83 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "oj.h"
+#include "debug.h"
 #include "intern.h"
 
 #define DEBUG	0
 
-#define USE_THREAD_LIMIT	100000
-#define MAX_EXP			4932
+#define USE_URING_LIMIT		1000000
+#define USE_MAP_LIMIT		100000
+#define PAR_MIN_CHUNK		(64 * 1024)
+#define PAR_MAX_CHUNK		(4 * 1024 * 1024)
 // max in the pow_map
 #define MAX_POW			400
 
 #define MIN_SLEEP	(1000000000LL / (double)CLOCKS_PER_SEC)
 
+size_t		oj_map_window = 4 * 1024 * 1024;
+ojReadMode	oj_read_mode = OJ_READ_AUTO;
+bool		oj_lazy_num = false;
+bool		oj_lazy_lines = false;
+
+// Indentation is usually short so the first few bytes are checked inline
+// before handing off to the vector kernel for longer runs.
+static inline const byte*
+skip_space(const byte *b, int *lines, const byte **nl) {
+    for (const byte *end = b + 16; b < end; b++) {
+	switch (*b) {
+	case ' ':
+	case '\t':
+	case '\r':
+	    break;
+	case '\n':
+	    (*lines)++;
+	    *nl = b;
+	    break;
+	default:
+	    return b;
+	}
+    }
+    return _oj_skip_space(b, lines, nl);
+}
+
+// Skips whitespace without keeping the line count for oj_lazy_lines.
+static inline const byte*
+skip_white(const byte *b) {
+    int		lines = 0;
+    const byte	*nl = NULL;
+
+    return skip_space(b, &lines, &nl);
+}
+
+// Adds the lines from b to end and leaves the column offset of the last
+// newline relative to b just as the parse loop does.
 static void
-one_beat() {
-    struct timespec	ts = { .tv_sec = 0, .tv_nsec = 100 };
+count_lines(ojErr err, const byte *b, const byte *end) {
+    const byte	*start = b;
 
-    pselect(0, NULL, NULL, NULL, &ts, 0);
+    for (; b < end && NULL != (b = (const byte*)memchr(b, '\n', end - b)); b++) {
+	err->line++;
+	err->col = (int)(b - start);
+    }
 }
 
-// Give better performance with indented JSON but worse with unindented.
-//#define SPACE_JUMP
+// Called at the end of each block of len bytes so the column is carried to
+// the next block.
+static inline void
+block_end(ojErr err, const byte *buf, size_t len) {
+    if (oj_lazy_lines) {
+	count_lines(err, buf, buf + len);
+    }
+    err->col -= (int)len;
+}
 
 enum {
     SKIP_CHAR		= 'a',
@@ -93,11 +144,49 @@ typedef struct _ojValidator {
     struct _ojErr	err;
     int			depth;
     int			ri;
-    // TBD change this stack to be expandable
-    char		stack[1024];
+    char		token[8];
+    byte		*stack;	// '{' or '[' for each open container
+    int			scap;
 } *ojValidator;
 
-typedef struct _ojParser {
+// Documents in a stream usually share a schema so their objects have the
+// same keys in the same order. A shape holds the keys last seen at each
+// member index of the objects at one place in a document along with the
+// shapes of the member values. The elements of an array share one shape.
+// An incoming key is compared to the predicted key before it is scanned and
+// a match reuses the interned key and hash.
+#define SHAPE_KEYS	32	// members predicted in each object
+#define SHAPE_KEY_MAX	64
+#define SHAPE_DEPTH	32
+#define SHAPE_MAX	256	// shapes for one parser
+
+typedef struct _ShapeKey {
+    const char	*key;	// interned key or raw, NULL if no prediction
+    int		len;
+    uint32_t	kh;
+    bool	intern;
+    char	raw[SHAPE_KEY_MAX + 1];
+} *ShapeKey;
+
+typedef struct _Shape {
+    struct _Shape	*next;
+    struct _ShapeKey	keys[SHAPE_KEYS];
+    struct _Shape	*kids[SHAPE_KEYS];
+} *Shape;
+
+typedef struct _Shapes {
+    Shape	root;	// shape of the top level value of each document
+    Shape	list;	// all shapes so they can be freed
+    int		cnt;
+    int		depth;	// open containers, can be more than SHAPE_DEPTH
+    struct {
+	Shape	shape;
+	int	i;	// next member index
+	bool	array;
+    } frames[SHAPE_DEPTH];
+} *Shapes;
+
+struct _ojParser {
     const char		*map;
     const char		*next_map;
     ojVal		stack;
@@ -119,24 +208,43 @@ typedef struct _ojParser {
 
     char		token[8];
     int			ri;
+    int			word;	// bytes of a bad word before the error
     uint32_t		ucode;
     bool		pp;
     bool		has_cb;
     bool		has_caller;
-} *ojParser;
-
-typedef struct _ReadBlock {
-    atomic_flag		busy;
-    ojStatus		status;
-    bool		eof;
-    byte		buf[16385];
-} *ReadBlock;
+    bool		insitu;
+    bool		pooled;	// destroyed vals go on pool instead of the free list
+    bool		more;	// more input follows so a number at the end is not done
+    ojVal		pool;
+    ojVal		root;	// open array the elements of a chunk are parsed into
+    byte		*feed;	// terminated copy of the input given to oj_parser_feed()
+
+    ojFilter		filter;	// members not on a filter path are skipped
+    ojFilter		fnext;	// filter node for the next value
+    ojFilter		*fstack;	// filter nodes of the open containers
+    int			fdepth;
+    int			fcap;
+    bool		key_kept;	// the key just read was checked and kept
+    bool		skip_next;	// the value after the colon is skipped
+    bool		skipping;	// in the middle of a skipped value
+    byte		*sstack;	// '{' or '[' for each container open in a skipped value
+    int			sdepth;
+    int			scap;
+
+    Shapes		shapes;	// key predictions, NULL if not predicting
+    ojValidator		validator;	// blocks are validated instead of parsed
+};
 
-typedef struct _ReadCtx {
-    struct _ReadBlock	blocks[16];
-    ReadBlock		bend;
-    int			fd;
-} *ReadCtx;
+// A filter is a tree of nodes, one for each key on a path. A node at the
+// end of a path keeps all of the value.
+struct _ojFilter {
+    char		*key;
+    size_t		len;
+    struct _ojFilter	*kids;
+    int			cnt;
+    bool		all;
+};
 
 /*
 0123456789abcdef0123456789abcdef */
@@ -431,16 +539,6 @@ a...............................\
 ................................R";
 
 
-static const char	space_map[257] = "\
-.........ab..a..................\
-a...............................\
-................................\
-................................\
-................................\
-................................\
-................................\
-................................S";
-
 static const byte	hex_map[256] = "\
 ................................\
 ................\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09......\
@@ -496,6 +594,7 @@ static long double	pow_map[401] = {
 };
 
 static void	oj_caller_push(ojParser p, ojCaller caller, ojVal val);
+static void	caller_flush(ojCaller caller);
 
 #if DEBUG
 static void
@@ -511,8 +610,8 @@ print_stack(ojParser p, const char *label) {
 
 // Works with extended unicode as well. \Uffffffff if support is desired in
 // the future.
-static size_t
-unicodeToUtf8(uint32_t code, byte *buf) {
+size_t
+_oj_unicode_to_utf8(uint32_t code, byte *buf) {
     byte	*start = buf;
 
     if (0x0000007F >= code) {
@@ -569,11 +668,29 @@ byte_error(ojErr err, const char *map, int off, byte b) {
     return err->code;
 }
 
+// Vals with storage outside the val go on the dig list so that storage is
+// freed when they are reused.
+static void
+add_to_all(ojParser p, ojVal v) {
+    if ((OJ_STRING == v->type && !v->str.borrow && sizeof(v->str.raw) <= v->str.len) ||
+	(OJ_BIG == v->type && sizeof(v->num.raw) <= v->num.len) ||
+	(!v->key.borrow && sizeof(v->key.raw) <= v->key.len)) {
+	v->free = p->all_dig;
+	p->all_dig = v;
+    } else {
+	v->free = p->all_head;
+	if (NULL == p->all_head) {
+	    p->all_tail = v;
+	}
+	p->all_head = v;
+    }
+}
+
 static void
 parse_free_stack(ojParser p) {
     ojVal	v;
 
-    while (NULL != (v = p->stack)) {
+    while (NULL != (v = p->stack) && p->root != v) {
 	bool	found = false;
 
 	p->stack = v->next;
@@ -590,18 +707,7 @@ parse_free_stack(ojParser p) {
 	    }
 	}
 	if (!found) {
-	    if ((OJ_STRING == v->type && sizeof(v->str.raw) <= v->str.len) ||
-		(OJ_BIG == v->type && sizeof(v->num.raw) <= v->num.len) ||
-		sizeof(v->key.raw) <= v->key.len) {
-		v->free = p->all_dig;
-		p->all_dig = v;
-	    } else {
-		v->free = p->all_head;
-		if (NULL == p->all_head) {
-		    p->all_tail = v;
-		}
-		p->all_head = v;
-	    }
+	    add_to_all(p, v);
 	}
     }
 }
@@ -619,11 +725,44 @@ parse_error(ojParser p, const char *fmt, ...) {
     return p->err.code;
 }
 
-static ojVal
-push_val(ojParser p, ojType type, ojMod mod) {
+// Reports a bad true, false, or null at b with in_word bytes of the word
+// before b. The word is read whole before it is checked so a newline in it
+// is not counted and with oj_lazy_lines the newlines are also only counted
+// up to the start of the word.
+static ojStatus
+word_error(ojParser p, const byte *b, const byte *json, int in_word, const char *word) {
+    p->err.col = b - json - p->err.col;
+    p->word = in_word;
+
+    return parse_error(p, "expected %s", word);
+}
+
+static inline ojVal
+val_create(ojParser p) {
+    ojVal	val = p->pool;
+
+    if (NULL == val) {
+	return oj_val_create();
+    }
+    p->pool = val->free;
+
+    return val;
+}
+
+// Each way of handing off vals has its own copy of the parse loop with
+// push_val() and pop_val() built for only that way.
+enum {
+    MODE_TREE,
+    MODE_CB,
+    MODE_CALLER,
+    MODE_PP,
+};
+
+static inline ojVal
+push_mode(ojParser p, const int mode, ojType type, ojMod mod) {
     ojVal	val;
 
-    if (p->pp) {
+    if (MODE_PP == mode) {
 	if (NULL != p->stack && OJ_NONE == p->stack->type) { // indicates a object member
 	    val = p->stack;
 	    val->type = type;
@@ -633,6 +772,7 @@ push_val(ojParser p, ojType type, ojMod mod) {
 	    val->type = type;
 	    val->mod = mod;
 	    val->key.len = 0;
+	    val->key.borrow = false;
 	    val->next = p->stack;
 	    p->stack = val;
 	} else {
@@ -640,6 +780,7 @@ push_val(ojParser p, ojType type, ojMod mod) {
 	    val->type = type;
 	    val->mod = mod;
 	    val->key.len = 0;
+	    val->key.borrow = false;
 	    val->next = p->stack;
 	    p->stack = val;
 	}
@@ -653,10 +794,11 @@ push_val(ojParser p, ojType type, ojMod mod) {
 	    val->type = type;
 	    val->mod = mod;
 	} else {
-	    val = oj_val_create();
+	    val = val_create(p);
 	    val->type = type;
 	    val->mod = mod;
 	    val->key.len = 0;
+	    val->key.borrow = false;
 	    val->next = p->stack;
 	    p->stack = val;
 	}
@@ -665,12 +807,12 @@ push_val(ojParser p, ojType type, ojMod mod) {
 }
 
 // Return true to stop.
-static bool
-pop_val(ojParser p) {
+static inline bool
+pop_mode(ojParser p, const int mode) {
     ojVal	parent;
     ojVal	top = p->stack;
 
-    if (p->pp) {
+    if (MODE_PP == mode) {
 	if (OJ_ARRAY == top->type || OJ_OBJECT == top->type) {
 	    p->pop(p->ctx);
 	    _oj_val_clear(top);
@@ -687,9 +829,9 @@ pop_val(ojParser p) {
 	}
     } else {
 	// add to all list
-	if ((OJ_STRING == top->type && sizeof(top->str.raw) <= top->str.len) ||
+	if ((OJ_STRING == top->type && !top->str.borrow && sizeof(top->str.raw) <= top->str.len) ||
 	    (OJ_BIG == top->type && sizeof(top->num.raw) <= top->num.len) ||
-	    sizeof(top->key.raw) <= top->key.len) {
+	    (!top->key.borrow && sizeof(top->key.raw) <= top->key.len)) {
 	    top->free = p->all_dig;
 	    p->all_dig = top;
 	} else {
@@ -699,8 +841,8 @@ pop_val(ojParser p) {
 	    }
 	    p->all_head = top;
 	}
-	if (NULL == (parent = top->next)) {
-	    if (p->has_cb) {
+	if (NULL == (parent = top->next) || (MODE_CB == mode && parent == p->root)) {
+	    if (MODE_CB == mode) {
 		ojCallbackOp	op = p->cb(top, p->ctx);
 
 		if (0 != (OJ_DESTROY & op)) {
@@ -709,16 +851,27 @@ pop_val(ojParser p) {
 			.tail = p->all_tail,
 			.dig = p->all_dig,
 		    };
-		    oj_reuse(&r);
-		}
-		if (0 != (OJ_STOP & op)) {
-		    return true;
+		    if (p->pooled) {
+			_oj_reuse_keep(&r);
+			if (NULL != r.tail) {
+			    r.tail->free = p->pool;
+			    p->pool = r.head;
+			}
+		    } else {
+			oj_reuse(&r);
+		    }
 		}
+		// The vals now belong to the callback or were reused so the
+		// parser is left ready for the next document even on a stop.
 		p->all_head = NULL;
 		p->all_tail = NULL;
 		p->all_dig = NULL;
-		p->map = value_map;
-	    } else if (p->has_caller) {
+		p->map = (NULL == parent) ? value_map : after_map;
+		if (0 != (OJ_STOP & op)) {
+		    p->stack = parent;
+		    return true;
+		}
+	    } else if (MODE_CALLER == mode) {
 		oj_caller_push(p, p->caller, top);
 		p->stack = NULL;
 		p->map = value_map;
@@ -729,7 +882,7 @@ pop_val(ojParser p) {
 		p->results = p->stack;
 		p->map = trail_map;
 	    }
-	    p->stack = NULL;
+	    p->stack = parent;
 	} else {
 	    if (NULL == parent->list.head) {
 		parent->list.head = top;
@@ -745,8 +898,53 @@ pop_val(ojParser p) {
     return false;
 }
 
-static void
-calc_num(ojVal v) {
+static ojVal
+push_tree(ojParser p, ojType type, ojMod mod) {
+    return push_mode(p, MODE_TREE, type, mod);
+}
+
+static ojVal
+push_pp(ojParser p, ojType type, ojMod mod) {
+    return push_mode(p, MODE_PP, type, mod);
+}
+
+static bool
+pop_tree(ojParser p) {
+    return pop_mode(p, MODE_TREE);
+}
+
+static bool
+pop_cb(ojParser p) {
+    return pop_mode(p, MODE_CB);
+}
+
+static bool
+pop_caller(ojParser p) {
+    return pop_mode(p, MODE_CALLER);
+}
+
+static bool
+pop_pp(ojParser p) {
+    return pop_mode(p, MODE_PP);
+}
+
+// Return true to stop.
+static bool
+pop_val(ojParser p) {
+    if (p->pp) {
+	return pop_pp(p);
+    }
+    if (p->has_cb) {
+	return pop_cb(p);
+    }
+    if (p->has_caller) {
+	return pop_caller(p);
+    }
+    return pop_tree(p);
+}
+
+void
+_oj_calc_num(ojVal v) {
     switch (v->type) {
     case OJ_INT:
 	if (v->num.neg) {
@@ -754,6 +952,13 @@ calc_num(ojVal v) {
 	}
 	break;
     case OJ_DECIMAL: {
+	int		exp10 = (v->num.exp_neg ? -v->num.exp : v->num.exp) - v->num.shift;
+	double		dd;
+
+	if (_oj_dec_to_double((uint64_t)v->num.fixnum, exp10, v->num.neg, &dd)) {
+	    v->num.dub = dd;
+	    break;
+	}
 	long double	d = (long double)v->num.fixnum;
 
 	if (v->num.neg) {
@@ -780,6 +985,14 @@ calc_num(ojVal v) {
 	break;
     }
     }
+    v->num.calc = true;
+}
+
+static inline void
+calc_num(ojVal v) {
+    if (!oj_lazy_num) {
+	_oj_calc_num(v);
+    }
 }
 
 static void
@@ -845,550 +1058,386 @@ big_change(ojVal v) {
     }
 }
 
-static ojStatus
-parse(ojParser p, const byte *json) {
-    const byte *start;
-    ojVal	v;
-    const byte	*b = json;
+//// filter
+
+// Returns true if the member with key is kept and sets the node for its
+// value. A node that keeps all of its value keeps every member.
+static bool
+filter_key(ojParser p, const char *key, size_t len) {
+    ojFilter	node = (0 < p->fdepth) ? p->fstack[p->fdepth - 1] : p->filter;
+
+    if (node->all) {
+	p->fnext = node;
+	return true;
+    }
+    for (ojFilter f = node->kids, end = f + node->cnt; f < end; f++) {
+	if (len == f->len && 0 == memcmp(key, f->key, len)) {
+	    p->fnext = f;
+	    return true;
+	}
+    }
+    return false;
+}
+
+static void
+filter_push(ojParser p) {
+    if (p->fcap <= p->fdepth) {
+	p->fcap = p->fcap * 2 + 16;
+	p->fstack = (ojFilter*)OJ_REALLOC(p->fstack, sizeof(ojFilter) * p->fcap);
+    }
+    p->fstack[p->fdepth++] = p->fnext;
+}
+
+// Elements of an array use the same node as the array.
+static void
+filter_pop(ojParser p) {
+    if (0 < p->fdepth) {
+	p->fdepth--;
+    }
+    p->fnext = (0 < p->fdepth) ? p->fstack[p->fdepth - 1] : p->filter;
+}
+
+// Predictions only pay off when a hit can reuse an interned key and hash so
+// without oj_intern_keys there is nothing to allocate or check.
+static Shapes
+shapes_create() {
+    if (!oj_intern_keys) {
+	return NULL;
+    }
+    return (Shapes)OJ_CALLOC(1, sizeof(struct _Shapes));
+}
+
+static void
+shapes_destroy(Shapes s) {
+    if (NULL != s) {
+	Shape	next;
+
+	for (Shape shape = s->list; NULL != shape; shape = next) {
+	    next = shape->next;
+	    OJ_FREE(shape);
+	}
+	OJ_FREE(s);
+    }
+}
+
+static Shape
+shape_create(Shapes s) {
+    Shape	shape;
+
+    if (SHAPE_MAX <= s->cnt || NULL == (shape = (Shape)OJ_CALLOC(1, sizeof(struct _Shape)))) {
+	return NULL;
+    }
+    shape->next = s->list;
+    s->list = shape;
+    s->cnt++;
+
+    return shape;
+}
+
+// Called when a container is opened. The shape is the kid of the member
+// being read in the parent or the root for the top level value. Containers
+// deeper than SHAPE_DEPTH or past SHAPE_KEYS members have no shape.
+static void
+shape_push(Shapes s, bool top, bool array) {
+    Shape	shape = NULL;
+
+    if (top) {
+	s->depth = 0;
+	if (NULL == s->root) {
+	    s->root = shape_create(s);
+	}
+	shape = s->root;
+    } else if (0 < s->depth && s->depth <= SHAPE_DEPTH) {
+	Shape	parent = s->frames[s->depth - 1].shape;
+	int	i = s->frames[s->depth - 1].array ? 0 : s->frames[s->depth - 1].i - 1;
+
+	if (NULL != parent && 0 <= i && i < SHAPE_KEYS) {
+	    if (NULL == (shape = parent->kids[i])) {
+		shape = parent->kids[i] = shape_create(s);
+	    }
+	}
+    }
+    if (s->depth < SHAPE_DEPTH) {
+	s->frames[s->depth].shape = shape;
+	s->frames[s->depth].i = 0;
+	s->frames[s->depth].array = array;
+    }
+    s->depth++;
+}
+
+static inline void
+shape_pop(Shapes s) {
+    if (0 < s->depth) {
+	s->depth--;
+    }
+}
+
+// Returns the prediction slot for the next key of the open object or NULL
+// if the key is not predicted.
+static inline ShapeKey
+shape_key(Shapes s) {
+    if (0 < s->depth && s->depth <= SHAPE_DEPTH) {
+	Shape	shape = s->frames[s->depth - 1].shape;
+	int	i = s->frames[s->depth - 1].i++;
+
+	if (NULL != shape && i < SHAPE_KEYS) {
+	    return shape->keys + i;
+	}
+    }
+    return NULL;
+}
+
+// Replaces a prediction that missed with the key just read. The val is
+// NULL for a key that was filtered out.
+static void
+shape_learn(ShapeKey sk, const byte *key, int len, ojVal v) {
+    if (SHAPE_KEY_MAX < len) {
+	sk->key = NULL;
+	return;
+    }
+    sk->len = len;
+    if (NULL != v && v->key.borrow && v->key.intern) {
+	sk->key = v->key.ptr;
+	sk->kh = v->kh;
+	sk->intern = true;
+    } else {
+	memcpy(sk->raw, key, len);
+	sk->raw[len] = '\0';
+	sk->key = sk->raw;
+	sk->intern = false;
+    }
+}
+
+// Skips a member value that is not on a filter path. The value is validated
+// but no vals are made and nothing is copied. The state is kept in the
+// parser when the input ends in the middle of the value. Returns the byte
+// after the value or the terminating '\0', or NULL on an error. The value
+// is always in an object so after_map picks up where it ends.
+static const byte*
+skip_val(ojParser p, const byte *b, const byte *json) {
+    const byte	*nl;
 
-#if DEBUG
-    printf("*** parse - mode: %c %s\n", p->map[256], (const char*)json);
-#endif
     for (; '\0' != *b; b++) {
-#if DEBUG
-	print_stack(p, "loop");
-#endif
 	switch (p->map[*b]) {
 	case SKIP_NEWLINE:
-	    p->err.line++;
-	    p->err.col = b - json;
-	    b++;
-#ifdef SPACE_JUMP
-	    //for (uint32_t *sj = (uint32_t*)b; 0x20202020 == *sj; sj++) { b += 4; }
-	    for (uint16_t *sj = (uint16_t*)b; 0x2020 == *sj; sj++) { b += 2; }
-#endif
-	    for (; SKIP_CHAR == space_map[*b]; b++) {
+	    if (oj_lazy_lines) {
+		b = skip_white(b + 1) - 1;
+		break;
 	    }
-	    b--;
+	    nl = b;
+	    p->err.line++;
+	    b = skip_space(b + 1, &p->err.line, &nl) - 1;
+	    p->err.col = nl - json;
+	    break;
+	case SKIP_CHAR:
 	    break;
 	case COLON_COLON:
 	    p->map = value_map;
 	    break;
-	case SKIP_CHAR:
-	    break;
 	case KEY_QUOTE:
-	    v = push_val(p, OJ_NONE, 0);
-	    b++;
-	    start = b;
-	    for (; STR_OK == string_map[*b]; b++) {
-	    }
-	    if ('"' == *b) {
-		_oj_val_set_key(v, (char*)start, b - start);
-		p->map = colon_map;
-		break;
-	    }
-	    _oj_val_set_key(v, (char*)start, b - start);
-	    b--;
+	    b = _oj_scan_str(b + 1) - 1;
 	    p->map = string_map;
 	    p->next_map = colon_map;
 	    break;
 	case AFTER_COMMA:
-	    if (OJ_OBJECT == p->stack->type) {
-		p->map = key_map;
-	    } else {
-		p->map = comma_map;
+	    // The word maps let a comma through so a partial word has to be
+	    // caught here.
+	    if (0 == p->sdepth || after_map != p->map) {
+		byte_error(&p->err, p->map, b - json, *b);
+		parse_free_stack(p);
+		return NULL;
 	    }
+	    p->map = ('{' == p->sstack[p->sdepth - 1]) ? key_map : comma_map;
 	    break;
 	case VAL_QUOTE:
-	    v = push_val(p, OJ_STRING, 0);
-	    b++;
-	    start = b;
-	    for (; STR_OK == string_map[*b]; b++) {
-	    }
-	    if ('"' == *b) {
-		_oj_val_set_str(v, (char*)start, b - start);
-		if (pop_val(p)) {
-		    return OJ_ABORT;
-		}
-		p->map = (NULL == p->stack) ? value_map : after_map;
-		break;
-	    }
-	    _oj_val_set_str(v, (char*)start, b - start);
-	    b--;
+	    b = _oj_scan_str(b + 1) - 1;
 	    p->map = string_map;
-	    p->next_map = (NULL == p->stack->next) ? value_map : after_map;
+	    p->next_map = after_map;
 	    break;
 	case OPEN_OBJECT:
-	    v = push_val(p, OJ_OBJECT, OJ_OBJ_RAW);
-	    v->list.head = NULL;
-	    v->list.tail = NULL;
-	    p->map = key1_map;
-	    break;
-	case NUM_CLOSE_OBJECT:
-	    calc_num(p->stack);
-	    if (pop_val(p)) {
-		return OJ_ABORT;
-	    }
-	    // flow through
-	case CLOSE_OBJECT:
-	    if (OJ_OBJECT != p->stack->type) {
-		p->err.col = b - json - p->err.col + 1;
-		return parse_error(p, "unexpected object close");
-	    }
-	    if (pop_val(p)) {
-		return OJ_ABORT;
-	    }
-	    break;
 	case OPEN_ARRAY:
-	    v = push_val(p, OJ_ARRAY, 0);
-	    v->list.head = NULL;
-	    v->list.tail = NULL;
-	    p->map = value_map;
-	    break;
-	case NUM_CLOSE_ARRAY:
-	    calc_num(p->stack);
-	    if (pop_val(p)) {
-		return OJ_ABORT;
+	    if (p->scap <= p->sdepth) {
+		p->scap = p->scap * 2 + 64;
+		p->sstack = (byte*)OJ_REALLOC(p->sstack, p->scap);
 	    }
-	    // flow through
+	    p->sstack[p->sdepth++] = *b;
+	    p->map = ('{' == *b) ? key1_map : value_map;
+	    break;
+	case CLOSE_OBJECT:
 	case CLOSE_ARRAY:
-	    if (OJ_ARRAY != p->stack->type) {
+	    if (0 == p->sdepth || ('}' == *b) != ('{' == p->sstack[p->sdepth - 1])) {
 		p->err.col = b - json - p->err.col + 1;
-		return parse_error(p, "unexpected array close");
+		parse_error(p, "unexpected %s close", ('}' == *b) ? "object" : "array");
+		return NULL;
 	    }
-	    if (pop_val(p)) {
-		return OJ_ABORT;
+	    p->map = after_map;
+	    if (0 == --p->sdepth) {
+		p->skipping = false;
+		return b + 1;
 	    }
 	    break;
+	case NUM_SPC:
+	case NUM_NEWLINE:
 	case NUM_COMMA:
-	    calc_num(p->stack);
-	    if (pop_val(p)) {
-		return OJ_ABORT;
-	    }
-	    if (OJ_OBJECT == p->stack->type) {
-		p->map = key_map;
-	    } else {
-		p->map = comma_map;
+	case NUM_CLOSE_OBJECT:
+	case NUM_CLOSE_ARRAY:
+	    // The number is done and the byte is looked at again as if after
+	    // any other value.
+	    p->map = after_map;
+	    if (0 == p->sdepth) {
+		p->skipping = false;
+		return b;
 	    }
+	    b--;
 	    break;
 	case VAL0:
-	    v = push_val(p, OJ_INT, 0);
-	    v->num.fixnum = 0;
-	    v->num.neg = false;
-	    v->num.shift = 0;
-	    v->num.calc = false;
-	    v->num.len = 0;
-	    v->num.exp = 0;
-	    v->num.exp_neg = false;
+	case NUM_ZERO:
 	    p->map = zero_map;
 	    break;
 	case VAL_NEG:
-	    v = push_val(p, OJ_INT, 0);
-	    v->num.fixnum = 0;
-	    v->num.neg = true;
-	    v->num.shift = 0;
-	    v->num.calc = false;
-	    v->num.len = 0;
-	    v->num.exp = 0;
-	    v->num.exp_neg = false;
 	    p->map = neg_map;
-	    break;;
-	case VAL_DIGIT:
-	    v = push_val(p, OJ_INT, 0);
-	    v->num.fixnum = 0;
-	    v->num.neg = false;
-	    v->num.shift = 0;
-	    v->num.calc = false;
-	    v->num.exp = 0;
-	    v->num.exp_neg = false;
-	    v->num.len = 0;
-	    p->map = digit_map;
-	    for (; NUM_DIGIT == digit_map[*b]; b++) {
-		uint64_t	x = (uint64_t)v->num.fixnum * 10 + (uint64_t)(*b - '0');
-
-		// Tried just checking for an int less than zero but that
-		// fails when optimization is on for some reason with the
-		// clang compiler so us a bit mask instead.
-		if (0 == (0x8000000000000000ULL & x)) {
-		    v->num.fixnum = (int64_t)x;
-		} else {
-		    big_change(v);
-		    p->map = big_digit_map;
-		    break;
-		}
-	    }
-	    b--;
 	    break;
+	case VAL_DIGIT:
 	case NUM_DIGIT:
-	    v = p->stack;
+	case NEG_DIGIT:
 	    for (; NUM_DIGIT == digit_map[*b]; b++) {
-		uint64_t	x = v->num.fixnum * 10 + (uint64_t)(*b - '0');
-
-		if (0 == (0x8000000000000000ULL & x)) {
-		    v->num.fixnum = (int64_t)x;
-		} else {
-		    big_change(v);
-		    p->map = big_digit_map;
-		    break;
-		}
 	    }
 	    b--;
+	    p->map = digit_map;
 	    break;
 	case NUM_DOT:
-	    p->stack->type = OJ_DECIMAL;
 	    p->map = dot_map;
 	    break;
 	case NUM_FRAC:
-	    p->map = frac_map;
-	    v = p->stack;
 	    for (; NUM_FRAC == frac_map[*b]; b++) {
-		uint64_t	x = v->num.fixnum * 10 + (uint64_t)(*b - '0');
-
-		if (0 == (0x8000000000000000ULL & x)) {
-		    v->num.fixnum = (int64_t)x;
-		    v->num.shift++;
-		} else {
-		    big_change(v);
-		    p->map = big_frac_map;
-		    break;
-		}
 	    }
 	    b--;
+	    p->map = frac_map;
 	    break;
 	case FRAC_E:
-	    p->stack->type = OJ_DECIMAL;
 	    p->map = exp_sign_map;
 	    break;
-	case NUM_ZERO:
-	    p->map = zero_map;
+	case EXP_SIGN:
+	    p->map = exp_zero_map;
 	    break;
-	case NEG_DIGIT:
-	    v = p->stack;
+	case EXP_DIGIT:
 	    for (; NUM_DIGIT == digit_map[*b]; b++) {
-		uint64_t	x = v->num.fixnum * 10 + (uint64_t)(*b - '0');
-
-		if (0 == (0x8000000000000000ULL & x)) {
-		    v->num.fixnum = (int64_t)x;
-		} else {
-		    big_change(v);
-		    p->map = big_digit_map;
-		    break;
-		}
 	    }
 	    b--;
-	    p->map = digit_map;
-	    break;
-	case EXP_SIGN:
-	    p->stack->num.exp_neg = ('-' == *b);
-	    p->map = exp_zero_map;
-	    break;
-	case EXP_DIGIT:
-	    v = p->stack;
 	    p->map = exp_map;
-	    for (; NUM_DIGIT == digit_map[*b]; b++) {
-		int16_t	x = v->num.exp * 10 + (int16_t)(*b - '0');
-
-		if (x <= MAX_EXP) {
-		    v->num.exp = x;
-		} else {
-		    big_change(v);
-		    p->map = big_exp_map;
-		    break;
-		}
-	    }
-	    b--;
-	    break;
-	case BIG_DIGIT:
-	    start = b;
-	    for (; NUM_DIGIT == digit_map[*b]; b++) {
-	    }
-	    _oj_append_num(&p->err, &p->stack->num, (char*)start, b - start);
-	    b--;
-	    break;
-	case BIG_DOT:
-	    p->stack->type = OJ_DECIMAL;
-	    _oj_append_num(&p->err, &p->stack->num, ".", 1);
-	    p->map = big_dot_map;
-	    break;
-	case BIG_FRAC:
-	    p->map = big_frac_map;
-	    start = b;
-	    for (; NUM_FRAC == frac_map[*b]; b++) {
-	    }
-	    _oj_append_num(&p->err, &p->stack->num, (char*)start, b - start);
-	    b--;
-	case BIG_E:
-	    p->stack->type = OJ_DECIMAL;
-	    _oj_append_num(&p->err, &p->stack->num, (const char*)b, 1);
-	    p->map = big_exp_sign_map;
-	    break;
-	case BIG_EXP_SIGN:
-	    _oj_append_num(&p->err, &p->stack->num, (const char*)b, 1);
-	    p->map = big_exp_zero_map;
-	    break;
-	case BIG_EXP:
-	    start = b;
-	    for (; NUM_DIGIT == digit_map[*b]; b++) {
-	    }
-	    _oj_append_num(&p->err, &p->stack->num, (char*)start, b - start);
-	    b--;
-	    p->map = big_exp_map;
-	    break;
-	case NUM_SPC:
-	    calc_num(p->stack);
-	    if (pop_val(p)) {
-		return OJ_ABORT;
-	    }
-	    break;
-	case NUM_NEWLINE:
-	    calc_num(p->stack);
-	    if (pop_val(p)) {
-		return OJ_ABORT;
-	    }
-	    b++;
-#ifdef SPACE_JUMP
-	    //for (uint32_t *sj = (uint32_t*)b; 0x20202020 == *sj; sj++) { b += 4; }
-	    for (uint16_t *sj = (uint16_t*)b; 0x2020 == *sj; sj++) { b += 2; }
-#endif
-	    for (; SKIP_CHAR == space_map[*b]; b++) {
-	    }
-	    b--;
 	    break;
 	case STR_OK:
-	    start = b;
-	    for (; STR_OK == string_map[*b]; b++) {
-	    }
-	    if (':' == p->next_map[256]) {
-		_oj_append_str(&p->err, &p->stack->key, start, b - start);
-	    } else {
-		_oj_append_str(&p->err, &p->stack->str, start, b - start);
-	    }
-	    if ('"' == *b) {
-		p->map = p->next_map;
-		if (':' != p->map[256]) {
-		    if (pop_val(p)) {
-			return OJ_ABORT;
-		    }
-		}
-		break;
-	    }
-	    b--;
+	    b = _oj_scan_str(b) - 1;
 	    break;
 	case STR_SLASH:
 	    p->map = esc_map;
 	    break;
 	case STR_QUOTE:
 	    p->map = p->next_map;
-	    if (':' != p->map[256]) {
-		if (pop_val(p)) {
-		    return OJ_ABORT;
-		}
+	    if (0 == p->sdepth) {
+		p->skipping = false;
+		return b + 1;
 	    }
 	    break;
+	case ESC_OK:
+	    p->map = string_map;
+	    break;
 	case ESC_U:
 	    p->map = u_map;
 	    p->ri = 0;
-	    p->ucode = 0;
 	    break;
 	case U_OK:
-	    p->ri++;
-	    p->ucode = p->ucode << 4 | (uint32_t)hex_map[*b];
-	    if (4 <= p->ri) {
-		byte	utf8[8];
-		size_t	ulen = unicodeToUtf8(p->ucode, utf8);
-
-		if (0 < ulen) {
-		    if (':' == p->next_map[256]) {
-			_oj_append_str(&p->err, &p->stack->key, utf8, ulen);
-		    } else {
-			_oj_append_str(&p->err, &p->stack->str, utf8, ulen);
-		    }
-		} else {
-		    return parse_error(p, "invalid unicode");
-		}
+	    if (4 <= ++p->ri) {
 		p->map = string_map;
 	    }
 	    break;
-	case ESC_OK:
-	    if (':' == p->next_map[256]) {
-		_oj_append_str(&p->err, &p->stack->key, (byte*)&esc_byte_map[*b], 1);
-	    } else {
-		_oj_append_str(&p->err, &p->stack->str, (byte*)&esc_byte_map[*b], 1);
-	    }
-	    p->map = string_map;
-	    break;
 	case UTF1:
 	    p->ri = 1;
 	    p->map = utf_map;
-	    if (':' == p->next_map[256]) {
-		_oj_append_str(&p->err, &p->stack->key, b, 1);
-	    } else {
-		_oj_append_str(&p->err, &p->stack->str, b, 1);
-	    }
 	    break;
 	case UTF2:
 	    p->ri = 2;
 	    p->map = utf_map;
-	    if (':' == p->next_map[256]) {
-		_oj_append_str(&p->err, &p->stack->key, b, 1);
-	    } else {
-		_oj_append_str(&p->err, &p->stack->str, b, 1);
-	    }
 	    break;
 	case UTF3:
 	    p->ri = 3;
 	    p->map = utf_map;
-	    if (':' == p->next_map[256]) {
-		_oj_append_str(&p->err, &p->stack->key, b, 1);
-	    } else {
-		_oj_append_str(&p->err, &p->stack->str, b, 1);
-	    }
 	    break;
 	case UTFX:
-	    p->ri--;
-	    if (':' == p->next_map[256]) {
-		_oj_append_str(&p->err, &p->stack->key, b, 1);
-	    } else {
-		_oj_append_str(&p->err, &p->stack->str, b, 1);
-	    }
-	    if (p->ri <= 0) {
+	    if (--p->ri <= 0) {
 		p->map = string_map;
 	    }
 	    break;
 	case VAL_NULL:
-	    if ('u' == b[1] && 'l' == b[2] && 'l' == b[3]) {
-		b += 3;
-		push_val(p, OJ_NULL, 0);
-		if (pop_val(p)) {
-		    return OJ_ABORT;
-		}
-		break;
-	    }
-	    p->ri = 0;
-	    *p->token = *b++;
-	    for (int i = 1; i < 4; i++) {
-		if ('\0' == *b) {
-		    p->ri = i;
-		    break;
-		} else {
-		    p->token[i] = *b++;
-		}
-	    }
-	    if (0 < p->ri) {
-		p->map = null_map;
-		b--;
-		break;
-	    }
-	    p->err.col = b - json - p->err.col;
-	    return parse_error(p, "expected null");
 	case VAL_TRUE:
-	    if ('r' == b[1] && 'u' == b[2] && 'e' == b[3]) {
-		b += 3;
-		push_val(p, OJ_TRUE, 0);
-		if (pop_val(p)) {
-		    return OJ_ABORT;
-		}
-		break;
-	    }
-	    p->ri = 0;
-	    *p->token = *b++;
-	    for (int i = 1; i < 4; i++) {
-		if ('\0' == *b) {
-		    p->ri = i;
-		    break;
-		} else {
-		    p->token[i] = *b++;
-		}
-	    }
-	    if (0 < p->ri) {
-		p->map = true_map;
-		b--;
-		break;
-	    }
-	    p->err.col = b - json - p->err.col;
-	    return parse_error(p, "expected true");
-	case VAL_FALSE:
-	    if ('a' == b[1] && 'l' == b[2] && 's' == b[3] && 'e' == b[4]) {
-		b += 4;
-		push_val(p, OJ_FALSE, 0);
-		if (pop_val(p)) {
-		    return OJ_ABORT;
-		}
+	case VAL_FALSE: {
+	    const char	*word = ('n' == *b) ? "null" : ('t' == *b) ? "true" : "false";
+	    int		len = ('f' == *b) ? 5 : 4;
+	    int		i;
+
+	    // As in the parse loop the whole length of the word is read
+	    // before it is checked so an error is reported at the same place.
+	    for (i = 0; i < len && '\0' != b[i]; i++) {
+		p->token[i] = b[i];
+	    }
+	    if (i < len) {
+		// The rest of the word is checked byte by byte in the next
+		// block.
+		p->map = ('n' == *b) ? null_map : ('t' == *b) ? true_map : false_map;
+		p->ri = i;
+		b += i - 1;
 		break;
 	    }
-	    p->ri = 0;
-	    *p->token = *b++;
-	    for (int i = 1; i < 5; i++) {
-		if ('\0' == *b) {
-		    p->ri = i;
-		    break;
-		} else {
-		    p->token[i] = *b++;
-		}
+	    b += len;
+	    if (0 != strncmp(word, p->token, len)) {
+		word_error(p, b, json, len, word);
+		return NULL;
 	    }
-	    if (0 < p->ri) {
-		p->map = false_map;
-		b--;
-		break;
+	    b--;
+	    p->map = after_map;
+	    if (0 == p->sdepth) {
+		p->skipping = false;
+		return b + 1;
 	    }
-	    p->err.col = b - json - p->err.col;
-	    return parse_error(p, "expected false");
-	case TOKEN_OK:
-	    p->token[p->ri] = *b;
-	    p->ri++;
-	    switch (p->map[256]) {
-	    case 'N':
-		if (4 == p->ri) {
-		    if (0 != strncmp("null", p->token, 4)) {
-			p->err.col = b - json - p->err.col;
-			return parse_error(p, "expected null");
-		    }
-		    push_val(p, OJ_NULL, 0);
-		    if (pop_val(p)) {
-			return OJ_ABORT;
-		    }
-		}
-		break;
-	    case 'F':
-		if (5 == p->ri) {
-		    if (0 != strncmp("false", p->token, 5)) {
-			p->err.col = b - json - p->err.col;
-			return parse_error(p, "expected false");
-		    }
-		    push_val(p, OJ_FALSE, 0);
-		    if (pop_val(p)) {
-			return OJ_ABORT;
-		    }
+	    break;
+	}
+	case TOKEN_OK: {
+	    const char	*word = ('N' == p->map[256]) ? "null" : ('T' == p->map[256]) ? "true" : "false";
+	    int		len = ('F' == p->map[256]) ? 5 : 4;
+
+	    p->token[p->ri++] = *b;
+	    if (len == p->ri) {
+		if (0 != strncmp(word, p->token, len)) {
+		    word_error(p, b, json, len - 1, word);
+		    return NULL;
 		}
-		break;
-	    case 'T':
-		if (4 == p->ri) {
-		    if (0 != strncmp("true", p->token, 4)) {
-			p->err.col = b - json - p->err.col;
-			return parse_error(p, "expected true");
-		    }
-		    push_val(p, OJ_TRUE, 0);
-		    if (pop_val(p)) {
-			return OJ_ABORT;
-		    }
+		p->map = after_map;
+		if (0 == p->sdepth) {
+		    p->skipping = false;
+		    return b + 1;
 		}
-		break;
-	    default:
-		p->err.col = b - json - p->err.col;
-		return parse_error(p, "parse error");
 	    }
 	    break;
+	}
 	case CHAR_ERR:
-	    if (OJ_OK == p->err.code) {
-		byte_error(&p->err, p->map, b - json, *b);
-		parse_free_stack(p);
-	    }
-	    return p->err.code;
+	    byte_error(&p->err, p->map, b - json, *b);
+	    parse_free_stack(p);
+	    return NULL;
 	default:
-	    break;
+	    p->err.col = b - json - p->err.col;
+	    parse_error(p, "internal error, unknown mode");
+	    return NULL;
 	}
     }
-    if (NULL != p->stack && NULL == p->stack->next) {
+    return b;
+}
+
+// A number at the top level has nothing after it to close it so it is only
+// complete at the end of the input. A number being skipped by a filter is
+// in a member of the val on the stack and so is never at the top level.
+static ojStatus
+parse_number_end(ojParser p) {
+    if (!p->skipping && NULL != p->stack && p->root == p->stack->next) {
 	switch (p->map[256]) {
 	case '0':
 	case 'd':
@@ -1405,359 +1454,687 @@ parse(ojParser p, const byte *json) {
 	    break;
 	}
     }
-    if ('R' == p->map[256]) {
-	p->end = (const char*)b + 1;
+    return OJ_OK;
+}
+
+// With GCC or clang each state moves to the next byte and jumps to the
+// next state through a table of label addresses. The jump is then made from
+// the end of every state so the branch predictor sees which states follow
+// which instead of every byte going through the one indirect branch of a
+// switch. The '\0' terminator breaks out of the loop. STATE is the state
+// code of the current byte. Building with OJ_NO_THREADED uses the switch.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(OJ_NO_THREADED) && !DEBUG
+#define THREADED	1
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define DISPATCH	goto *jump[(byte)STATE];
+#define CASE(c)		L_##c
+#define DEFAULT		L_default
+#define NEXT		if ('\0' == *++b) break; goto *jump[(byte)STATE]
+#define JUMP(c)		[c] = &&L_##c
+#else
+#define THREADED	0
+#define DISPATCH	switch (STATE)
+#define CASE(c)		case c
+#define DEFAULT		default
+#define NEXT		break
+#endif
+
+#define STATE	p->map[*b]
+
+#define PARSE_LOOP	parse_tree
+#define PARSE_MODE	MODE_TREE
+#define PUSH_VAL	push_tree
+#define POP_VAL		pop_tree
+#include "parse_loop.h"
+
+#define PARSE_LOOP	parse_cb
+#define PARSE_MODE	MODE_CB
+#define PUSH_VAL	push_tree
+#define POP_VAL		pop_cb
+#include "parse_loop.h"
+
+#define PARSE_LOOP	parse_caller
+#define PARSE_MODE	MODE_CALLER
+#define PUSH_VAL	push_tree
+#define POP_VAL		pop_caller
+#include "parse_loop.h"
+
+#define PARSE_LOOP	parse_pp
+#define PARSE_MODE	MODE_PP
+#define PUSH_VAL	push_pp
+#define POP_VAL		pop_pp
+#include "parse_loop.h"
+
+// The loop for the way p hands off vals. The order of the checks matches
+// pop_val().
+static ojStatus
+parse_loop(ojParser p, const byte *json, const bool lazy) {
+    if (p->pp) {
+	return parse_pp(p, json, lazy);
+    }
+    if (p->has_cb) {
+	return parse_cb(p, json, lazy);
     }
-    return p->err.code;
+    if (p->has_caller) {
+	return parse_caller(p, json, lazy);
+    }
+    return parse_tree(p, json, lazy);
 }
 
-ojStatus
-oj_validate_str(ojErr err, const char *json_str) {
-    struct _ojValidator	v;
-    const byte		*json = (const byte*)json_str;
+// With oj_lazy_lines the loop leaves the line and column as they were at the
+// start of json. The column of an error is then the offset of the error
+// from the start of the line json started on so the newlines before the
+// error are counted to find the real line and column.
+static void
+locate_error(ojErr err, const byte *json, int base, int word) {
+    const byte	*end = json + err->col + base - 1;
+    const byte	*stop = (0 < word) ? end + 1 - word : end;
+    int		line = err->line;
 
-    memset(&v, 0, sizeof(v));
-    v.err.line = 1;
-    v.map = value_map;
-    for (const byte *b = json; '\0' != *b; b++) {
-	switch (v.map[*b]) {
-	case SKIP_NEWLINE:
-	    v.err.line++;
-	    v.err.col = b - json;
-	    b++;
-#ifdef SPACE_JUMP
-	    //for (uint32_t *sj = (uint32_t*)b; 0x20202020 == *sj; sj++) { b += 4; }
-	    for (uint16_t *sj = (uint16_t*)b; 0x2020 == *sj; sj++) { b += 2; }
+    if (stop < json) {
+	stop = json;
+    }
+    count_lines(err, json, stop);
+    if (line != err->line) {
+	err->col = (int)(end - json) - err->col + 1;
+    } else {
+	err->col = (int)(end - json) - base + 1;
+    }
+}
+
+static ojStatus
+parse(ojParser p, const byte *json) {
+    int		base = p->err.col;
+    ojStatus	status;
+
+    if (!oj_lazy_lines) {
+	return parse_loop(p, json, false);
+    }
+    if (OJ_ERR_PARSE == (status = parse_loop(p, json, true))) {
+	locate_error(&p->err, json, base, p->word);
+	p->word = 0;
+    }
+    return status;
+}
+
+static void
+validate_push(ojValidator v, byte c) {
+    if (v->scap <= v->depth) {
+	v->scap = v->scap * 2 + 64;
+	v->stack = (byte*)OJ_REALLOC(v->stack, v->scap);
+    }
+    v->stack[v->depth++] = c;
+}
+
+#undef STATE
+#define STATE	v->map[*b]
+
+// Validates up to the '\0' terminator. The state is kept in the validator
+// so the next block picks up in the middle of a token. Returns the
+// terminator or NULL on an error.
+static const byte*
+validate(ojValidator v, const byte *json) {
+#if THREADED
+    static const void	*jump[128] = {
+	[0 ... 127] = &&L_default,
+	JUMP(SKIP_NEWLINE), JUMP(COLON_COLON), JUMP(SKIP_CHAR), JUMP(KEY_QUOTE), JUMP(AFTER_COMMA),
+	JUMP(VAL_QUOTE), JUMP(OPEN_OBJECT), JUMP(NUM_CLOSE_OBJECT), JUMP(CLOSE_OBJECT),
+	JUMP(OPEN_ARRAY), JUMP(NUM_CLOSE_ARRAY), JUMP(CLOSE_ARRAY), JUMP(NUM_COMMA), JUMP(VAL0),
+	JUMP(VAL_NEG), JUMP(VAL_DIGIT), JUMP(NUM_DIGIT), JUMP(NUM_DOT), JUMP(NUM_FRAC),
+	JUMP(FRAC_E), JUMP(NUM_ZERO), JUMP(NEG_DIGIT), JUMP(EXP_SIGN), JUMP(EXP_DIGIT),
+	JUMP(NUM_SPC), JUMP(NUM_NEWLINE), JUMP(STR_OK), JUMP(STR_SLASH), JUMP(STR_QUOTE),
+	JUMP(ESC_U), JUMP(U_OK), JUMP(ESC_OK), JUMP(UTF1), JUMP(UTF2), JUMP(UTF3), JUMP(UTFX),
+	JUMP(VAL_NULL), JUMP(VAL_TRUE), JUMP(VAL_FALSE), JUMP(TOKEN_OK), JUMP(CHAR_ERR),
+    };
 #endif
-	    for (; SKIP_CHAR == space_map[*b]; b++) {
-	    }
-	    b--;
-	    break;
-	case COLON_COLON:
-	    v.map = value_map;
-	    break;
-	case SKIP_CHAR:
-	    break;
-	case KEY_QUOTE:
-	    b++;
-	    for (; STR_OK == string_map[*b]; b++) {
-	    }
-	    b--;
-	    v.map = string_map;
-	    v.next_map = colon_map;
-	    break;
-	case AFTER_COMMA:
-	    if (0 < v.depth && '{' == v.stack[v.depth-1]) {
-		v.map = key_map;
+    const byte	*nl;
+    const byte	*b = json;
+
+    for (; '\0' != *b; b++) {
+	DISPATCH {
+	CASE(SKIP_NEWLINE):
+	    nl = b;
+	    v->err.line++;
+	    b = skip_space(b + 1, &v->err.line, &nl) - 1;
+	    v->err.col = nl - json;
+	    NEXT;
+	CASE(COLON_COLON):
+	    v->map = value_map;
+	    NEXT;
+	CASE(SKIP_CHAR):
+	    NEXT;
+	CASE(KEY_QUOTE):
+	    b = _oj_scan_str(b + 1) - 1;
+	    v->map = string_map;
+	    v->next_map = colon_map;
+	    NEXT;
+	CASE(AFTER_COMMA):
+	    if (0 < v->depth && '{' == v->stack[v->depth - 1]) {
+		v->map = key_map;
 	    } else {
-		v.map = comma_map;
-	    }
-	    break;
-	case VAL_QUOTE:
-	    b++;
-	    for (; STR_OK == string_map[*b]; b++) {
+		v->map = comma_map;
 	    }
+	    NEXT;
+	CASE(VAL_QUOTE):
+	    b = _oj_scan_str(b + 1);
 	    switch (*b) {
 	    case '"': // normal termination
-		v.map = (0 == v.depth) ? value_map : after_map;
+		v->map = (0 == v->depth) ? value_map : after_map;
 		break;
-	    case '\0':
-		v.map = string_map;
-		v.next_map = (0 == v.depth) ? value_map : after_map;
 	    case '\\':
-		v.map = esc_map;
-		v.next_map = (0 == v.depth) ? value_map : after_map;
+		v->map = esc_map;
+		v->next_map = (0 == v->depth) ? value_map : after_map;
 		break;
 	    default:
 		b--;
-		v.map = string_map;
-		v.next_map = (0 == v.depth) ? value_map : after_map;
+		v->map = string_map;
+		v->next_map = (0 == v->depth) ? value_map : after_map;
 		break;
 	    }
-	    break;
-	case OPEN_OBJECT:
-	    // TBD check depth vs stack len
-	    v.stack[v.depth] = '{';
-	    v.depth++;
-	    v.map = key1_map;
-	    break;
-	case NUM_CLOSE_OBJECT:
-	case CLOSE_OBJECT:
-	    v.depth--;
-	    v.map = (0 == v.depth) ? value_map : after_map;
-	    if (v.depth < 0 || '{' != v.stack[v.depth]) {
-		v.err.col = b - json - v.err.col;
-		return oj_err_set(err, OJ_ERR_PARSE, "unexpected object close");
+	    NEXT;
+	CASE(OPEN_OBJECT):
+	    validate_push(v, '{');
+	    v->map = key1_map;
+	    NEXT;
+	CASE(NUM_CLOSE_OBJECT):
+	CASE(CLOSE_OBJECT):
+	    if (0 == v->depth || '{' != v->stack[v->depth - 1]) {
+		v->err.col = b - json - v->err.col + 1;
+		oj_err_set(&v->err, OJ_ERR_PARSE, "unexpected object close");
+		return NULL;
 	    }
-	    break;
-	case OPEN_ARRAY:
-	    // TBD check depth vs stack len
-	    v.stack[v.depth] = '[';
-	    v.depth++;
-	    v.map = value_map;
-	    break;
-	case NUM_CLOSE_ARRAY:
-	case CLOSE_ARRAY:
-	    v.depth--;
-	    v.map = (0 == v.depth) ? value_map : after_map;
-	    if (v.depth < 0 || '[' != v.stack[v.depth]) {
-		v.err.col = b - json - v.err.col;
-		return oj_err_set(err, OJ_ERR_PARSE, "unexpected array close");
+	    v->depth--;
+	    v->map = (0 == v->depth) ? value_map : after_map;
+	    NEXT;
+	CASE(OPEN_ARRAY):
+	    validate_push(v, '[');
+	    v->map = value_map;
+	    NEXT;
+	CASE(NUM_CLOSE_ARRAY):
+	CASE(CLOSE_ARRAY):
+	    if (0 == v->depth || '[' != v->stack[v->depth - 1]) {
+		v->err.col = b - json - v->err.col + 1;
+		oj_err_set(&v->err, OJ_ERR_PARSE, "unexpected array close");
+		return NULL;
 	    }
-	    break;
-	case NUM_COMMA:
-	    if (0 < v.depth && '{' == v.stack[v.depth-1]) {
-		v.map = key_map;
+	    v->depth--;
+	    v->map = (0 == v->depth) ? value_map : after_map;
+	    NEXT;
+	CASE(NUM_COMMA):
+	    if (0 < v->depth && '{' == v->stack[v->depth - 1]) {
+		v->map = key_map;
+	    } else if (0 < v->depth) {
+		v->map = comma_map;
 	    } else {
-		v.map = comma_map;
+		v->err.col = b - json - v->err.col + 1;
+		oj_err_set(&v->err, OJ_ERR_PARSE, "unexpected comma");
+		return NULL;
 	    }
-	    break;
-	case VAL0:
-	    v.map = zero_map;
-	    break;
-	case VAL_NEG:
-	    v.map = neg_map;
-	    break;;
-	case VAL_DIGIT:
+	    NEXT;
+	CASE(VAL0):
+	    v->map = zero_map;
+	    NEXT;
+	CASE(VAL_NEG):
+	    v->map = neg_map;
+	    NEXT;
+	CASE(VAL_DIGIT):
 	    for (; NUM_DIGIT == digit_map[*b]; b++) {
 	    }
 	    b--;
-	    v.map = digit_map;
-	    break;
-	case NUM_DIGIT:
+	    v->map = digit_map;
+	    NEXT;
+	CASE(NUM_DIGIT):
 	    for (; NUM_DIGIT == digit_map[*b]; b++) {
 	    }
 	    b--;
-	    break;
-	case NUM_DOT:
-	    v.map = dot_map;
-	    break;
-	case NUM_FRAC:
-	    v.map = frac_map;
+	    NEXT;
+	CASE(NUM_DOT):
+	    v->map = dot_map;
+	    NEXT;
+	CASE(NUM_FRAC):
+	    v->map = frac_map;
 	    for (; NUM_FRAC == frac_map[*b]; b++) {
 	    }
 	    b--;
-	    break;
-	case FRAC_E:
-	    v.map = exp_sign_map;
-	    break;
-	case NUM_ZERO:
-	    v.map = zero_map;
-	    break;
-	case NEG_DIGIT:
-	    v.map = digit_map;
-	    break;
-	case EXP_SIGN:
-	    v.map = exp_zero_map;
-	    break;
-	case EXP_DIGIT:
-	    v.map = exp_map;
-	    break;
-	case NUM_SPC:
-	    v.map = (0 == v.depth) ? value_map : after_map;
-	    break;
-	case NUM_NEWLINE:
-	    v.map = (0 == v.depth) ? value_map : after_map;
-	    v.err.line++;
-	    v.err.col = b - json;
-	    b++;
-#ifdef SPACE_JUMP
-	    //for (uint32_t *sj = (uint32_t*)b; 0x20202020 == *sj; sj++) { b += 4; }
-	    for (uint16_t *sj = (uint16_t*)b; 0x2020 == *sj; sj++) { b += 2; }
-#endif
-	    for (; SKIP_CHAR == space_map[*b]; b++) {
-	    }
-	    b--;
-	    break;
-	case STR_OK:
-	    break;
-	case STR_SLASH:
-	    v.map = esc_map;
-	    break;
-	case STR_QUOTE:
-	    v.map = v.next_map;
-	    break;
-	case ESC_U:
-	    v.map = u_map;
-	    v.ri = 0;
-	    break;
-	case U_OK:
-	    v.ri++;
-	    if (4 <= v.ri) {
-		v.map = string_map;
-	    }
-	    break;
-	case ESC_OK:
-	    v.map = string_map;
-	    break;
-	case UTF1:
-	    v.ri = 1;
-	    v.map = utf_map;
-	    break;
-	case UTF2:
-	    v.ri = 2;
-	    v.map = utf_map;
-	    break;
-	case UTF3:
-	    v.ri = 3;
-	    v.map = utf_map;
-	    break;
-	case UTFX:
-	    v.ri--;
-	    if (v.ri <= 0) {
-		v.map = string_map;
-	    }
-	    break;
-	case VAL_NULL:
+	    NEXT;
+	CASE(FRAC_E):
+	    v->map = exp_sign_map;
+	    NEXT;
+	CASE(NUM_ZERO):
+	    v->map = zero_map;
+	    NEXT;
+	CASE(NEG_DIGIT):
+	    v->map = digit_map;
+	    NEXT;
+	CASE(EXP_SIGN):
+	    v->map = exp_zero_map;
+	    NEXT;
+	CASE(EXP_DIGIT):
+	    v->map = exp_map;
+	    NEXT;
+	CASE(NUM_SPC):
+	    v->map = (0 == v->depth) ? value_map : after_map;
+	    NEXT;
+	CASE(NUM_NEWLINE):
+	    v->map = (0 == v->depth) ? value_map : after_map;
+	    nl = b;
+	    v->err.line++;
+	    b = skip_space(b + 1, &v->err.line, &nl) - 1;
+	    v->err.col = nl - json;
+	    NEXT;
+	CASE(STR_OK):
+	    b = _oj_scan_str(b) - 1;
+	    NEXT;
+	CASE(STR_SLASH):
+	    v->map = esc_map;
+	    NEXT;
+	CASE(STR_QUOTE):
+	    v->map = v->next_map;
+	    NEXT;
+	CASE(ESC_U):
+	    v->map = u_map;
+	    v->ri = 0;
+	    NEXT;
+	CASE(U_OK):
+	    v->ri++;
+	    if (4 <= v->ri) {
+		v->map = string_map;
+	    }
+	    NEXT;
+	CASE(ESC_OK):
+	    v->map = string_map;
+	    NEXT;
+	CASE(UTF1):
+	    v->ri = 1;
+	    v->map = utf_map;
+	    NEXT;
+	CASE(UTF2):
+	    v->ri = 2;
+	    v->map = utf_map;
+	    NEXT;
+	CASE(UTF3):
+	    v->ri = 3;
+	    v->map = utf_map;
+	    NEXT;
+	CASE(UTFX):
+	    v->ri--;
+	    if (v->ri <= 0) {
+		v->map = string_map;
+	    }
+	    NEXT;
+	CASE(VAL_NULL):
 	    if ('u' == b[1] && 'l' == b[2] && 'l' == b[3]) {
 		b += 3;
-		v.map = (0 == v.depth) ? value_map : after_map;
+		v->map = (0 == v->depth) ? value_map : after_map;
 	    } else if ('\0' == b[1] || '\0' == b[2] || '\0' == b[3]) {
-		v.map = null_map;
-		v.ri = 0;
+		v->map = null_map;
+		*v->token = *b;
+		v->ri = 1;
 	    } else {
-		v.err.col = b - json - v.err.col;
-		return oj_err_set(err, OJ_ERR_PARSE, "expected null");
+		v->err.col = b - json - v->err.col + 1;
+		oj_err_set(&v->err, OJ_ERR_PARSE, "expected null");
+		return NULL;
 	    }
-	    break;
-	case VAL_TRUE:
+	    NEXT;
+	CASE(VAL_TRUE):
 	    if ('r' == b[1] && 'u' == b[2] && 'e' == b[3]) {
 		b += 3;
-		v.map = (0 == v.depth) ? value_map : after_map;
+		v->map = (0 == v->depth) ? value_map : after_map;
 	    } else if ('\0' == b[1] || '\0' == b[2] || '\0' == b[3]) {
-		v.map = true_map;
-		v.ri = 0;
+		v->map = true_map;
+		*v->token = *b;
+		v->ri = 1;
 	    } else {
-		v.err.col = b - json - v.err.col;
-		return oj_err_set(err, OJ_ERR_PARSE, "expected true");
+		v->err.col = b - json - v->err.col + 1;
+		oj_err_set(&v->err, OJ_ERR_PARSE, "expected true");
+		return NULL;
 	    }
-	    break;
-	case VAL_FALSE:
+	    NEXT;
+	CASE(VAL_FALSE):
 	    if ('a' == b[1] && 'l' == b[2] && 's' == b[3] && 'e' == b[4]) {
 		b += 4;
-		v.map = (0 == v.depth) ? value_map : after_map;
+		v->map = (0 == v->depth) ? value_map : after_map;
 	    } else if ('\0' == b[1] || '\0' == b[2] || '\0' == b[3] || '\0' == b[4]) {
-		v.map = false_map;
-		v.ri = 0;
+		v->map = false_map;
+		*v->token = *b;
+		v->ri = 1;
 	    } else {
-		v.err.col = b - json - v.err.col;
-		return oj_err_set(err, OJ_ERR_PARSE, "expected false");
+		v->err.col = b - json - v->err.col + 1;
+		oj_err_set(&v->err, OJ_ERR_PARSE, "expected false");
+		return NULL;
 	    }
-	    break;
-	case CHAR_ERR:
-	    return byte_error(err, v.map, b - json, *b);
-	default:
-	    v.err.col = b - json - v.err.col;
-	    return oj_err_set(err, OJ_ERR_PARSE, "internal error, unknown mode");
-	    break;
+	    NEXT;
+	CASE(TOKEN_OK): {
+	    // A token split across blocks.
+	    const char	*word = ('N' == v->map[256]) ? "null" : ('T' == v->map[256]) ? "true" : "false";
+	    int		len = ('F' == v->map[256]) ? 5 : 4;
+
+	    v->token[v->ri++] = *b;
+	    if (len == v->ri) {
+		if (0 != strncmp(word, v->token, len)) {
+		    v->err.col = b - json - v->err.col + 1;
+		    oj_err_set(&v->err, OJ_ERR_PARSE, "expected %s", word);
+		    return NULL;
+		}
+		v->map = (0 == v->depth) ? value_map : after_map;
+	    }
+	    NEXT;
+	}
+	CASE(CHAR_ERR):
+	    byte_error(&v->err, v->map, b - json, *b);
+	    return NULL;
+	DEFAULT:
+	    v->err.col = b - json - v->err.col;
+	    oj_err_set(&v->err, OJ_ERR_PARSE, "internal error, unknown mode");
+	    return NULL;
 	}
     }
-    return OJ_OK;
+    return b;
 }
 
-static void
-read_block(int fd, ReadBlock b) {
-    ssize_t	rcnt = read(fd, b->buf, sizeof(b->buf) - 1);
+#undef STATE
+#if THREADED
+#pragma GCC diagnostic pop
+#endif
 
-    if (0 < rcnt) {
-	b->buf[rcnt] = '\0';
+// The input is complete if nothing is open and the last value, if a
+// number, could end there.
+static ojStatus
+validate_end(ojValidator v) {
+    if (OJ_OK == v->err.code && (0 != v->depth || (value_map != v->map && zero_map != v->map &&
+						  digit_map != v->map && frac_map != v->map &&
+						  exp_map != v->map))) {
+	v->err.col = -v->err.col;
+	oj_err_set(&v->err, OJ_ERR_PARSE, "incomplete JSON");
+    }
+    return v->err.code;
+}
+
+ojStatus
+oj_validate_str(ojErr err, const char *json) {
+    struct _ojValidator	v;
+
+    memset(&v, 0, sizeof(v));
+    v.err.line = 1;
+    v.map = value_map;
+    if (NULL != validate(&v, (const byte*)json)) {
+	v.err.col -= strlen(json);
+	validate_end(&v);
     }
-    if (rcnt != sizeof(b->buf) - 1) {
-	if (0 == rcnt) {
-	    b->eof = true;
-	} else if (rcnt < 0) {
-	    b->status = errno;
+    OJ_FREE(v.stack);
+    if (OJ_OK != v.err.code && NULL != err) {
+	*err = v.err;
+    }
+    return v.err.code;
+}
+
+// Validates a block of len bytes read for a validating parser. The column
+// offset is carried to the next block as with _oj_parser_block().
+static ojStatus
+validate_block(ojParser p, const byte *buf, size_t len) {
+    ojValidator	v = p->validator;
+    const byte	*end = validate(v, buf);
+
+    if (NULL != end) {
+	if (end < buf + len) {
+	    v->err.col = end - buf - v->err.col + 1;
+	    oj_err_set(&v->err, OJ_ERR_PARSE, "invalid JSON character 0x00");
+	} else {
+	    v->err.col -= len;
 	}
     }
+    if (OJ_OK != v->err.code) {
+	p->err = v->err;
+    }
+    return p->err.code;
 }
 
-static void*
-reader(void *ctx) {
-    ReadCtx	rc = (ReadCtx)ctx;
-    ReadBlock	b = rc->blocks;
-    ReadBlock	next;
+// Every way of reading input hands each '\0' terminated block of len bytes
+// here.
+static inline ojStatus
+parse_block(ojParser p, const byte *buf, size_t len) {
+    if (NULL != p->validator) {
+	return validate_block(p, buf, len);
+    }
+    ojStatus	status = parse(p, buf);
 
-    while (true) {
-	if (OJ_OK != b->status) {
+    if (OJ_OK == status) {
+	block_end(&p->err, buf, len);
+    }
+    return status;
+}
+
+// Parses blocks read ahead by a reader so the parser only waits on a read
+// when the reader falls behind. Returns false if the reader could not be
+// started so the caller can fall back to reading directly.
+static bool
+parse_large(ojParser p, int fd, bool uring) {
+    ojReader	r = _oj_reader_start(&p->err, fd, uring);
+    const byte	*buf;
+    size_t	len;
+
+    if (NULL == r) {
+	oj_err_init(&p->err);
+	p->err.line = 1;
+	return false;
+    }
+    while (NULL != (buf = _oj_reader_next(&p->err, r, &len))) {
+	if (OJ_OK != parse_block(p, buf, len)) {
 	    break;
 	}
-	read_block(rc->fd, b);
-	if (OJ_OK != b->status || b->eof) {
+    }
+    _oj_reader_stop(r);
+
+    return true;
+}
+
+// Parses a regular file through a sliding window of private mappings. The
+// parser stops on a '\0' so the byte just past each window is replaced with
+// one. That only touches the mapping's copy of the page. Tokens that cross a
+// window edge are picked up by the parser state on the next call just as
+// they are across read() blocks. Returns false if the file could not be
+// mapped at all so the caller can fall back to reading.
+static bool
+parse_mapped(ojParser p, int fd, off_t size) {
+    size_t	page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t	win = (oj_map_window + page - 1) / page * page;
+    off_t	pos = lseek(fd, 0, SEEK_CUR);
+    off_t	start;
+    off_t	off;
+    size_t	skip;
+    size_t	rest;
+    size_t	len;
+    byte	*base;
+    ojStatus	status = OJ_OK;
+
+    if (pos < 0 || size <= pos) {
+	return false;
+    }
+    if (0 == win) {
+	win = page;
+    }
+    // Mappings must start on a page so skip is the part of the first page
+    // already read by the caller.
+    start = pos / page * page;
+    skip = pos - start;
+    for (off = start; off < size && OJ_OK == status; off += win, skip = 0) {
+	rest = size - off;
+	len = (rest < win + page) ? rest : win + page;
+	base = (byte*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, off);
+	if (MAP_FAILED == base) {
+	    if (off == start) {
+		return false;
+	    }
+	    oj_err_no(&p->err, "mmap failed");
 	    break;
 	}
-	next = b + 1;
-	if (rc->bend <= next) {
-	    next = rc->blocks;
-	}
-	while (atomic_flag_test_and_set(&next->busy)) {
-	    one_beat();
+	madvise(base, len, MADV_SEQUENTIAL);
+	if (win < rest) {
+	    base[win] = '\0';
+	    status = parse_block(p, base + skip, win - skip);
+	} else if (0 != rest % page) {
+	    // The rest of the last page is zero filled.
+	    status = parse_block(p, base + skip, rest - skip);
+	} else {
+	    // A file that ends on a page leaves no room for the '\0' so the
+	    // last page is copied.
+	    byte	last[page + 1];
+
+	    memcpy(last, base + rest - page, page);
+	    last[page] = '\0';
+	    base[rest - page] = '\0';
+	    if (skip < rest - page) {
+		status = parse_block(p, base + skip, rest - page - skip);
+		skip = 0;
+	    } else {
+		skip -= rest - page;
+	    }
+	    if (OJ_OK == status) {
+		status = parse_block(p, last + skip, page - skip);
+	    }
 	}
-	atomic_flag_clear(&b->busy);
-	b = next;
+	// Unmapping the window once parsed keeps no more than one window
+	// resident.
+	munmap(base, len);
     }
-    atomic_flag_clear(&b->busy);
-    pthread_exit(0);
+    lseek(fd, size, SEEK_SET);
 
-    return NULL;
+    return true;
 }
 
-static ojStatus
-parse_large(ojParser p, int fd) {
-    struct _ReadCtx	rc;
-    ReadBlock		b; // current block being parsed
-    ReadBlock		prev;
-
-    memset(&rc, 0, sizeof(rc));
-    rc.bend = rc.blocks + sizeof(rc.blocks) / sizeof(*rc.blocks);
-    rc.fd = fd;
+// Reads and parses on the calling thread. With ahead true the rest of the
+// input is handed to a read ahead thread once a full block comes back
+// since there is more than a few reads worth left.
+static void
+parse_read(ojParser p, int fd, bool ahead) {
+    byte	buf[16385];
+    size_t	size = sizeof(buf) - 1;
+    ssize_t	rsize;
 
-    for (b = rc.blocks; b < rc.bend; b++) {
-	atomic_flag_clear(&b->busy);
+    while (true) {
+	if (0 < (rsize = read(fd, buf, size))) {
+	    buf[rsize] = '\0';
+	    if (OJ_OK != parse_block(p, buf, rsize)) {
+		break;
+	    }
+	    if (ahead && (size_t)rsize == size && parse_large(p, fd, false)) {
+		break;
+	    }
+	    ahead = false;
+	}
+	if (rsize <= 0) {
+	    if (0 != rsize) {
+		oj_err_no(&p->err, "read error");
+	    }
+	    break;
+	}
     }
-    prev = rc.bend - 1;
-    b = rc.blocks;
+}
 
-    // Lock the prev block as if the parser has already finished but not yet
-    // grabbed the next block.
-    atomic_flag_test_and_set(&prev->busy);
-    // Lock the first block for the reader.
-    atomic_flag_test_and_set(&b->busy);
+// Picks how to get the input from fd given oj_read_mode and parses it.
+// Reading ahead only pays when the reads can overlap the parsing so with
+// a single CPU the input is always read or mapped on the calling thread.
+// Starting a reader costs about as much as parsing 30K so io_uring is
+// used for regular files over USE_URING_LIMIT and mapping between that and
+// USE_MAP_LIMIT. Pipes and sockets are read ahead on a thread if the first
+// read fills a block.
+static void
+read_input(ojParser p, int fd) {
+    struct stat	info;
+    ojReadMode	mode = oj_read_mode;
+    bool	regular = (0 == fstat(fd, &info) && S_ISREG(info.st_mode));
+    bool	ahead = false;
 
-    pthread_t	t;
-    int		err;
+    if (OJ_READ_AUTO == mode) {
+	bool	multi = (1 < sysconf(_SC_NPROCESSORS_ONLN));
 
-    if (0 != (err = pthread_create(&t, NULL, reader, (void*)&rc))) {
-	return oj_err_set(&p->err, err, "failed to create reader thread");
+	mode = OJ_READ_BLOCK;
+	if (regular) {
+	    if (multi && USE_URING_LIMIT < info.st_size) {
+		mode = OJ_READ_URING;
+	    } else if (USE_MAP_LIMIT < info.st_size) {
+		mode = OJ_READ_MAP;
+	    }
+	} else {
+	    ahead = multi;
+	}
     }
-    pthread_detach(t);
-
-    while (true) {
-	// Get the lock on the current before unlocking the previous to assure
-	// the reader doesn't overtake the parser.
-	while (atomic_flag_test_and_set(&b->busy)) {
-	    one_beat();
-	}
-	atomic_flag_clear(&prev->busy);
-	if (OJ_OK != b->status) { // could be set by reader
-	    oj_err_set(&p->err, b->status, "read failed");
-	    break;
+    switch (mode) {
+    case OJ_READ_MAP:
+	if (regular && parse_mapped(p, fd, info.st_size)) {
+	    return;
 	}
-	if (b->eof) {
-	    break;
+	break;
+    case OJ_READ_THREAD:
+	if (parse_large(p, fd, false)) {
+	    return;
 	}
-	if (OJ_OK != parse(p, b->buf)) {
-	    b->status = p->err.code;
-	    break;
+	break;
+    case OJ_READ_URING:
+	if (parse_large(p, fd, true)) {
+	    return;
 	}
-	prev = b;
-	b++;
-	if (rc.bend <= b) {
-	    b = rc.blocks;
+	break;
+    default:
+	break;
+    }
+    parse_read(p, fd, ahead);
+}
+
+// A block can end in the middle of a number at the top level so the number
+// is finished only once all the input has been read.
+static void
+parse_input(ojParser p, int fd) {
+    p->more = true;
+    read_input(p, fd);
+    p->more = false;
+    if (OJ_OK == p->err.code) {
+	parse_number_end(p);
+    }
+}
+
+//// validate functions
+
+ojStatus
+oj_validate_fd(ojErr err, int fd) {
+    struct _ojParser	p;
+    struct _ojValidator	v;
+
+    memset(&p, 0, sizeof(p));
+    memset(&v, 0, sizeof(v));
+    p.err.line = 1;
+    p.map = value_map;
+    v.err.line = 1;
+    v.map = value_map;
+    p.validator = &v;
+
+    read_input(&p, fd);
+    if (OJ_OK == p.err.code && OJ_OK != validate_end(&v)) {
+	p.err = v.err;
+    }
+    OJ_FREE(v.stack);
+    if (OJ_OK != p.err.code && NULL != err) {
+	*err = p.err;
+    }
+    return p.err.code;
+}
+
+ojStatus
+oj_validate_file(ojErr err, const char *filepath) {
+    int	fd = open(filepath, O_RDONLY);
+
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filepath);
 	}
+	return errno;
     }
-    atomic_flag_clear(&b->busy);
+    ojStatus	status = oj_validate_fd(err, fd);
 
-    return p->err.code;
+    close(fd);
+
+    return status;
 }
 
 //// parse string functions
@@ -1809,6 +2186,55 @@ oj_parse_strp(ojErr err, const char **json, ojReuser reuser) {
     return p.results;
 }
 
+ojVal
+oj_parse_str_insitu(ojErr err, char *json, ojReuser reuser) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.has_cb = false;
+    p.insitu = true;
+    p.err.line = 1;
+    p.map = value_map;
+    parse(&p, (const byte*)json);
+    if (NULL != reuser) {
+	reuser->head = p.all_head;
+	reuser->tail = p.all_tail;
+	reuser->dig = p.all_dig;
+    }
+    if (OJ_OK != p.err.code && OJ_ABORT != p.err.code) {
+	if (NULL != err) {
+	    *err = p.err;
+	}
+	return NULL;
+    }
+    return p.results;
+}
+
+ojVal
+oj_parse_strp_insitu(ojErr err, char **json, ojReuser reuser) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.has_cb = false;
+    p.insitu = true;
+    p.err.line = 1;
+    p.map = value_map;
+    parse(&p, *(const byte**)json);
+    *json = (char*)p.end;
+    if (NULL != reuser) {
+	reuser->head = p.all_head;
+	reuser->tail = p.all_tail;
+	reuser->dig = p.all_dig;
+    }
+    if (OJ_OK != p.err.code && OJ_ABORT != p.err.code) {
+	if (NULL != err) {
+	    *err = p.err;
+	}
+	return NULL;
+    }
+    return p.results;
+}
+
 ojStatus
 oj_parse_str_cb(ojErr err, const char *json, ojParseCallback cb, void *ctx) {
     struct _ojParser	p;
@@ -1819,7 +2245,9 @@ oj_parse_str_cb(ojErr err, const char *json, ojParseCallback cb, void *ctx) {
     p.ctx = ctx;
     p.err.line = 1;
     p.map = value_map;
+    p.shapes = shapes_create();
     parse(&p, (const byte*)json);
+    shapes_destroy(p.shapes);
     if (OJ_OK != p.err.code && OJ_ABORT != p.err.code) {
 	if (NULL != err) {
 	    *err = p.err;
@@ -1839,7 +2267,9 @@ oj_parse_str_call(ojErr err, const char *json, ojCaller caller) {
     p.caller = caller;
     p.err.line = 1;
     p.map = value_map;
+    p.shapes = shapes_create();
     parse(&p, (const byte*)json);
+    shapes_destroy(p.shapes);
     oj_caller_push(&p, caller, NULL);
     if (OJ_OK != p.err.code && OJ_ABORT != p.err.code) {
 	if (NULL != err) {
@@ -1888,41 +2318,7 @@ oj_parse_fd(ojErr err, int fd, ojReuser reuser) {
     p.err.line = 1;
     p.map = value_map;
 
-    struct stat	info;
-
-    // st_size will be 0 if not a file
-    if (0 == fstat(fd, &info) && USE_THREAD_LIMIT < info.st_size && false) {
-	// Use threaded version.
-	parse_large(&p, fd);
-	if (OJ_OK != p.err.code) {
-	    if (NULL != err) {
-		*err = p.err;
-	    }
-	    return NULL;
-	}
-	return p.results;
-    }
-    byte	buf[16385];
-    size_t	size = sizeof(buf) - 1;
-    size_t	rsize;
-
-    while (true) {
-	if (0 < (rsize = read(fd, buf, size))) {
-	    buf[rsize] = '\0';
-	    if (OJ_OK != parse(&p, buf)) {
-		break;
-	    }
-	}
-	if (rsize <= 0) {
-	    if (0 != rsize) {
-		if (NULL != err) {
-		    oj_err_no(err, "read error");
-		}
-		return NULL;
-	    }
-	    break;
-	}
-    }
+    parse_input(&p, fd);
     if (NULL != reuser) {
 	reuser->head = p.all_head;
 	reuser->tail = p.all_tail;
@@ -1932,170 +2328,1316 @@ oj_parse_fd(ojErr err, int fd, ojReuser reuser) {
 	if (NULL != err) {
 	    *err = p.err;
 	}
-	return NULL;
+	return NULL;
+    }
+    return p.results;
+}
+
+static ojStatus
+parse_fd(ojParser p, ojErr err, int fd) {
+    parse_input(p, fd);
+    if (OJ_OK != p->err.code) {
+	if (NULL != err) {
+	    *err = p->err;
+	}
+	return p->err.code;
+    }
+    return OJ_OK;
+}
+
+ojStatus
+oj_parse_fd_cb(ojErr err, int fd, ojParseCallback cb, void *ctx) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.cb = cb;
+    p.has_cb = (NULL != cb);
+    p.ctx = ctx;
+    p.err.line = 1;
+    p.map = value_map;
+    p.shapes = shapes_create();
+
+    ojStatus	status = parse_fd(&p, err, fd);
+
+    shapes_destroy(p.shapes);
+
+    return status;
+}
+
+ojStatus
+oj_parse_fd_call(ojErr err, int fd, ojCaller caller) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.has_cb = false;
+    p.has_caller = true;
+    p.caller = caller;
+    p.err.line = 1;
+    p.map = value_map;
+    p.shapes = shapes_create();
+
+    parse_fd(&p, err, fd);
+    shapes_destroy(p.shapes);
+    oj_caller_push(&p, caller, NULL);
+
+    return p.err.code;
+}
+
+ojStatus
+oj_pp_parse_fd(ojErr err, int fd, void (*push)(ojVal val, void *ctx), void (*pop)(void * ctx), void *ctx) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.pp = true;
+    p.ctx = ctx;
+    p.push = push;
+    p.pop = pop;
+    p.err.line = 1;
+    p.map = value_map;
+    parse_fd(&p, err, fd);
+
+    if (OJ_OK != p.err.code && NULL != err) {
+	*err = p.err;
+    }
+    if (NULL != p.ready) {
+	p.ready->type = OJ_ARRAY;
+	p.ready->list.head = p.ready->next;
+	p.ready->list.tail = p.ready->next;
+	if (NULL != p.ready->list.tail) {
+	    for (; NULL != p.ready->list.tail->next; p.ready->list.tail = p.ready->list.tail->next) {
+	    }
+	}
+	oj_destroy(p.ready);
+    }
+    return OJ_OK;
+}
+
+ojVal
+oj_parse_file(ojErr err, const char *filename, ojReuser reuser) {
+    int	fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filename);
+	}
+	return NULL;
+    }
+    ojVal	val = oj_parse_fd(err, fd, reuser);
+
+    close(fd);
+
+    return val;
+}
+
+ojStatus
+oj_parse_file_cb(ojErr err, const char *filename, ojParseCallback cb, void *ctx) {
+    int	fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filename);
+	}
+	return errno;
+    }
+    ojStatus	status = oj_parse_fd_cb(err, fd, cb, ctx);
+
+    close(fd);
+
+    return status;
+}
+
+ojStatus
+oj_parse_file_call(ojErr err, const char *filepath, ojCaller caller) {
+    int	fd = open(filepath, O_RDONLY);
+
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filepath);
+	}
+	return errno;
+    }
+    ojStatus	status = oj_parse_fd_call(err, fd, caller);
+
+    close(fd);
+
+    return status;
+}
+
+ojStatus
+oj_pp_parse_file(ojErr err, const char *filepath, void (*push)(ojVal val, void *ctx), void (*pop)(void * ctx), void *ctx) {
+    int	fd = open(filepath, O_RDONLY);
+
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filepath);
+	}
+	return errno;
+    }
+    ojStatus	status = oj_pp_parse_fd(err, fd, push, pop, ctx);
+
+    close(fd);
+
+    return status;
+}
+
+//// filtered parse functions
+
+ojFilter
+oj_filter_create(ojErr err, const char **paths) {
+    ojFilter	root = (ojFilter)OJ_CALLOC(1, sizeof(struct _ojFilter));
+
+    if (NULL == root) {
+	OJ_ERR_MEM(err, "filter");
+	return NULL;
+    }
+    for (; NULL != *paths; paths++) {
+	ojFilter	node = root;
+	const char	*key = *paths;
+	const char	*end;
+	ojFilter	kid;
+
+	if ('\0' == *key) {
+	    root->all = true;
+	}
+	while (!node->all) {
+	    if (NULL == (end = strchr(key, '.'))) {
+		end = key + strlen(key);
+	    }
+	    for (kid = node->kids; kid < node->kids + node->cnt; kid++) {
+		if ((size_t)(end - key) == kid->len && 0 == memcmp(key, kid->key, kid->len)) {
+		    break;
+		}
+	    }
+	    if (node->kids + node->cnt <= kid) {
+		node->kids = (ojFilter)OJ_REALLOC(node->kids, sizeof(struct _ojFilter) * (node->cnt + 1));
+		kid = node->kids + node->cnt++;
+		memset(kid, 0, sizeof(struct _ojFilter));
+		kid->len = end - key;
+		kid->key = (char*)OJ_MALLOC(kid->len + 1);
+		memcpy(kid->key, key, kid->len);
+		kid->key[kid->len] = '\0';
+	    }
+	    node = kid;
+	    if ('\0' == *end) {
+		node->all = true;
+		break;
+	    }
+	    key = end + 1;
+	}
+    }
+    return root;
+}
+
+static void
+filter_free(ojFilter f) {
+    for (int i = 0; i < f->cnt; i++) {
+	filter_free(f->kids + i);
+	OJ_FREE(f->kids[i].key);
+    }
+    OJ_FREE(f->kids);
+}
+
+void
+oj_filter_destroy(ojFilter filter) {
+    if (NULL != filter) {
+	filter_free(filter);
+	OJ_FREE(filter);
+    }
+}
+
+static void
+filter_init(ojParser p, ojFilter filter) {
+    p->filter = filter;
+    p->fnext = filter;
+    p->fdepth = 0;
+    p->sdepth = 0;
+    p->key_kept = false;
+    p->skip_next = false;
+    p->skipping = false;
+}
+
+static void
+filter_cleanup(ojParser p) {
+    OJ_FREE(p->fstack);
+    OJ_FREE(p->sstack);
+    p->fstack = NULL;
+    p->sstack = NULL;
+    p->fcap = 0;
+    p->scap = 0;
+}
+
+// The input has all been parsed so a document still open or a member still
+// being skipped is incomplete. The error is at the end of the len bytes of
+// json, the last block parsed. A NULL json is for the fd parsers which have
+// already finished their last block.
+static void
+filter_end(ojParser p, const byte *json, size_t len) {
+    if (OJ_OK == p->err.code && (NULL != p->stack || p->skipping)) {
+	if (NULL != json) {
+	    block_end(&p->err, json, len);
+	}
+	p->err.col = -p->err.col;
+	parse_error(p, "incomplete JSON");
+    }
+}
+
+ojVal
+oj_parse_str_filter(ojErr err, const char *json, ojFilter filter, ojReuser reuser) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.err.line = 1;
+    p.map = value_map;
+    filter_init(&p, filter);
+    parse(&p, (const byte*)json);
+    filter_end(&p, (const byte*)json, strlen(json));
+    filter_cleanup(&p);
+    if (NULL != reuser) {
+	reuser->head = p.all_head;
+	reuser->tail = p.all_tail;
+	reuser->dig = p.all_dig;
+    }
+    if (OJ_OK != p.err.code && OJ_ABORT != p.err.code) {
+	if (NULL != err) {
+	    *err = p.err;
+	}
+	return NULL;
+    }
+    return p.results;
+}
+
+ojStatus
+oj_parse_str_filter_cb(ojErr err, const char *json, ojFilter filter, ojParseCallback cb, void *ctx) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.cb = cb;
+    p.has_cb = (NULL != cb);
+    p.ctx = ctx;
+    p.err.line = 1;
+    p.map = value_map;
+    filter_init(&p, filter);
+    p.shapes = shapes_create();
+    parse(&p, (const byte*)json);
+    filter_end(&p, (const byte*)json, strlen(json));
+    shapes_destroy(p.shapes);
+    filter_cleanup(&p);
+    if (OJ_OK != p.err.code && OJ_ABORT != p.err.code) {
+	if (NULL != err) {
+	    *err = p.err;
+	}
+	return p.err.code;
+    }
+    return OJ_OK;
+}
+
+ojStatus
+oj_parse_fd_filter_cb(ojErr err, int fd, ojFilter filter, ojParseCallback cb, void *ctx) {
+    struct _ojParser	p;
+
+    memset(&p, 0, sizeof(p));
+    p.cb = cb;
+    p.has_cb = (NULL != cb);
+    p.ctx = ctx;
+    p.err.line = 1;
+    p.map = value_map;
+    filter_init(&p, filter);
+    p.shapes = shapes_create();
+    parse_input(&p, fd);
+    filter_end(&p, NULL, 0);
+    shapes_destroy(p.shapes);
+    filter_cleanup(&p);
+    if (OJ_OK != p.err.code) {
+	if (NULL != err) {
+	    *err = p.err;
+	}
+	return p.err.code;
+    }
+    return OJ_OK;
+}
+
+ojStatus
+oj_parse_file_filter_cb(ojErr err, const char *filepath, ojFilter filter, ojParseCallback cb, void *ctx) {
+    int	fd = open(filepath, O_RDONLY);
+
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filepath);
+	}
+	return errno;
+    }
+    ojStatus	status = oj_parse_fd_filter_cb(err, fd, filter, cb, ctx);
+
+    close(fd);
+
+    return status;
+}
+
+//// push parser functions
+
+#define FEED_SIZE	16384
+
+static ojParser
+parser_create(ojErr err) {
+    ojParser	p = (ojParser)OJ_CALLOC(1, sizeof(struct _ojParser));
+
+    if (NULL == p) {
+	if (NULL != err) {
+	    OJ_ERR_MEM(err, "parser");
+	}
+	return NULL;
+    }
+    p->err.line = 1;
+    p->map = value_map;
+    p->more = true;
+    p->shapes = shapes_create();
+
+    return p;
+}
+
+ojParser
+oj_parser_create_cb(ojErr err, ojParseCallback cb, void *ctx) {
+    ojParser	p = parser_create(err);
+
+    if (NULL != p) {
+	p->cb = cb;
+	p->has_cb = (NULL != cb);
+	p->ctx = ctx;
+    }
+    return p;
+}
+
+ojParser
+oj_parser_create_call(ojErr err, ojCaller caller) {
+    ojParser	p = parser_create(err);
+
+    if (NULL != p) {
+	p->has_caller = true;
+	p->caller = caller;
+    }
+    return p;
+}
+
+static ojStatus
+parser_status(ojErr err, ojParser p) {
+    if (OJ_OK != p->err.code && OJ_ABORT != p->err.code && NULL != err) {
+	*err = p->err;
+    }
+    return p->err.code;
+}
+
+// The column offset is carried from one block to the next so error
+// positions are the same no matter how the input was split.
+ojStatus
+_oj_parser_block(ojErr err, ojParser p, byte *buf, size_t len) {
+    size_t	n = len;
+    byte	*nul;
+
+    if (OJ_OK != p->err.code) {
+	return parser_status(err, p);
+    }
+    if (NULL != (nul = (byte*)memchr(buf, '\0', len))) {
+	n = nul - buf;
+    }
+    buf[n] = '\0';
+    if (OJ_ABORT == parse(p, buf)) {
+	p->err.code = OJ_ABORT;
+    } else if (OJ_OK == p->err.code) {
+	block_end(&p->err, buf, n);
+	if (NULL != nul) {
+	    p->err.col = -p->err.col + 1;
+	    parse_error(p, "invalid JSON character 0x00");
+	}
+    }
+    return parser_status(err, p);
+}
+
+// The input is copied a block at a time so the parser can stop on a
+// terminating '\0' without writing to the caller's buffer. The block is
+// only allocated on the first feed.
+ojStatus
+oj_parser_feed(ojErr err, ojParser p, const char *buf, size_t len) {
+    size_t	n;
+
+    if (NULL == p->feed && NULL == (p->feed = (byte*)OJ_MALLOC(FEED_SIZE + 1))) {
+	OJ_ERR_MEM(&p->err, "parser");
+	return parser_status(err, p);
+    }
+    for (; 0 < len && OJ_OK == p->err.code; buf += n, len -= n) {
+	n = (FEED_SIZE < len) ? FEED_SIZE : len;
+	memcpy(p->feed, buf, n);
+	_oj_parser_block(NULL, p, p->feed, n);
+    }
+    return parser_status(err, p);
+}
+
+ojStatus
+oj_parser_finish(ojErr err, ojParser p) {
+    if (OJ_OK == p->err.code) {
+	if (OJ_ABORT == parse_number_end(p)) {
+	    p->err.code = OJ_ABORT;
+	} else if (NULL != p->stack || value_map != p->map) {
+	    p->err.col = -p->err.col;
+	    parse_error(p, "incomplete JSON");
+	}
+	if (p->has_caller) {
+	    caller_flush(p->caller);
+	}
+    }
+    return parser_status(err, p);
+}
+
+// Vals of a partial document are not owned by anyone else so they are
+// reused when the parser is reset or destroyed.
+static void
+parser_release(ojParser p) {
+    parse_free_stack(p);
+
+    struct _ojReuser	r = { .head = p->all_head, .tail = p->all_tail, .dig = p->all_dig };
+
+    oj_reuse(&r);
+    p->all_head = NULL;
+    p->all_tail = NULL;
+    p->all_dig = NULL;
+    p->stack = NULL;
+}
+
+void
+oj_parser_set_filter(ojParser p, ojFilter filter) {
+    filter_init(p, filter);
+}
+
+void
+oj_parser_reset(ojParser p) {
+    parser_release(p);
+    filter_init(p, p->filter);
+    oj_err_init(&p->err);
+    p->err.line = 1;
+    p->map = value_map;
+    p->next_map = NULL;
+    p->ri = 0;
+    p->ucode = 0;
+}
+
+void
+oj_parser_destroy(ojParser p) {
+    if (NULL != p) {
+	parser_release(p);
+	filter_cleanup(p);
+	shapes_destroy(p->shapes);
+	OJ_FREE(p->feed);
+	OJ_FREE(p);
+    }
+}
+
+//// parallel multiple document parsing
+
+typedef struct _ParDoc {
+    ojVal		val;
+    struct _ojReuser	reuser;
+} *ParDoc;
+
+// Chunks are handed out in order and chunk k always uses slot k % scnt. The
+// consumer releases a slot for chunk k + scnt once it has taken the results
+// of chunk k.
+typedef struct _ParSlot {
+    atomic_llong	ready;	// chunk the slot can be filled with
+    atomic_llong	done;	// last chunk parsed into the slot
+    ParDoc		docs;
+    int			cnt;
+    int			cap;
+    struct _ojErr	err;
+    ojVal		spent;	// destroyed vals handed back to the workers
+    ojVal		spent_tail;
+    struct _ojVal	root;	// holds the elements of an array chunk
+    struct _ojReuser	reuser;	// all the vals of an array chunk
+} *ParSlot;
+
+typedef struct _ParCtx {
+    byte		*base;
+    off_t		*bounds;	// chunk starts plus the end
+    long long		cnt;
+    byte		*last;	// copy of the last chunk if not terminated
+    atomic_llong	next;
+    atomic_bool		stop;
+    ParSlot		slots;
+    int			scnt;
+    bool		ordered;
+    bool		array;	// chunks are runs of elements of one array
+    bool		mapped;
+    ojParseCallback	cb;
+    void		*ctx;
+    ojVal		top;	// array chunk elements are stitched onto
+    struct _ojReuser	reuser;	// all the vals under top
+    struct _ojPark	park;	// woken when a slot changes or on stop
+} *ParCtx;
+
+typedef struct _ParWait {
+    ParCtx	pc;
+    ParSlot	slot;
+    long long	k;
+} *ParWait;
+
+typedef struct _ParWorker {
+    struct _ojParser	p;
+    pthread_t		thread;
+    ParCtx		pc;
+    ParSlot		slot;
+} *ParWorker;
+
+static ojCallbackOp
+par_collect(ojVal val, void *ctx) {
+    ParWorker	w = (ParWorker)ctx;
+    ParSlot	slot = w->slot;
+
+    if (slot->cap <= slot->cnt) {
+	slot->cap = slot->cap * 2 + 64;
+	slot->docs = (ParDoc)OJ_REALLOC(slot->docs, sizeof(struct _ParDoc) * slot->cap);
+    }
+    ParDoc	d = slot->docs + slot->cnt++;
+
+    d->val = val;
+    d->reuser.head = w->p.all_head;
+    d->reuser.tail = w->p.all_tail;
+    d->reuser.dig = w->p.all_dig;
+
+    return 0;
+}
+
+// Unordered callbacks are made directly from the workers.
+static ojCallbackOp
+par_direct(ojVal val, void *ctx) {
+    ParCtx		pc = ((ParWorker)ctx)->pc;
+    ojCallbackOp	op;
+
+    if (pc->stop) {
+	return OJ_STOP | OJ_DESTROY;
+    }
+    if (0 != (OJ_STOP & (op = pc->cb(val, pc->ctx)))) {
+	pc->stop = true;
+    }
+    return op;
+}
+
+static void
+pool_release(ojVal head) {
+    struct _ojReuser	r = { .head = head, .tail = head, .dig = NULL };
+
+    if (NULL != head) {
+	for (; NULL != r.tail->free; r.tail = r.tail->free) {
+	}
+	oj_reuse(&r);
+    }
+}
+
+// Each chunk of an array is parsed into the slot root as if the opening
+// bracket had already been read. Only the first chunk starts right after
+// the bracket. The others start after a comma.
+static void
+par_prime(ParWorker w, ParSlot slot, long long k) {
+    ojParser	p = &w->p;
+
+    p->map = value_map;
+    p->stack = NULL;
+    if (w->pc->array) {
+	slot->root.type = OJ_ARRAY;
+	slot->root.next = NULL;
+	slot->root.list.head = NULL;
+	slot->root.list.tail = NULL;
+	p->root = &slot->root;
+	p->stack = p->root;
+	if (0 < k) {
+	    p->map = comma_map;
+	}
+    }
+    p->err.code = OJ_OK;
+    p->err.line = 1;
+    p->err.col = 0;
+}
+
+// Checks the state at the end of a chunk of len bytes.
+static void
+par_check(ParWorker w, long long k, const byte *json, size_t len) {
+    ojParser	p = &w->p;
+
+    block_end(&p->err, json, len);
+    p->err.col = -p->err.col + 1;
+    if (!w->pc->array) {
+	if (NULL != p->stack) {
+	    parse_error(p, "incomplete JSON, each document must be on one line");
+	}
+    } else if (k == w->pc->cnt - 1) {
+	// The last chunk must close the array.
+	if (NULL != p->stack) {
+	    parse_error(p, "incomplete JSON");
+	}
+    } else if (p->root != p->stack || after_map != p->map) {
+	parse_error(p, "incomplete JSON");
+    }
+}
+
+// Parses chunk k into its slot.
+static void
+par_chunk(ParWorker w, long long k) {
+    ParCtx	pc = w->pc;
+    ojParser	p = &w->p;
+    ParSlot	slot = pc->slots + k % pc->scnt;
+    byte	*start = pc->base + pc->bounds[k];
+    byte	*end = pc->base + pc->bounds[k + 1];
+    byte	*json = start;
+    size_t	len;
+    ojStatus	status;
+
+    w->slot = slot;
+    if (NULL != slot->spent) {
+	slot->spent_tail->free = p->pool;
+	p->pool = slot->spent;
+	slot->spent = NULL;
+	slot->spent_tail = NULL;
+    }
+    par_prime(w, slot, k);
+    if (k == pc->cnt - 1 && NULL != pc->last) {
+	json = pc->last;
+	status = parse(p, json);
+	len = strlen((char*)json);
+    } else {
+	// The chunk ends with a newline or a comma between elements which can
+	// be replaced by the terminator while the chunk is parsed.
+	byte	sep = end[-1];
+
+	end[-1] = '\0';
+	status = parse(p, start);
+	end[-1] = sep;
+	len = end - 1 - start;
+    }
+    if (OJ_OK == status) {
+	par_check(w, k, json, len);
+    }
+    if (OJ_ABORT == status) {
+	pc->stop = true;
+    }
+    slot->err = p->err;
+    if (pc->array && NULL == pc->cb) {
+	slot->reuser.head = p->all_head;
+	slot->reuser.tail = p->all_tail;
+	slot->reuser.dig = p->all_dig;
+	p->all_head = NULL;
+	p->all_tail = NULL;
+	p->all_dig = NULL;
+    } else if (OJ_OK != p->err.code) {
+	// Whatever was left of the document in error.
+	struct _ojReuser	r = { .head = p->all_head, .tail = p->all_tail, .dig = p->all_dig };
+
+	oj_reuse(&r);
+	p->all_head = NULL;
+	p->all_tail = NULL;
+	p->all_dig = NULL;
+    }
+    if (pc->mapped) {
+	// Drop the pages only this chunk uses.
+	size_t	page = (size_t)sysconf(_SC_PAGESIZE);
+	byte	*first = (byte*)(((uintptr_t)start + page - 1) / page * page);
+	byte	*after = (byte*)((uintptr_t)end / page * page);
+
+	if (first < after) {
+	    madvise(first, after - first, MADV_DONTNEED);
+	}
+    }
+    atomic_store(&slot->done, k);
+    _oj_wake(&pc->park);
+}
+
+static bool
+par_slot_ready(void *ctx) {
+    ParWait	pw = (ParWait)ctx;
+
+    return pw->pc->stop || atomic_load(&pw->slot->ready) == pw->k;
+}
+
+static bool
+par_slot_done(void *ctx) {
+    ParWait	pw = (ParWait)ctx;
+
+    return pw->pc->stop || atomic_load(&pw->slot->done) == pw->k;
+}
+
+static void*
+par_worker(void *arg) {
+    ParWorker		w = (ParWorker)arg;
+    ParCtx		pc = w->pc;
+    struct _ParWait	pw = { .pc = pc };
+
+    while (!pc->stop && (pw.k = atomic_fetch_add(&pc->next, 1)) < pc->cnt) {
+	pw.slot = pc->slots + pw.k % pc->scnt;
+	_oj_wait(&pc->park, par_slot_ready, &pw);
+	if (pc->stop) {
+	    break;
+	}
+	par_chunk(w, pw.k);
+    }
+    return NULL;
+}
+
+// Called by the consuming thread while it waits. A chunk is only taken if
+// its slot is already free since only the consumer frees slots. Returns
+// false if there was nothing to take.
+static bool
+par_help(ParWorker w) {
+    ParCtx	pc = w->pc;
+    long long	k = atomic_load(&pc->next);
+
+    if (pc->cnt <= k || atomic_load(&pc->slots[k % pc->scnt].ready) != k ||
+	!atomic_compare_exchange_strong(&pc->next, &k, k + 1)) {
+	return false;
+    }
+    par_chunk(w, k);
+
+    return true;
+}
+
+// Errors are found relative to the start of the chunk so the lines before
+// it are added and, if the error is on the first line of the chunk, the
+// columns before it. Columns after a newline are one higher than on the
+// first line just as when the lines are counted by the parser.
+static void
+par_err_position(ParCtx pc, long long k, ojErr err) {
+    const byte	*b = pc->base;
+    const byte	*start = pc->base + pc->bounds[k];
+    int		cnt = 0;
+
+    if (1 == err->line) {
+	for (b = start; pc->base < b && '\n' != b[-1]; b--) {
+	}
+	err->col += (int)(start - b);
+	if (pc->base < b) {
+	    err->col++;
+	}
+	b = pc->base;
+    }
+    for (; NULL != (b = memchr(b, '\n', start - b)); b++) {
+	cnt++;
+    }
+    err->line += cnt;
+}
+
+static void
+par_deliver(ParCtx pc, ParSlot slot) {
+    for (ParDoc d = slot->docs, dend = d + slot->cnt; d < dend; d++) {
+	ojCallbackOp	op = pc->stop ? OJ_DESTROY : pc->cb(d->val, pc->ctx);
+
+	if (0 != (OJ_STOP & op)) {
+	    pc->stop = true;
+	}
+	if (0 != (OJ_DESTROY & op)) {
+	    _oj_reuse_keep(&d->reuser);
+	    if (NULL != d->reuser.tail) {
+		if (NULL == slot->spent) {
+		    slot->spent_tail = d->reuser.tail;
+		} else {
+		    d->reuser.tail->free = slot->spent;
+		}
+		slot->spent = d->reuser.head;
+	    }
+	}
+    }
+    slot->cnt = 0;
+}
+
+// Moves the elements of an array chunk onto the end of the top array.
+static void
+par_stitch(ParCtx pc, ParSlot slot) {
+    ojVal	top = pc->top;
+    ojVal	dig = slot->reuser.dig;
+
+    if (NULL != slot->root.list.head) {
+	if (NULL == top->list.head) {
+	    top->list.head = slot->root.list.head;
+	} else {
+	    top->list.tail->next = slot->root.list.head;
+	}
+	top->list.tail = slot->root.list.tail;
+	slot->root.list.head = NULL;
+	slot->root.list.tail = NULL;
+    }
+    if (NULL != slot->reuser.head) {
+	slot->reuser.tail->free = pc->reuser.head;
+	if (NULL == pc->reuser.head) {
+	    pc->reuser.tail = slot->reuser.tail;
+	}
+	pc->reuser.head = slot->reuser.head;
+    }
+    if (NULL != dig) {
+	for (; NULL != dig->free; dig = dig->free) {
+	}
+	dig->free = pc->reuser.dig;
+	pc->reuser.dig = slot->reuser.dig;
+    }
+    slot->reuser.head = NULL;
+    slot->reuser.tail = NULL;
+    slot->reuser.dig = NULL;
+}
+
+// Enough chunks to keep all the threads busy but not so small that the
+// hand off dominates.
+static off_t
+par_chunk_size(off_t len, int threads) {
+    off_t	chunk = len / (threads * 8);
+
+    if (chunk < PAR_MIN_CHUNK) {
+	chunk = PAR_MIN_CHUNK;
+    } else if (PAR_MAX_CHUNK < chunk) {
+	chunk = PAR_MAX_CHUNK;
+    }
+    return chunk;
+}
+
+// The last chunk needs a terminator. Trailing white space can be replaced
+// but otherwise the chunk is copied.
+static void
+par_last(ParCtx pc, off_t size) {
+    size_t	len;
+
+    switch (pc->base[size - 1]) {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+	break;
+    default:
+	len = size - pc->bounds[pc->cnt - 1];
+	pc->last = (byte*)OJ_MALLOC(len + 1);
+	memcpy(pc->last, pc->base + pc->bounds[pc->cnt - 1], len);
+	pc->last[len] = '\0';
+	break;
+    }
+}
+
+// Parses the chunks set up in pc on threads and hands the results over in
+// order on the calling thread.
+static ojStatus
+par_run(ParCtx pc, int threads, ojErr err) {
+    ParWorker		workers;
+    struct _ojErr	e = OJ_ERR_INIT;
+
+    if (pc->cnt < threads) {
+	threads = (int)pc->cnt;
+    }
+    // Values are created and freed on all the threads.
+    _oj_threads_begin();
+    pc->scnt = threads * 4;
+    pc->slots = (ParSlot)OJ_CALLOC(pc->scnt, sizeof(struct _ParSlot));
+    for (int i = 0; i < pc->scnt; i++) {
+	atomic_init(&pc->slots[i].ready, i);
+	atomic_init(&pc->slots[i].done, -1);
+    }
+    atomic_init(&pc->next, 0);
+    atomic_init(&pc->stop, false);
+
+    // The first worker is the calling thread which parses chunks while
+    // waiting on the others.
+    workers = (ParWorker)OJ_CALLOC(threads, sizeof(struct _ParWorker));
+    for (ParWorker w = workers; w < workers + threads; w++) {
+	w->pc = pc;
+	if (NULL != pc->cb) {
+	    w->p.has_cb = true;
+	    w->p.pooled = true;
+	    w->p.cb = pc->ordered ? par_collect : par_direct;
+	    w->p.ctx = w;
+	}
+	w->p.shapes = shapes_create();
+	if (workers < w && 0 != pthread_create(&w->thread, NULL, par_worker, w)) {
+	    // Carry on with the threads that did start.
+	    shapes_destroy(w->p.shapes);
+	    threads = w - workers;
+	    break;
+	}
+    }
+    for (long long k = 0; k < pc->cnt && !pc->stop; k++) {
+	ParSlot		slot = pc->slots + k % pc->scnt;
+	struct _ParWait	pw = { .pc = pc, .slot = slot, .k = k };
+
+	// Help with chunks that have a free slot before waiting. Nothing more
+	// can be taken until this thread frees a slot. A worker may give up
+	// on the chunk once stopped.
+	while (!par_slot_done(&pw) && par_help(workers)) {
+	}
+	_oj_wait(&pc->park, par_slot_done, &pw);
+	if (atomic_load(&slot->done) != k) {
+	    break;
+	}
+	if (pc->array && NULL == pc->cb) {
+	    par_stitch(pc, slot);
+	} else if (pc->ordered) {
+	    par_deliver(pc, slot);
+	}
+	if (OJ_OK != slot->err.code && OJ_ABORT != slot->err.code) {
+	    e = slot->err;
+	    par_err_position(pc, k, &e);
+	    pc->stop = true;
+	}
+	atomic_store(&slot->ready, k + pc->scnt);
+	_oj_wake(&pc->park);
+    }
+    // Workers waiting on a slot see the stop or run out of chunks.
+    pc->stop = true;
+    _oj_wake(&pc->park);
+    for (ParWorker w = workers; w < workers + threads; w++) {
+	if (workers < w) {
+	    pthread_join(w->thread, NULL);
+	}
+	pool_release(w->p.pool);
+	shapes_destroy(w->p.shapes);
     }
-    return p.results;
+    // Anything parsed but not delivered after a stop or error.
+    for (ParSlot slot = pc->slots; slot < pc->slots + pc->scnt; slot++) {
+	for (ParDoc d = slot->docs, dend = d + slot->cnt; d < dend; d++) {
+	    oj_reuse(&d->reuser);
+	}
+	oj_reuse(&slot->reuser);
+	pool_release(slot->spent);
+	OJ_FREE(slot->docs);
+    }
+    OJ_FREE(pc->slots);
+    OJ_FREE(workers);
+    OJ_FREE(pc->bounds);
+    OJ_FREE(pc->last);
+    _oj_threads_end();
+
+    if (OJ_OK != e.code && NULL != err) {
+	*err = e;
+    }
+    return e.code;
 }
 
 static ojStatus
-parse_fd(ojParser p, ojErr err, int fd) {
-    struct stat	info;
+parse_parallel(ojErr err, int fd, byte *base, off_t size, int threads, bool ordered, ojParseCallback cb, void *ctx) {
+    struct _ParCtx	pc;
+    off_t		pos = lseek(fd, 0, SEEK_CUR);
+    off_t		chunk;
+    off_t		off;
+    byte		*nl;
+    long long		cap = 64;
+    ojStatus		status;
 
-    // st_size will be 0 if not a file
-    if (0 == fstat(fd, &info) && USE_THREAD_LIMIT < info.st_size) {
-	// Use threaded version.
-	parse_large(p, fd);
-	if (OJ_OK != p->err.code) {
-	    if (NULL != err) {
-		*err = p->err;
-	    }
-	    return p->err.code;
+    memset(&pc, 0, sizeof(pc));
+    pc.base = base;
+    pc.mapped = true;
+    madvise(pc.base, size, MADV_SEQUENTIAL);
+    chunk = par_chunk_size(size - pos, threads);
+    pc.bounds = (off_t*)OJ_MALLOC(sizeof(off_t) * cap);
+    pc.bounds[0] = pos;
+    for (off = pos; off < size; off = pc.bounds[pc.cnt]) {
+	if (size <= off + chunk || NULL == (nl = memchr(pc.base + off + chunk - 1, '\n', size - off - chunk + 1))) {
+	    off = size;
+	} else {
+	    off = nl - pc.base + 1;
 	}
-	return OJ_OK;
+	if (cap <= pc.cnt + 1) {
+	    cap *= 2;
+	    pc.bounds = (off_t*)OJ_REALLOC(pc.bounds, sizeof(off_t) * cap);
+	}
+	pc.bounds[++pc.cnt] = off;
     }
-    byte	buf[16385];
-    size_t	size = sizeof(buf) - 1;
-    size_t	rsize;
+    if (0 < pc.cnt) {
+	par_last(&pc, size);
+    }
+    pc.ordered = ordered;
+    pc.cb = cb;
+    pc.ctx = ctx;
+    status = par_run(&pc, threads, err);
+    munmap(pc.base, size);
+    lseek(fd, size, SEEK_SET);
 
-    while (true) {
-	if (0 < (rsize = read(fd, buf, size))) {
-	    buf[rsize] = '\0';
-	    if (OJ_OK != parse(p, buf)) {
-		break;
-	    }
-	}
-	if (rsize <= 0) {
-	    if (0 != rsize) {
-		if (NULL != err) {
-		    oj_err_no(err, "read error");
-		}
-		return errno;
-	    }
-	    break;
-	}
+    return status;
+}
+
+ojStatus
+oj_parse_fd_parallel(ojErr err, int fd, int threads, bool ordered, ojParseCallback cb, void *ctx) {
+    struct stat	info;
+    byte	*base;
+
+    if (threads <= 0) {
+	threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
     }
-    if (OJ_OK != p->err.code) {
-	if (NULL != err) {
-	    *err = p->err;
-	}
-	return p->err.code;
+    if (0 == fstat(fd, &info) && S_ISREG(info.st_mode) && 0 < info.st_size &&
+	MAP_FAILED != (base = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0))) {
+	return parse_parallel(err, fd, base, info.st_size, threads, ordered, cb, ctx);
     }
-    return OJ_OK;
+    // Not a file that can be mapped so there is nothing to split up front.
+    return oj_parse_fd_cb(err, fd, cb, ctx);
 }
 
 ojStatus
-oj_parse_fd_cb(ojErr err, int fd, ojParseCallback cb, void *ctx) {
-    struct _ojParser	p;
+oj_parse_file_parallel(ojErr err, const char *filepath, int threads, bool ordered, ojParseCallback cb, void *ctx) {
+    int	fd = open(filepath, O_RDONLY);
 
-    memset(&p, 0, sizeof(p));
-    p.cb = cb;
-    p.has_cb = (NULL != cb);
-    p.ctx = ctx;
-    p.err.line = 1;
-    p.map = value_map;
+    if (fd < 0) {
+	if (NULL != err) {
+	    oj_err_no(err, "error opening %s", filepath);
+	}
+	return errno;
+    }
+    ojStatus	status = oj_parse_fd_parallel(err, fd, threads, ordered, cb, ctx);
+
+    close(fd);
 
-    return parse_fd(&p, err, fd);
+    return status;
 }
 
-ojStatus
-oj_parse_fd_call(ojErr err, int fd, ojCaller caller) {
-    struct _ojParser	p;
+//// parallel array parsing
 
-    memset(&p, 0, sizeof(p));
-    p.has_cb = false;
-    p.has_caller = true;
-    p.caller = caller;
-    p.err.line = 1;
-    p.map = value_map;
+typedef struct _SpanCtx {
+    const byte		*base;
+    off_t		*starts;	// region starts plus the end
+    int			cnt;
+    struct _ojSpan	*spans;
+    bool		*in_str;	// string state at the start of each region
+    long long		*depth;	// depth at the start of each region
+    const byte		**splits;
+    bool		split;	// second pass
+    atomic_int		next;
+} *SpanCtx;
 
-    parse_fd(&p, err, fd);
-    oj_caller_push(&p, caller, NULL);
+static void*
+span_worker(void *arg) {
+    SpanCtx	sc = (SpanCtx)arg;
+    int		r;
 
-    return p.err.code;
+    while ((r = atomic_fetch_add(&sc->next, 1)) < sc->cnt) {
+	const byte	*b = sc->base + sc->starts[r];
+	const byte	*end = sc->base + sc->starts[r + 1];
+
+	if (sc->split) {
+	    sc->splits[r] = _oj_span_split(sc->base, b, end, sc->in_str[r], sc->depth[r]);
+	} else {
+	    _oj_span_count(sc->base, b, end, sc->spans + r);
+	}
+    }
+    return NULL;
 }
 
-ojStatus
-oj_pp_parse_fd(ojErr err, int fd, void (*push)(ojVal val, void *ctx), void (*pop)(void * ctx), void *ctx) {
-    struct _ojParser	p;
+// Runs a pass over all the regions with the calling thread helping so the
+// pass completes even if no threads can be started.
+static void
+span_run(SpanCtx sc, int threads) {
+    pthread_t	*tids = (pthread_t*)OJ_MALLOC(sizeof(pthread_t) * threads);
+    int		started = 0;
 
-    memset(&p, 0, sizeof(p));
-    p.pp = true;
-    p.ctx = ctx;
-    p.push = push;
-    p.pop = pop;
-    p.err.line = 1;
-    p.map = value_map;
-    parse_fd(&p, err, fd);
+    atomic_init(&sc->next, 0);
+    for (; started < threads - 1; started++) {
+	if (0 != pthread_create(tids + started, NULL, span_worker, sc)) {
+	    break;
+	}
+    }
+    span_worker(sc);
+    for (int i = 0; i < started; i++) {
+	pthread_join(tids[i], NULL);
+    }
+    OJ_FREE(tids);
+}
 
-    if (OJ_OK != p.err.code && NULL != err) {
-	*err = p.err;
+// Splits the array elements after the opening bracket at start into chunks.
+// Regions of the input are scanned in parallel for their quote parity and
+// depth changes. A prefix pass over those gives the string state and depth
+// at the start of each region and a second parallel pass finds the first
+// comma at the top depth in each region.
+static void
+array_bounds(ParCtx pc, off_t start, off_t size, int threads) {
+    struct _SpanCtx	sc;
+    off_t		chunk = par_chunk_size(size - start, threads);
+
+    memset(&sc, 0, sizeof(sc));
+    sc.base = pc->base;
+    // Splitting doesn't help a single thread.
+    sc.cnt = (1 < threads) ? (int)((size - start + chunk - 1) / chunk) : 1;
+    sc.starts = (off_t*)OJ_MALLOC(sizeof(off_t) * (sc.cnt + 1));
+    sc.spans = (struct _ojSpan*)OJ_MALLOC(sizeof(struct _ojSpan) * sc.cnt);
+    sc.in_str = (bool*)OJ_MALLOC(sizeof(bool) * (sc.cnt + 1));
+    sc.depth = (long long*)OJ_MALLOC(sizeof(long long) * (sc.cnt + 1));
+    sc.splits = (const byte**)OJ_MALLOC(sizeof(const byte*) * sc.cnt);
+    for (int r = 0; r < sc.cnt; r++) {
+	sc.starts[r] = start + chunk * r;
     }
-    if (NULL != p.ready) {
-	p.ready->type = OJ_ARRAY;
-	p.ready->list.head = p.ready->next;
-	p.ready->list.tail = p.ready->next;
-	if (NULL != p.ready->list.tail) {
-	    for (; NULL != p.ready->list.tail->next; p.ready->list.tail = p.ready->list.tail->next) {
+    sc.starts[sc.cnt] = size;
+    if (1 < sc.cnt) {
+	span_run(&sc, threads);
+	sc.in_str[0] = false;
+	sc.depth[0] = 1;
+	for (int r = 0; r < sc.cnt; r++) {
+	    ojSpan	span = sc.spans + r;
+
+	    sc.in_str[r + 1] = sc.in_str[r] != span->odd_quotes;
+	    sc.depth[r + 1] = sc.depth[r] + (sc.in_str[r] ? span->depth_in : span->depth_out);
+	}
+	sc.split = true;
+	span_run(&sc, threads);
+    }
+    pc->bounds = (off_t*)OJ_MALLOC(sizeof(off_t) * (sc.cnt + 1));
+    pc->bounds[0] = start;
+    pc->cnt = 0;
+    for (int r = 1; r < sc.cnt; r++) {
+	if (NULL != sc.splits[r]) {
+	    off_t	off = sc.splits[r] - pc->base;
+
+	    if (pc->bounds[pc->cnt] < off && off < size) {
+		pc->bounds[++pc->cnt] = off;
 	    }
 	}
-	oj_destroy(p.ready);
     }
-    return OJ_OK;
-}
+    pc->bounds[++pc->cnt] = size;
 
-ojVal
-oj_parse_file(ojErr err, const char *filename, ojReuser reuser) {
-    int	fd = open(filename, O_RDONLY);
+    OJ_FREE(sc.starts);
+    OJ_FREE(sc.spans);
+    OJ_FREE(sc.in_str);
+    OJ_FREE(sc.depth);
+    OJ_FREE(sc.splits);
+}
 
-    if (fd < 0) {
-	if (NULL != err) {
-	    oj_err_no(err, "error opening %s", filename);
+static byte*
+read_all(int fd, off_t *sizep) {
+    size_t	cap = 65536;
+    size_t	len = 0;
+    byte	*buf = (byte*)OJ_MALLOC(cap + 1);
+    ssize_t	cnt;
+
+    while (0 < (cnt = read(fd, buf + len, cap - len))) {
+	len += cnt;
+	if (cap <= len) {
+	    cap *= 2;
+	    buf = (byte*)OJ_REALLOC(buf, cap + 1);
 	}
+    }
+    if (cnt < 0) {
+	OJ_FREE(buf);
 	return NULL;
     }
-    ojVal	val = oj_parse_fd(err, fd, reuser);
-
-    close(fd);
+    buf[len] = '\0';
+    *sizep = (off_t)len;
 
-    return val;
+    return buf;
 }
 
-ojStatus
-oj_parse_file_cb(ojErr err, const char *filename, ojParseCallback cb, void *ctx) {
-    int	fd = open(filename, O_RDONLY);
-
-    if (fd < 0) {
+// Parses a single top level array with the elements either stitched onto
+// one array returned in valp or given to the callback in order. Input that
+// is not an array is parsed on the calling thread.
+static ojStatus
+array_parallel(ojErr err, int fd, int threads, ojParseCallback cb, void *ctx, ojVal *valp, ojReuser reuser) {
+    struct _ParCtx	pc;
+    struct _ojErr	e = OJ_ERR_INIT;
+    struct stat		info;
+    off_t		size;
+    off_t		pos = lseek(fd, 0, SEEK_CUR);
+    off_t		start;
+
+    if (threads <= 0) {
+	threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    memset(&pc, 0, sizeof(pc));
+    if (0 == fstat(fd, &info) && S_ISREG(info.st_mode) && 0 < info.st_size &&
+	MAP_FAILED != (pc.base = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0))) {
+	pc.mapped = true;
+	size = info.st_size;
+	madvise(pc.base, size, MADV_SEQUENTIAL);
+    } else if (NULL == (pc.base = read_all(fd, &size))) {
 	if (NULL != err) {
-	    oj_err_no(err, "error opening %s", filename);
+	    oj_err_no(err, "read failed");
 	}
 	return errno;
+    } else {
+	pos = 0;
     }
-    ojStatus	status = oj_parse_fd_cb(err, fd, cb, ctx);
+    for (start = pos; start < size && NULL != strchr(" \t\r\n", pc.base[start]); start++) {
+    }
+    if (size <= start || '[' != pc.base[start]) {
+	if (pc.mapped) {
+	    munmap(pc.base, size);
+	    lseek(fd, pos, SEEK_SET);
+	    if (NULL != cb) {
+		return oj_parse_fd_cb(err, fd, cb, ctx);
+	    }
+	    *valp = oj_parse_fd(&e, fd, reuser);
+	} else if (NULL != cb) {
+	    oj_parse_str_cb(&e, (const char*)pc.base, cb, ctx);
+	    OJ_FREE(pc.base);
+	} else {
+	    *valp = oj_parse_str(&e, (const char*)pc.base, reuser);
+	    OJ_FREE(pc.base);
+	}
+	if (OJ_OK != e.code && NULL != err) {
+	    *err = e;
+	}
+	return e.code;
+    }
+    array_bounds(&pc, start + 1, size, threads);
+    par_last(&pc, size);
+    pc.array = true;
+    pc.ordered = true;
+    pc.cb = cb;
+    pc.ctx = ctx;
+    if (NULL == cb) {
+	pc.top = oj_array_create(&e);
+	pc.top->key.len = 0;
+	pc.top->key.borrow = false;
+	pc.top->next = NULL;
+	pc.top->free = NULL;
+	pc.reuser.head = pc.top;
+	pc.reuser.tail = pc.top;
+    }
+    if (OJ_OK != par_run(&pc, threads, &e)) {
+	oj_reuse(&pc.reuser);
+	pc.top = NULL;
+    }
+    if (pc.mapped) {
+	munmap(pc.base, size);
+	lseek(fd, size, SEEK_SET);
+    } else {
+	OJ_FREE(pc.base);
+    }
+    if (NULL == cb) {
+	*valp = pc.top;
+	if (NULL != reuser) {
+	    *reuser = pc.reuser;
+	}
+    }
+    if (OJ_OK != e.code && NULL != err) {
+	*err = e;
+    }
+    return e.code;
+}
 
-    close(fd);
+ojVal
+oj_parse_fd_array(ojErr err, int fd, int threads, ojReuser reuser) {
+    ojVal	val = NULL;
 
-    return status;
+    array_parallel(err, fd, threads, NULL, NULL, &val, reuser);
+
+    return val;
 }
 
 ojStatus
-oj_parse_file_call(ojErr err, const char *filepath, ojCaller caller) {
+oj_parse_fd_array_cb(ojErr err, int fd, int threads, ojParseCallback cb, void *ctx) {
+    return array_parallel(err, fd, threads, cb, ctx, NULL, NULL);
+}
+
+ojVal
+oj_parse_file_array(ojErr err, const char *filepath, int threads, ojReuser reuser) {
     int	fd = open(filepath, O_RDONLY);
 
     if (fd < 0) {
 	if (NULL != err) {
 	    oj_err_no(err, "error opening %s", filepath);
 	}
-	return errno;
+	return NULL;
     }
-    ojStatus	status = oj_parse_fd_call(err, fd, caller);
+    ojVal	val = oj_parse_fd_array(err, fd, threads, reuser);
 
     close(fd);
 
-    return status;
+    return val;
 }
 
 ojStatus
-oj_pp_parse_file(ojErr err, const char *filepath, void (*push)(ojVal val, void *ctx), void (*pop)(void * ctx), void *ctx) {
+oj_parse_file_array_cb(ojErr err, const char *filepath, int threads, ojParseCallback cb, void *ctx) {
     int	fd = open(filepath, O_RDONLY);
 
     if (fd < 0) {
@@ -2104,122 +3646,356 @@ oj_pp_parse_file(ojErr err, const char *filepath, void (*push)(ojVal val, void *
 	}
 	return errno;
     }
-    ojStatus	status = oj_pp_parse_fd(err, fd, push, pop, ctx);
+    ojStatus	status = oj_parse_fd_array_cb(err, fd, threads, cb, ctx);
 
     close(fd);
 
     return status;
 }
 
+// Documents go to the workers of a pool in turn. The caller passed to
+// oj_caller_start_pool() is the first worker.
+typedef struct _ojCallPool {
+    struct _ojCaller	*workers;	// the workers after the first
+    int			cnt;	// total workers
+    int			turn;	// worker the next document goes to
+    long long		seq;	// next document number
+    bool		ordered;
+    atomic_llong	finished;	// callbacks made when ordered
+    struct _ojPark	park;
+    ojCaller		owner;
+} *CallPool;
+
+#define CALLER_QUEUE_SIZE	((long long)(sizeof(((ojCaller)0)->queue) / sizeof(struct _ojCall)))
+// Destroyed documents are collected by each worker and given back in
+// batches to keep the free list lock quiet.
+#define CALLER_SPENT_MAX	64
+#define CALLER_GROUP_MAX	32
+#define CALLER_GROUP_USEC	100
+
+typedef struct _CallTurn {
+    CallPool	pool;
+    long long	seq;
+} *CallTurn;
+
+static int64_t
+clock_usec() {
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static bool
+caller_turn(void *ctx) {
+    CallTurn	ct = (CallTurn)ctx;
+
+    return ct->pool->owner->done || atomic_load(&ct->pool->owner->shutdown) ||
+	atomic_load(&ct->pool->finished) == ct->seq;
+}
+
+static bool
+caller_has_group(void *ctx) {
+    ojCaller	caller = (ojCaller)ctx;
+
+    return atomic_load(&caller->shutdown) || atomic_load(&caller->consumed) < atomic_load(&caller->published);
+}
+
+static bool
+caller_has_room(void *ctx) {
+    ojCaller	caller = (ojCaller)ctx;
+
+    return caller->written - atomic_load(&caller->consumed) < CALLER_QUEUE_SIZE;
+}
+
 static void*
 caller_loop(void *ctx) {
     ojCaller		caller = (ojCaller)ctx;
-    struct _ojCall	c;
+    CallPool		pool = caller->pool;
+    ojCaller		owner = (NULL == pool) ? caller : pool->owner;
+    struct _ojReuser	spent = { .head = NULL, .tail = NULL, .dig = NULL };
+    int			spent_cnt = 0;
+    long long		r = 0;
+    long long		end;
+    ojCall		c;
     ojCallbackOp	op;
-    ojCall		head = caller->queue;
-    ojCall		next;
-
-    atomic_flag_clear(&caller->starting);
-    while (atomic_flag_test_and_set(&head->busy)) {
-	one_beat();
-    }
-    while (true) {
-	next = head + 1;
-	if (caller->end <= next) {
-	    next = caller->queue;
-	}
-	c = *head;
-	head->val = NULL;
-	if (NULL == c.val) {
-	    atomic_flag_clear(&head->busy);
-	    break;
-	}
-	op = caller->cb(c.val, caller->ctx);
-	if (0 != (OJ_DESTROY & op)) {
-	    oj_reuse(&c.reuser);
-	}
-	if (0 != (OJ_STOP & op)) {
-	    caller->done = true;
-	    break;
-	}
-	while (atomic_flag_test_and_set(&next->busy)) {
-	    one_beat();
+    bool		skip;
+    bool		ordered;
+
+    while (!atomic_load(&caller->shutdown)) {
+	// The whole group is taken with one load and given back with one
+	// store once the callbacks are done.
+	_oj_wait(&caller->park, caller_has_group, caller);
+	for (end = atomic_load(&caller->published); r < end && !atomic_load(&caller->shutdown); r++) {
+	    c = caller->queue + r % CALLER_QUEUE_SIZE;
+	    if (NULL == c->val) {
+		oj_reuse(&c->reuser);
+		oj_reuse(&spent);
+		// Leaves room for the end pushed by oj_caller_wait().
+		atomic_store(&caller->consumed, r + 1);
+		_oj_wake(&caller->park);
+		return NULL;
+	    }
+	    // Once stopped the rest of the documents are only destroyed so
+	    // the parser never waits on a full queue. When ordered the turn
+	    // is held until the callback returns so the callbacks are made
+	    // one at a time in document order and none follows a stop.
+	    ordered = NULL != pool && pool->ordered;
+	    if (ordered) {
+		struct _CallTurn	ct = { .pool = pool, .seq = c->seq };
+
+		_oj_wait(&pool->park, caller_turn, &ct);
+	    }
+	    skip = owner->done || atomic_load(&caller->shutdown);
+	    op = skip ? OJ_DESTROY : caller->cb(c->val, caller->ctx);
+	    if (0 != (OJ_STOP & op)) {
+		owner->done = true;
+		if (NULL != pool) {
+		    _oj_wake(&pool->park);
+		}
+	    }
+	    if (ordered) {
+		atomic_store(&pool->finished, c->seq + 1);
+		_oj_wake(&pool->park);
+	    }
+	    if (0 != (OJ_DESTROY & op)) {
+		if (NULL == pool) {
+		    oj_reuse(&c->reuser);
+		} else {
+		    _oj_reuse_keep(&c->reuser);
+		    if (NULL != c->reuser.head) {
+			if (NULL == spent.head) {
+			    spent.head = c->reuser.head;
+			} else {
+			    spent.tail->free = c->reuser.head;
+			}
+			spent.tail = c->reuser.tail;
+			spent.tail->free = NULL;
+		    }
+		    if (CALLER_SPENT_MAX <= ++spent_cnt) {
+			oj_reuse(&spent);
+			spent.head = NULL;
+			spent.tail = NULL;
+			spent_cnt = 0;
+		    }
+		}
+	    }
 	}
-	atomic_flag_clear(&head->busy);
-	head = next;
+	atomic_store(&caller->consumed, r);
+	_oj_wake(&caller->park);
     }
+    oj_reuse(&spent);
+
     return NULL;
 }
 
 static void
-oj_caller_push(ojParser p, ojCaller caller, ojVal val) {
-    // Should be sitting on a slot waiting for a push.
-    ojCall	tail = caller->tail;
+caller_publish(ojCaller caller) {
+    if (atomic_load_explicit(&caller->published, memory_order_relaxed) < caller->written) {
+	atomic_store(&caller->published, caller->written);
+	_oj_wake(&caller->park);
+    }
+}
+
+static void
+caller_put(ojCaller caller, ojVal val, ojReuser reuser, long long seq) {
+    long long	w = caller->written;
+    ojCall	c;
+
+    if (!caller_has_room(caller)) {
+	// The caller thread can't free anything it hasn't been given. When
+	// ordered it may also be waiting on a document in another worker's
+	// open group.
+	if (NULL == caller->pool) {
+	    caller_publish(caller);
+	} else {
+	    caller_flush(caller->pool->owner);
+	}
+	_oj_wait(&caller->park, caller_has_room, caller);
+    }
+    c = caller->queue + w % CALLER_QUEUE_SIZE;
+    c->val = val;
+    c->seq = seq;
+    c->reuser = *reuser;
+    caller->written = ++w;
 
-    tail->val = val;
-    tail->reuser.head = p->all_head;
-    tail->reuser.tail = p->all_tail;
-    tail->reuser.dig = p->all_dig;
+    long long	open = w - atomic_load_explicit(&caller->published, memory_order_relaxed);
 
-    tail++;
-    if (caller->end <= tail) {
-	tail = caller->queue;
+    if (1 == open) {
+	caller->opened = clock_usec();
     }
-    while (atomic_flag_test_and_set(&tail->busy)) {
-	one_beat();
+    if (NULL == val || caller->group_max <= open ||
+	(0 == (open & 0x07) && caller->group_usec <= clock_usec() - caller->opened)) {
+	caller_publish(caller);
     }
-    atomic_flag_clear(&caller->tail->busy);
-    caller->tail = tail;
+}
+
+// A NULL val ends the parse so it goes to every worker.
+static void
+oj_caller_push(ojParser p, ojCaller caller, ojVal val) {
+    CallPool		pool = caller->pool;
+    struct _ojReuser	r = { .head = p->all_head, .tail = p->all_tail, .dig = p->all_dig };
+
     p->all_head = NULL;
     p->all_tail = NULL;
     p->all_dig = NULL;
+    if (NULL == pool) {
+	caller_put(caller, val, &r, 0);
+    } else if (NULL == val) {
+	caller_put(caller, NULL, &r, 0);
+	r.head = NULL;
+	r.tail = NULL;
+	r.dig = NULL;
+	for (int i = 0; i < pool->cnt - 1; i++) {
+	    caller_put(pool->workers + i, NULL, &r, 0);
+	}
+    } else {
+	ojCaller	w = (0 == pool->turn) ? caller : pool->workers + pool->turn - 1;
+
+	caller_put(w, val, &r, pool->seq++);
+	if (pool->cnt <= ++pool->turn) {
+	    pool->turn = 0;
+	}
+    }
 }
 
-ojStatus
-oj_caller_start(ojErr err, ojCaller caller, ojParseCallback cb, void *ctx) {
+// Called at the end of each block of input so documents don't wait on the
+// next read.
+static void
+caller_flush(ojCaller caller) {
+    caller_publish(caller);
+    if (NULL != caller->pool) {
+	for (int i = 0; i < caller->pool->cnt - 1; i++) {
+	    caller_publish(caller->pool->workers + i);
+	}
+    }
+}
+
+static ojStatus
+caller_run(ojErr err, ojCaller caller, ojParseCallback cb, void *ctx, CallPool pool) {
     memset(caller, 0, sizeof(struct _ojCaller));
     caller->cb = cb;
     caller->ctx = ctx;
-    caller->end = caller->queue + sizeof(caller->queue) / sizeof(*caller->queue);
-    caller->tail = caller->queue;
-    for (ojCall c = caller->queue; c < caller->end; c++) {
-	atomic_flag_clear(&c->busy);
-    }
-    atomic_flag_test_and_set(&caller->queue->busy);
-    atomic_flag_test_and_set(&caller->starting);
+    caller->pool = pool;
+    caller->group_max = CALLER_GROUP_MAX;
+    caller->group_usec = CALLER_GROUP_USEC;
+    atomic_init(&caller->published, 0);
+    atomic_init(&caller->consumed, 0);
+    atomic_init(&caller->shutdown, false);
+    atomic_init(&caller->park.seq, 0);
+    atomic_init(&caller->park.waiters, 0);
 
     int	status;
 
     if (0 != (status = pthread_create(&caller->thread, NULL, caller_loop, (void*)caller))) {
 	return oj_err_set(err, status, "failed to create caller thread");
     }
-    while (atomic_flag_test_and_set(&caller->starting)) {
-	one_beat();
+    return OJ_OK;
+}
+
+ojStatus
+oj_caller_start(ojErr err, ojCaller caller, ojParseCallback cb, void *ctx) {
+    return caller_run(err, caller, cb, ctx, NULL);
+}
+
+ojStatus
+oj_caller_start_pool(ojErr err, ojCaller caller, int workers, bool ordered, ojParseCallback cb, void *ctx) {
+    CallPool	pool;
+
+    if (workers < 1) {
+	workers = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	if (workers < 1) {
+	    workers = 1;
+	}
+    }
+    if (NULL == (pool = (CallPool)OJ_CALLOC(1, sizeof(struct _ojCallPool)))) {
+	return OJ_ERR_MEM(err, "caller pool");
+    }
+    if (1 < workers && NULL == (pool->workers = (ojCaller)OJ_CALLOC(workers - 1, sizeof(struct _ojCaller)))) {
+	OJ_FREE(pool);
+	return OJ_ERR_MEM(err, "caller pool");
+    }
+    pool->ordered = ordered;
+    pool->owner = caller;
+    atomic_init(&pool->finished, 0);
+    _oj_threads_begin();
+
+    if (OJ_OK != caller_run(err, caller, cb, ctx, pool)) {
+	_oj_threads_end();
+	OJ_FREE(pool->workers);
+	OJ_FREE(pool);
+	return err->code;
     }
-    atomic_flag_clear(&caller->starting);
+    pool->cnt = 1;
+    for (ojCaller w = pool->workers; w < pool->workers + workers - 1; w++) {
+	struct _ojErr	e = OJ_ERR_INIT;
 
+	// Carry on with the workers that did start.
+	if (OJ_OK != caller_run(&e, w, cb, ctx, pool)) {
+	    break;
+	}
+	pool->cnt++;
+    }
     return OJ_OK;
 }
 
+static void
+caller_free(ojCaller caller) {
+    if (NULL != caller->pool) {
+	_oj_threads_end();
+	OJ_FREE(caller->pool->workers);
+	OJ_FREE(caller->pool);
+	caller->pool = NULL;
+    }
+}
+
+static void
+caller_quit(ojCaller caller) {
+    atomic_store(&caller->shutdown, true);
+    _oj_wake(&caller->park);
+}
+
+// Idle workers are parked on a futex which is not a cancellation point so
+// each is told to quit and woken instead. All are told before any is joined
+// since an ordered worker may be waiting on the turn of another.
 void
 oj_caller_shutdown(ojCaller caller) {
-    pthread_cancel(caller->thread);
+    CallPool	pool = caller->pool;
+
+    caller_quit(caller);
+    if (NULL != pool) {
+	for (int i = 0; i < pool->cnt - 1; i++) {
+	    caller_quit(pool->workers + i);
+	}
+	_oj_wake(&pool->park);
+	for (int i = 0; i < pool->cnt - 1; i++) {
+	    pthread_join(pool->workers[i].thread, NULL);
+	}
+    }
     pthread_join(caller->thread, NULL);
+    caller_free(caller);
 }
 
-void
-oj_caller_wait(ojCaller caller) {
-    ojCall	tail = caller->tail;
-
-    tail->val = NULL;
-    tail->reuser.head = NULL;
-    tail->reuser.tail = NULL;
-    tail->reuser.dig = NULL;
-    atomic_flag_clear(&tail->busy);
+static void
+caller_end(ojCaller caller) {
+    struct _ojReuser	r = { .head = NULL, .tail = NULL, .dig = NULL };
 
+    caller_put(caller, NULL, &r, 0);
     pthread_join(caller->thread, NULL);
 }
 
+void
+oj_caller_wait(ojCaller caller) {
+    if (NULL != caller->pool) {
+	for (int i = 0; i < caller->pool->cnt - 1; i++) {
+	    caller_end(caller->pool->workers + i);
+	}
+    }
+    caller_end(caller);
+    caller_free(caller);
+}
+
 void
 _oj_val_append_str(ojParser p, const byte *s, size_t len) {
     _oj_append_str(&p->err, &p->stack->str, s, len);
@@ -0,0 +1,678 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+// The parse loop, included by parse.c once for each way vals are handed off
+// so that pushing and popping a val does not check the mode on every
+// value. Before including define PARSE_LOOP as the name of the function,
+// PARSE_MODE as one of the MODE_ values, and PUSH_VAL and POP_VAL as the
+// push and pop functions for that mode. They are undefined at the end.
+
+static ojStatus
+PARSE_LOOP(ojParser p, const byte *json, const bool lazy) {
+#if THREADED
+    static const void	*jump[128] = {
+	[0 ... 127] = &&L_default,
+	JUMP(SKIP_NEWLINE), JUMP(COLON_COLON), JUMP(SKIP_CHAR), JUMP(KEY_QUOTE), JUMP(AFTER_COMMA),
+	JUMP(VAL_QUOTE), JUMP(OPEN_OBJECT), JUMP(NUM_CLOSE_OBJECT), JUMP(CLOSE_OBJECT),
+	JUMP(OPEN_ARRAY), JUMP(NUM_CLOSE_ARRAY), JUMP(CLOSE_ARRAY), JUMP(NUM_COMMA), JUMP(VAL0),
+	JUMP(VAL_NEG), JUMP(VAL_DIGIT), JUMP(NUM_DIGIT), JUMP(NUM_DOT), JUMP(NUM_FRAC),
+	JUMP(FRAC_E), JUMP(NUM_ZERO), JUMP(NEG_DIGIT), JUMP(EXP_SIGN), JUMP(EXP_DIGIT),
+	JUMP(BIG_DIGIT), JUMP(BIG_DOT), JUMP(BIG_FRAC), JUMP(BIG_E), JUMP(BIG_EXP_SIGN),
+	JUMP(BIG_EXP), JUMP(NUM_SPC), JUMP(NUM_NEWLINE), JUMP(STR_OK), JUMP(STR_SLASH),
+	JUMP(STR_QUOTE), JUMP(ESC_U), JUMP(U_OK), JUMP(ESC_OK), JUMP(UTF1), JUMP(UTF2), JUMP(UTF3),
+	JUMP(UTFX), JUMP(VAL_NULL), JUMP(VAL_TRUE), JUMP(VAL_FALSE), JUMP(TOKEN_OK),
+	JUMP(CHAR_ERR),
+    };
+#endif
+    const byte *start;
+    const byte	*nl;
+    ojVal	v;
+    ShapeKey	sk = NULL;
+    bool	hit = false;
+    const byte	*b = json;
+
+#if DEBUG
+    printf("*** parse - mode: %c %s\n", p->map[256], (const char*)json);
+#endif
+    if (p->skipping && NULL == (b = skip_val(p, b, json))) {
+	return p->err.code;
+    }
+    for (; '\0' != *b; b++) {
+#if DEBUG
+	print_stack(p, "loop");
+#endif
+	DISPATCH {
+	CASE(SKIP_NEWLINE):
+	    if (lazy) {
+		b = skip_white(b + 1) - 1;
+		NEXT;
+	    }
+	    nl = b;
+	    p->err.line++;
+	    b = skip_space(b + 1, &p->err.line, &nl) - 1;
+	    p->err.col = nl - json;
+	    NEXT;
+	CASE(COLON_COLON):
+	    p->map = value_map;
+	    if (NULL != p->filter) {
+		if (!p->skip_next && !p->key_kept && !filter_key(p, oj_key(p->stack), p->stack->key.len)) {
+		    // A key with escapes is only known once it is complete.
+		    v = p->stack;
+		    p->stack = v->next;
+		    add_to_all(p, v);
+		    p->skip_next = true;
+		}
+		p->key_kept = false;
+		if (p->skip_next) {
+		    p->skip_next = false;
+		    p->skipping = true;
+		    if (NULL == (b = skip_val(p, b + 1, json))) {
+			return p->err.code;
+		    }
+		    b--;
+		}
+	    }
+	    NEXT;
+	CASE(SKIP_CHAR):
+	    NEXT;
+	CASE(KEY_QUOTE):
+	    b++;
+	    start = b;
+	    // The comparison stops at the terminator so a key cut off by the
+	    // end of the input is not read past.
+	    if (NULL != p->shapes && NULL != (sk = shape_key(p->shapes)) && NULL != sk->key &&
+		0 == strncmp((const char*)b, sk->key, sk->len) && '"' == b[sk->len]) {
+		b += sk->len;
+		hit = true;
+	    } else {
+		b = _oj_scan_str(b);
+		hit = false;
+	    }
+	    if (NULL != p->filter && '"' == *b) {
+		if (!filter_key(p, (const char*)start, b - start)) {
+		    if (NULL != sk && !hit) {
+			shape_learn(sk, start, b - start, NULL);
+		    }
+		    p->skip_next = true;
+		    p->map = colon_map;
+		    NEXT;
+		}
+		p->key_kept = true;
+	    }
+	    v = PUSH_VAL(p, OJ_NONE, 0);
+	    if ('"' == *b) {
+		if (p->insitu) {
+		    v->key.ptr = (char*)start;
+		    v->key.len = b - start;
+		    v->key.borrow = true;
+		    v->key.intern = false;
+		    *(byte*)b = '\0';
+		} else if (oj_intern_keys) {
+		    if (hit && sk->intern) {
+			v->key.ptr = (char*)sk->key;
+			v->key.len = sk->len;
+			v->key.borrow = true;
+			v->key.intern = true;
+			v->kh = sk->kh;
+		    } else {
+			_oj_val_intern_key(v, (char*)start, b - start);
+		    }
+		} else {
+		    _oj_val_set_key(v, (char*)start, b - start);
+		}
+		if (NULL != sk && !hit) {
+		    shape_learn(sk, start, b - start, v);
+		}
+		p->map = colon_map;
+		NEXT;
+	    }
+	    _oj_val_set_key(v, (char*)start, b - start);
+	    b--;
+	    p->map = string_map;
+	    p->next_map = colon_map;
+	    NEXT;
+	CASE(AFTER_COMMA):
+	    if (OJ_OBJECT == p->stack->type) {
+		p->map = key_map;
+	    } else {
+		p->map = comma_map;
+	    }
+	    NEXT;
+	CASE(VAL_QUOTE):
+	    v = PUSH_VAL(p, OJ_STRING, 0);
+	    b++;
+	    start = b;
+	    b = _oj_scan_str(b);
+	    if ('"' == *b) {
+		if (p->insitu) {
+		    v->str.ptr = (char*)start;
+		    v->str.len = b - start;
+		    v->str.borrow = true;
+		    *(byte*)b = '\0';
+		} else {
+		    _oj_val_set_str(v, (char*)start, b - start);
+		}
+		if (POP_VAL(p)) {
+		    return OJ_ABORT;
+		}
+		p->map = (NULL == p->stack) ? value_map : after_map;
+		NEXT;
+	    }
+	    _oj_val_set_str(v, (char*)start, b - start);
+	    b--;
+	    p->map = string_map;
+	    p->next_map = (NULL == p->stack->next) ? value_map : after_map;
+	    NEXT;
+	CASE(OPEN_OBJECT):
+	    if (NULL != p->filter) {
+		filter_push(p);
+	    }
+	    if (NULL != p->shapes) {
+		shape_push(p->shapes, NULL == p->stack || p->root == p->stack, false);
+	    }
+	    v = PUSH_VAL(p, OJ_OBJECT, OJ_OBJ_RAW);
+	    v->list.head = NULL;
+	    v->list.tail = NULL;
+	    p->map = key1_map;
+	    NEXT;
+	CASE(NUM_CLOSE_OBJECT):
+	    calc_num(p->stack);
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    // flow through
+	CASE(CLOSE_OBJECT):
+	    if (NULL == p->stack || OJ_OBJECT != p->stack->type) {
+		p->err.col = b - json - p->err.col + 1;
+		return parse_error(p, "unexpected object close");
+	    }
+	    if (NULL != p->filter) {
+		filter_pop(p);
+	    }
+	    if (NULL != p->shapes) {
+		shape_pop(p->shapes);
+	    }
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    NEXT;
+	CASE(OPEN_ARRAY):
+	    if (NULL != p->filter) {
+		filter_push(p);
+	    }
+	    if (NULL != p->shapes) {
+		shape_push(p->shapes, NULL == p->stack || p->root == p->stack, true);
+	    }
+	    v = PUSH_VAL(p, OJ_ARRAY, 0);
+	    v->list.head = NULL;
+	    v->list.tail = NULL;
+	    p->map = value_map;
+	    NEXT;
+	CASE(NUM_CLOSE_ARRAY):
+	    calc_num(p->stack);
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    // flow through
+	CASE(CLOSE_ARRAY):
+	    if (NULL == p->stack || OJ_ARRAY != p->stack->type) {
+		p->err.col = b - json - p->err.col + 1;
+		return parse_error(p, "unexpected array close");
+	    }
+	    if (p->root == p->stack) {
+		p->stack = NULL;
+		p->map = trail_map;
+		NEXT;
+	    }
+	    if (NULL != p->filter) {
+		filter_pop(p);
+	    }
+	    if (NULL != p->shapes) {
+		shape_pop(p->shapes);
+	    }
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    NEXT;
+	CASE(NUM_COMMA):
+	    calc_num(p->stack);
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    if (NULL == p->stack) {
+		p->err.col = b - json - p->err.col + 1;
+		return parse_error(p, "unexpected comma");
+	    }
+	    if (OJ_OBJECT == p->stack->type) {
+		p->map = key_map;
+	    } else {
+		p->map = comma_map;
+	    }
+	    NEXT;
+	CASE(VAL0):
+	    v = PUSH_VAL(p, OJ_INT, 0);
+	    v->num.fixnum = 0;
+	    v->num.neg = false;
+	    v->num.shift = 0;
+	    v->num.calc = false;
+	    v->num.len = 0;
+	    v->num.exp = 0;
+	    v->num.exp_neg = false;
+	    p->map = zero_map;
+	    NEXT;
+	CASE(VAL_NEG):
+	    v = PUSH_VAL(p, OJ_INT, 0);
+	    v->num.fixnum = 0;
+	    v->num.neg = true;
+	    v->num.shift = 0;
+	    v->num.calc = false;
+	    v->num.len = 0;
+	    v->num.exp = 0;
+	    v->num.exp_neg = false;
+	    p->map = neg_map;
+	    NEXT;;
+	CASE(VAL_DIGIT):
+	    v = PUSH_VAL(p, OJ_INT, 0);
+	    v->num.fixnum = 0;
+	    v->num.neg = false;
+	    v->num.shift = 0;
+	    v->num.calc = false;
+	    v->num.exp = 0;
+	    v->num.exp_neg = false;
+	    v->num.len = 0;
+	    p->map = digit_map;
+	    for (; NUM_DIGIT == digit_map[*b]; b++) {
+		uint64_t	x = (uint64_t)v->num.fixnum * 10 + (uint64_t)(*b - '0');
+
+		// Tried just checking for an int less than zero but that
+		// fails when optimization is on for some reason with the
+		// clang compiler so us a bit mask instead.
+		if (0 == (0x8000000000000000ULL & x)) {
+		    v->num.fixnum = (int64_t)x;
+		} else {
+		    big_change(v);
+		    p->map = big_digit_map;
+		    break;
+		}
+	    }
+	    b--;
+	    NEXT;
+	CASE(NUM_DIGIT):
+	    v = p->stack;
+	    for (; NUM_DIGIT == digit_map[*b]; b++) {
+		uint64_t	x = v->num.fixnum * 10 + (uint64_t)(*b - '0');
+
+		if (0 == (0x8000000000000000ULL & x)) {
+		    v->num.fixnum = (int64_t)x;
+		} else {
+		    big_change(v);
+		    p->map = big_digit_map;
+		    break;
+		}
+	    }
+	    b--;
+	    NEXT;
+	CASE(NUM_DOT):
+	    p->stack->type = OJ_DECIMAL;
+	    p->map = dot_map;
+	    NEXT;
+	CASE(NUM_FRAC):
+	    p->map = frac_map;
+	    v = p->stack;
+	    for (; NUM_FRAC == frac_map[*b]; b++) {
+		uint64_t	x = v->num.fixnum * 10 + (uint64_t)(*b - '0');
+
+		if (0 == (0x8000000000000000ULL & x)) {
+		    v->num.fixnum = (int64_t)x;
+		    v->num.shift++;
+		} else {
+		    big_change(v);
+		    p->map = big_frac_map;
+		    break;
+		}
+	    }
+	    b--;
+	    NEXT;
+	CASE(FRAC_E):
+	    p->stack->type = OJ_DECIMAL;
+	    p->map = exp_sign_map;
+	    NEXT;
+	CASE(NUM_ZERO):
+	    p->map = zero_map;
+	    NEXT;
+	CASE(NEG_DIGIT):
+	    v = p->stack;
+	    for (; NUM_DIGIT == digit_map[*b]; b++) {
+		uint64_t	x = v->num.fixnum * 10 + (uint64_t)(*b - '0');
+
+		if (0 == (0x8000000000000000ULL & x)) {
+		    v->num.fixnum = (int64_t)x;
+		} else {
+		    big_change(v);
+		    p->map = big_digit_map;
+		    break;
+		}
+	    }
+	    b--;
+	    p->map = digit_map;
+	    NEXT;
+	CASE(EXP_SIGN):
+	    p->stack->num.exp_neg = ('-' == *b);
+	    p->map = exp_zero_map;
+	    NEXT;
+	CASE(EXP_DIGIT):
+	    v = p->stack;
+	    p->map = exp_map;
+	    for (; NUM_DIGIT == digit_map[*b]; b++) {
+		int16_t	x = v->num.exp * 10 + (int16_t)(*b - '0');
+
+		if (x <= MAX_EXP) {
+		    v->num.exp = x;
+		} else {
+		    big_change(v);
+		    p->map = big_exp_map;
+		    break;
+		}
+	    }
+	    b--;
+	    NEXT;
+	CASE(BIG_DIGIT):
+	    start = b;
+	    for (; NUM_DIGIT == digit_map[*b]; b++) {
+	    }
+	    _oj_append_num(&p->err, &p->stack->num, (char*)start, b - start);
+	    b--;
+	    NEXT;
+	CASE(BIG_DOT):
+	    p->stack->type = OJ_DECIMAL;
+	    _oj_append_num(&p->err, &p->stack->num, ".", 1);
+	    p->map = big_dot_map;
+	    NEXT;
+	CASE(BIG_FRAC):
+	    p->map = big_frac_map;
+	    start = b;
+	    for (; NUM_FRAC == frac_map[*b]; b++) {
+	    }
+	    _oj_append_num(&p->err, &p->stack->num, (char*)start, b - start);
+	    b--;
+	    NEXT;
+	CASE(BIG_E):
+	    p->stack->type = OJ_DECIMAL;
+	    _oj_append_num(&p->err, &p->stack->num, (const char*)b, 1);
+	    p->map = big_exp_sign_map;
+	    NEXT;
+	CASE(BIG_EXP_SIGN):
+	    _oj_append_num(&p->err, &p->stack->num, (const char*)b, 1);
+	    p->map = big_exp_zero_map;
+	    NEXT;
+	CASE(BIG_EXP):
+	    start = b;
+	    for (; NUM_DIGIT == digit_map[*b]; b++) {
+	    }
+	    _oj_append_num(&p->err, &p->stack->num, (char*)start, b - start);
+	    b--;
+	    p->map = big_exp_map;
+	    NEXT;
+	CASE(NUM_SPC):
+	    calc_num(p->stack);
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    NEXT;
+	CASE(NUM_NEWLINE):
+	    calc_num(p->stack);
+	    if (POP_VAL(p)) {
+		return OJ_ABORT;
+	    }
+	    if (lazy) {
+		b = skip_white(b + 1) - 1;
+		NEXT;
+	    }
+	    nl = b;
+	    p->err.line++;
+	    b = skip_space(b + 1, &p->err.line, &nl) - 1;
+	    p->err.col = nl - json;
+	    NEXT;
+	CASE(STR_OK):
+	    start = b;
+	    b = _oj_scan_str(b);
+	    if (':' == p->next_map[256]) {
+		_oj_append_str(&p->err, &p->stack->key, start, b - start);
+	    } else {
+		_oj_append_str(&p->err, &p->stack->str, start, b - start);
+	    }
+	    if ('"' == *b) {
+		p->map = p->next_map;
+		if (':' != p->map[256]) {
+		    if (POP_VAL(p)) {
+			return OJ_ABORT;
+		    }
+		}
+		NEXT;
+	    }
+	    b--;
+	    NEXT;
+	CASE(STR_SLASH):
+	    p->map = esc_map;
+	    NEXT;
+	CASE(STR_QUOTE):
+	    p->map = p->next_map;
+	    if (':' != p->map[256]) {
+		if (POP_VAL(p)) {
+		    return OJ_ABORT;
+		}
+	    }
+	    NEXT;
+	CASE(ESC_U):
+	    p->map = u_map;
+	    p->ri = 0;
+	    p->ucode = 0;
+	    NEXT;
+	CASE(U_OK):
+	    p->ri++;
+	    p->ucode = p->ucode << 4 | (uint32_t)hex_map[*b];
+	    if (4 <= p->ri) {
+		byte	utf8[8];
+		size_t	ulen = _oj_unicode_to_utf8(p->ucode, utf8);
+
+		if (0 < ulen) {
+		    if (':' == p->next_map[256]) {
+			_oj_append_str(&p->err, &p->stack->key, utf8, ulen);
+		    } else {
+			_oj_append_str(&p->err, &p->stack->str, utf8, ulen);
+		    }
+		} else {
+		    p->err.col = b - json - p->err.col + 1;
+		    return parse_error(p, "invalid unicode");
+		}
+		p->map = string_map;
+	    }
+	    NEXT;
+	CASE(ESC_OK):
+	    if (':' == p->next_map[256]) {
+		_oj_append_str(&p->err, &p->stack->key, (byte*)&esc_byte_map[*b], 1);
+	    } else {
+		_oj_append_str(&p->err, &p->stack->str, (byte*)&esc_byte_map[*b], 1);
+	    }
+	    p->map = string_map;
+	    NEXT;
+	CASE(UTF1):
+	    p->ri = 1;
+	    p->map = utf_map;
+	    if (':' == p->next_map[256]) {
+		_oj_append_str(&p->err, &p->stack->key, b, 1);
+	    } else {
+		_oj_append_str(&p->err, &p->stack->str, b, 1);
+	    }
+	    NEXT;
+	CASE(UTF2):
+	    p->ri = 2;
+	    p->map = utf_map;
+	    if (':' == p->next_map[256]) {
+		_oj_append_str(&p->err, &p->stack->key, b, 1);
+	    } else {
+		_oj_append_str(&p->err, &p->stack->str, b, 1);
+	    }
+	    NEXT;
+	CASE(UTF3):
+	    p->ri = 3;
+	    p->map = utf_map;
+	    if (':' == p->next_map[256]) {
+		_oj_append_str(&p->err, &p->stack->key, b, 1);
+	    } else {
+		_oj_append_str(&p->err, &p->stack->str, b, 1);
+	    }
+	    NEXT;
+	CASE(UTFX):
+	    p->ri--;
+	    if (':' == p->next_map[256]) {
+		_oj_append_str(&p->err, &p->stack->key, b, 1);
+	    } else {
+		_oj_append_str(&p->err, &p->stack->str, b, 1);
+	    }
+	    if (p->ri <= 0) {
+		p->map = string_map;
+	    }
+	    NEXT;
+	CASE(VAL_NULL):
+	    if ('u' == b[1] && 'l' == b[2] && 'l' == b[3]) {
+		b += 3;
+		PUSH_VAL(p, OJ_NULL, 0);
+		if (POP_VAL(p)) {
+		    return OJ_ABORT;
+		}
+		NEXT;
+	    }
+	    p->ri = 0;
+	    *p->token = *b++;
+	    for (int i = 1; i < 4; i++) {
+		if ('\0' == *b) {
+		    p->ri = i;
+		    break;
+		} else {
+		    p->token[i] = *b++;
+		}
+	    }
+	    if (0 < p->ri) {
+		p->map = null_map;
+		b--;
+		NEXT;
+	    }
+	    return word_error(p, b, json, 4, "null");
+	CASE(VAL_TRUE):
+	    if ('r' == b[1] && 'u' == b[2] && 'e' == b[3]) {
+		b += 3;
+		PUSH_VAL(p, OJ_TRUE, 0);
+		if (POP_VAL(p)) {
+		    return OJ_ABORT;
+		}
+		NEXT;
+	    }
+	    p->ri = 0;
+	    *p->token = *b++;
+	    for (int i = 1; i < 4; i++) {
+		if ('\0' == *b) {
+		    p->ri = i;
+		    break;
+		} else {
+		    p->token[i] = *b++;
+		}
+	    }
+	    if (0 < p->ri) {
+		p->map = true_map;
+		b--;
+		NEXT;
+	    }
+	    return word_error(p, b, json, 4, "true");
+	CASE(VAL_FALSE):
+	    if ('a' == b[1] && 'l' == b[2] && 's' == b[3] && 'e' == b[4]) {
+		b += 4;
+		PUSH_VAL(p, OJ_FALSE, 0);
+		if (POP_VAL(p)) {
+		    return OJ_ABORT;
+		}
+		NEXT;
+	    }
+	    p->ri = 0;
+	    *p->token = *b++;
+	    for (int i = 1; i < 5; i++) {
+		if ('\0' == *b) {
+		    p->ri = i;
+		    break;
+		} else {
+		    p->token[i] = *b++;
+		}
+	    }
+	    if (0 < p->ri) {
+		p->map = false_map;
+		b--;
+		NEXT;
+	    }
+	    return word_error(p, b, json, 5, "false");
+	CASE(TOKEN_OK):
+	    p->token[p->ri] = *b;
+	    p->ri++;
+	    switch (p->map[256]) {
+	    case 'N':
+		if (4 == p->ri) {
+		    if (0 != strncmp("null", p->token, 4)) {
+			return word_error(p, b, json, 3, "null");
+		    }
+		    PUSH_VAL(p, OJ_NULL, 0);
+		    if (POP_VAL(p)) {
+			return OJ_ABORT;
+		    }
+		}
+		break;
+	    case 'F':
+		if (5 == p->ri) {
+		    if (0 != strncmp("false", p->token, 5)) {
+			return word_error(p, b, json, 4, "false");
+		    }
+		    PUSH_VAL(p, OJ_FALSE, 0);
+		    if (POP_VAL(p)) {
+			return OJ_ABORT;
+		    }
+		}
+		break;
+	    case 'T':
+		if (4 == p->ri) {
+		    if (0 != strncmp("true", p->token, 4)) {
+			return word_error(p, b, json, 3, "true");
+		    }
+		    PUSH_VAL(p, OJ_TRUE, 0);
+		    if (POP_VAL(p)) {
+			return OJ_ABORT;
+		    }
+		}
+		break;
+	    default:
+		p->err.col = b - json - p->err.col;
+		return parse_error(p, "parse error");
+	    }
+	    NEXT;
+	CASE(CHAR_ERR):
+	    if (OJ_OK == p->err.code) {
+		byte_error(&p->err, p->map, b - json, *b);
+		parse_free_stack(p);
+	    }
+	    return p->err.code;
+	DEFAULT:
+	    NEXT;
+	}
+    }
+    if (!p->more && OJ_ABORT == parse_number_end(p)) {
+	return OJ_ABORT;
+    }
+    if ('R' == p->map[256]) {
+	p->end = (const char*)b + 1;
+    }
+    if (MODE_CALLER == PARSE_MODE) {
+	caller_flush(p->caller);
+    }
+    return p->err.code;
+}
+
+#undef PARSE_LOOP
+#undef PARSE_MODE
+#undef PUSH_VAL
+#undef POP_VAL
@@ -0,0 +1,397 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "oj.h"
+#include "debug.h"
+#include "intern.h"
+
+// Reads are made ahead of the parser into a ring of blocks so the parser
+// only waits if the reads can't keep up. With io_uring all the free blocks
+// have a read in flight. Otherwise a thread fills the blocks one at a time.
+
+#define READ_BLOCK_SIZE	(256 * 1024)
+#define READ_BLOCK_CNT	8
+
+typedef struct _Block {
+    byte	*buf;
+    ssize_t	len;	// bytes read, 0 at the end, or -errno
+    off_t	off;
+    bool	pending;	// a read is in flight
+} *Block;
+
+struct _ojReader {
+    int			fd;
+    struct _Block	blocks[READ_BLOCK_CNT];
+    byte		*mem;
+    long long		next;	// next block handed to the parser
+    bool		uring;
+
+    // thread
+    pthread_t		thread;
+    atomic_llong	filled;
+    atomic_llong	released;
+    atomic_bool		stop;
+    struct _ojPark	park;
+
+    // io_uring
+    int			ring;
+    off_t		end;
+    unsigned		*sq_tail;
+    unsigned		*sq_mask;
+    unsigned		*sq_array;
+    unsigned		*cq_head;
+    unsigned		*cq_tail;
+    unsigned		*cq_mask;
+    struct io_uring_sqe	*sqes;
+    struct io_uring_cqe	*cqes;
+    void		*sq_map;
+    size_t		sq_len;
+    void		*cq_map;
+    size_t		cq_len;
+    size_t		sqes_len;
+};
+
+//// thread
+
+// The reader can fill the next block once the parser has released the
+// block it last used.
+static bool
+block_free(void *ctx) {
+    ojReader	r = (ojReader)ctx;
+
+    return r->stop || atomic_load(&r->filled) - atomic_load(&r->released) < READ_BLOCK_CNT;
+}
+
+static bool
+block_filled(void *ctx) {
+    ojReader	r = (ojReader)ctx;
+
+    return r->next < atomic_load(&r->filled);
+}
+
+static void*
+read_loop(void *ctx) {
+    ojReader	r = (ojReader)ctx;
+
+    for (long long i = 0; !r->stop; i++) {
+	Block	b = r->blocks + i % READ_BLOCK_CNT;
+
+	_oj_wait(&r->park, block_free, r);
+	if (r->stop) {
+	    break;
+	}
+	while ((b->len = read(r->fd, b->buf, READ_BLOCK_SIZE)) < 0 && EINTR == errno) {
+	}
+	if (b->len < 0) {
+	    b->len = -errno;
+	} else {
+	    b->buf[b->len] = '\0';
+	}
+	atomic_store(&r->filled, i + 1);
+	_oj_wake(&r->park);
+	if (b->len <= 0) {
+	    break;
+	}
+    }
+    return NULL;
+}
+
+static Block
+thread_next(ojReader r) {
+    atomic_store(&r->released, r->next);
+    _oj_wake(&r->park);
+    _oj_wait(&r->park, block_filled, r);
+
+    return r->blocks + r->next % READ_BLOCK_CNT;
+}
+
+//// io_uring
+
+static int
+uring_enter(int ring, unsigned submit, unsigned wait) {
+    return (int)syscall(__NR_io_uring_enter, ring, submit, wait, 0 < wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// IORING_OP_READ came in the same kernel as the probe so a ring that can't
+// be probed can't read either and every read would fail with EINVAL.
+static bool
+uring_can_read(int ring) {
+    uint64_t			mem[(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)) / sizeof(uint64_t)];
+    struct io_uring_probe	*probe = (struct io_uring_probe*)mem;
+
+    memset(mem, 0, sizeof(mem));
+    if (0 != syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, 256)) {
+	return false;
+    }
+    return IORING_OP_READ <= probe->last_op && 0 != (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+}
+
+static bool
+uring_setup(ojReader r) {
+    struct io_uring_params	params;
+    byte			*sq;
+    byte			*cq;
+
+    memset(&params, 0, sizeof(params));
+    if ((r->ring = (int)syscall(__NR_io_uring_setup, READ_BLOCK_CNT, &params)) < 0) {
+	return false;
+    }
+    if (!uring_can_read(r->ring)) {
+	close(r->ring);
+	return false;
+    }
+    r->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (0 != (params.features & IORING_FEAT_SINGLE_MMAP) && r->sq_len < r->cq_len) {
+	r->sq_len = r->cq_len;
+    }
+    r->sq_map = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == r->sq_map) {
+	close(r->ring);
+	return false;
+    }
+    if (0 != (params.features & IORING_FEAT_SINGLE_MMAP)) {
+	r->cq_map = r->sq_map;
+    } else {
+	r->cq_map = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_CQ_RING);
+	if (MAP_FAILED == r->cq_map) {
+	    munmap(r->sq_map, r->sq_len);
+	    close(r->ring);
+	    return false;
+	}
+    }
+    r->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_SQES);
+    if (MAP_FAILED == r->sqes) {
+	if (r->cq_map != r->sq_map) {
+	    munmap(r->cq_map, r->cq_len);
+	}
+	munmap(r->sq_map, r->sq_len);
+	close(r->ring);
+	return false;
+    }
+    sq = (byte*)r->sq_map;
+    cq = (byte*)r->cq_map;
+    r->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + params.sq_off.array);
+    r->cq_head = (unsigned*)(cq + params.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+static void
+uring_submit(ojReader r, Block b, off_t off) {
+    unsigned		tail = *r->sq_tail;
+    unsigned		i = tail & *r->sq_mask;
+    struct io_uring_sqe	*sqe = r->sqes + i;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->fd;
+    sqe->off = (uint64_t)off;
+    sqe->addr = (uint64_t)(uintptr_t)b->buf;
+    sqe->len = READ_BLOCK_SIZE;
+    sqe->user_data = (uint64_t)(b - r->blocks);
+    r->sq_array[i] = i;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    b->off = off;
+    b->pending = true;
+    uring_enter(r->ring, 1, 0);
+}
+
+// Takes all the completions available and waits for one if there are none
+// and wait is true.
+static void
+uring_reap(ojReader r, bool wait) {
+    unsigned	head = *r->cq_head;
+    unsigned	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail && wait) {
+	uring_enter(r->ring, 0, 1);
+	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    for (; head != tail; head++) {
+	struct io_uring_cqe	*cqe = r->cqes + (head & *r->cq_mask);
+	Block			b = r->blocks + cqe->user_data;
+
+	b->len = cqe->res;
+	b->pending = false;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static Block
+uring_next(ojReader r) {
+    Block	b;
+
+    if (0 < r->next) {
+	off_t	off;
+
+	// The block the parser just finished is used for the read after all
+	// the others in flight.
+	b = r->blocks + (r->next - 1) % READ_BLOCK_CNT;
+	off = b->off + (off_t)READ_BLOCK_SIZE * READ_BLOCK_CNT;
+	if (off < r->end) {
+	    uring_submit(r, b, off);
+	} else {
+	    b->off = off;
+	}
+    }
+    b = r->blocks + r->next % READ_BLOCK_CNT;
+    if (r->end <= b->off) {
+	b->len = 0;
+	return b;
+    }
+    while (true) {
+	while (b->pending) {
+	    uring_reap(r, true);
+	}
+	if (-EAGAIN == b->len || -EINTR == b->len) {
+	    uring_submit(r, b, b->off);
+	    continue;
+	}
+	break;
+    }
+    if (0 < b->len && b->len < READ_BLOCK_SIZE && b->off + b->len < r->end) {
+	// A short read in the middle of the file. The rest is read directly
+	// since the next block starts after it.
+	ssize_t	cnt;
+
+	while (b->len < READ_BLOCK_SIZE && b->off + b->len < r->end) {
+	    if ((cnt = pread(r->fd, b->buf + b->len, READ_BLOCK_SIZE - b->len, b->off + b->len)) < 0) {
+		if (EINTR == errno) {
+		    continue;
+		}
+		b->len = -errno;
+		break;
+	    }
+	    if (0 == cnt) {
+		break;
+	    }
+	    b->len += cnt;
+	}
+    }
+    if (0 < b->len) {
+	b->buf[b->len] = '\0';
+    }
+    return b;
+}
+
+static void
+uring_close(ojReader r) {
+    for (Block b = r->blocks; b < r->blocks + READ_BLOCK_CNT; b++) {
+	while (b->pending) {
+	    uring_reap(r, true);
+	}
+    }
+    munmap(r->sqes, r->sqes_len);
+    if (r->cq_map != r->sq_map) {
+	munmap(r->cq_map, r->cq_len);
+    }
+    munmap(r->sq_map, r->sq_len);
+    close(r->ring);
+}
+
+ojReader
+_oj_reader_start(ojErr err, int fd, bool uring) {
+    ojReader	r = (ojReader)OJ_CALLOC(1, sizeof(struct _ojReader));
+    struct stat	info;
+    off_t	pos;
+
+    if (NULL == r) {
+	OJ_ERR_MEM(err, "reader");
+	return NULL;
+    }
+    r->fd = fd;
+    if (NULL == (r->mem = (byte*)OJ_MALLOC((READ_BLOCK_SIZE + 1) * READ_BLOCK_CNT))) {
+	OJ_ERR_MEM(err, "reader");
+	OJ_FREE(r);
+	return NULL;
+    }
+    for (int i = 0; i < READ_BLOCK_CNT; i++) {
+	r->blocks[i].buf = r->mem + (READ_BLOCK_SIZE + 1) * i;
+    }
+    // Reads in flight need offsets so io_uring is only used on regular
+    // files. Anything else is read by a thread.
+    if (uring && 0 == fstat(fd, &info) && S_ISREG(info.st_mode) &&
+	0 <= (pos = lseek(fd, 0, SEEK_CUR)) && uring_setup(r)) {
+	r->uring = true;
+	r->end = info.st_size;
+	for (int i = 0; i < READ_BLOCK_CNT; i++) {
+	    off_t	off = pos + (off_t)READ_BLOCK_SIZE * i;
+
+	    if (r->end <= off) {
+		r->blocks[i].off = off;
+		continue;
+	    }
+	    uring_submit(r, r->blocks + i, off);
+	}
+	return r;
+    }
+    atomic_init(&r->filled, 0);
+    atomic_init(&r->released, 0);
+    atomic_init(&r->stop, false);
+    if (0 != pthread_create(&r->thread, NULL, read_loop, r)) {
+	oj_err_no(err, "failed to create reader thread");
+	OJ_FREE(r->mem);
+	OJ_FREE(r);
+	return NULL;
+    }
+    return r;
+}
+
+const byte*
+_oj_reader_next(ojErr err, ojReader r, size_t *lenp) {
+    Block	b = r->uring ? uring_next(r) : thread_next(r);
+
+    r->next++;
+    if (b->len < 0) {
+	errno = (int)-b->len;
+	oj_err_no(err, "read failed");
+	return NULL;
+    }
+    if (0 == b->len) {
+	return NULL;
+    }
+    *lenp = (size_t)b->len;
+
+    return b->buf;
+}
+
+void
+_oj_reader_stop(ojReader r) {
+    if (r->uring) {
+	Block	b = r->blocks + (r->next - 1 + READ_BLOCK_CNT) % READ_BLOCK_CNT;
+
+	uring_close(r);
+	// Leave the fd just past what was read as a plain read would.
+	if (0 < r->next && 0 < b->len) {
+	    lseek(r->fd, b->off + b->len, SEEK_SET);
+	} else {
+	    lseek(r->fd, r->end, SEEK_SET);
+	}
+    } else {
+	atomic_store(&r->stop, true);
+	_oj_wake(&r->park);
+	// The thread may be blocked on a read that will never complete such
+	// as on a pipe no one is writing to.
+	pthread_cancel(r->thread);
+	pthread_join(r->thread, NULL);
+    }
+    OJ_FREE(r->mem);
+    OJ_FREE(r);
+}
@@ -0,0 +1,616 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OJ_X86	1
+#endif
+
+#include "oj.h"
+#include "intern.h"
+
+// Vector loads are only made when they can not cross into the next page so
+// reading past the '\0' terminator of a string never faults. Address
+// sanitizers don't know that so they are told to look the other way.
+#define PAGE_SIZE	4096
+
+#if defined(__SANITIZE_ADDRESS__)
+#define NO_ASAN		__attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define NO_ASAN		__attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef NO_ASAN
+#define NO_ASAN
+#endif
+
+static const byte*	scan_str_scalar(const byte *b);
+static const byte*	skip_space_scalar(const byte *b, int *lines, const byte **nl);
+static void		classify_scalar(const byte *b, ojMasks m);
+
+static ojSimd		simd_max = OJ_SIMD_NONE;
+static ojSimd		simd = OJ_SIMD_NONE;
+
+const byte*		(*_oj_scan_str)(const byte *b) = scan_str_scalar;
+const byte*		(*_oj_skip_space)(const byte *b, int *lines, const byte **nl) = skip_space_scalar;
+void			(*_oj_classify)(const byte *b, ojMasks m) = classify_scalar;
+
+// Byte classes for the scalar classifier. q - quote, \\ - backslash, s - space,
+// o - {}[]:,
+static const char	class_map[257] = "\
+.........ss..s..................\
+s.q.........o.............o.....\
+...........................o\\o..\
+...........................o.o..\
+................................\
+................................\
+................................\
+................................c";
+
+// A plain string byte is anything from 0x20 to 0x7f except '"' and '\\'.
+static inline bool
+plain_byte(byte b) {
+    return (byte)(b - 0x20) < 0x60 && '"' != b && '\\' != b;
+}
+
+static inline bool
+space_byte(byte b) {
+    return ' ' == b || '\n' == b || '\t' == b || '\r' == b;
+}
+
+static inline const byte*
+page_end(const byte *b) {
+    return b + (PAGE_SIZE - ((uintptr_t)b & (PAGE_SIZE - 1)));
+}
+
+// Returns the byte after the multibyte UTF-8 character at b or b if it is
+// not a valid one. Overlong forms, surrogates, and code points past
+// U+10FFFF are not valid. A follow byte is only read if the byte before it
+// was a follow byte or lead so the '\0' terminator is never passed.
+static inline const byte*
+utf8_char(const byte *b) {
+    byte	c = *b;
+    byte	lo;
+    byte	hi;
+
+    if (c < 0xC2) {
+	return b;
+    }
+    if (c < 0xE0) {
+	return (0x80 == (0xC0 & b[1])) ? b + 2 : b;
+    }
+    // The range of the second byte depends only on the lead so the checks
+    // branch the same way for any text in one script.
+    if (c < 0xF0) {
+	lo = (0xE0 == c) ? 0xA0 : 0x80;
+	hi = (0xED == c) ? 0x9F : 0xBF;
+	if (b[1] < lo || hi < b[1] || 0x80 != (0xC0 & b[2])) {
+	    return b;
+	}
+	return b + 3;
+    }
+    if (c < 0xF5) {
+	lo = (0xF0 == c) ? 0x90 : 0x80;
+	hi = (0xF4 == c) ? 0x8F : 0xBF;
+	if (b[1] < lo || hi < b[1] || 0x80 != (0xC0 & b[2]) || 0x80 != (0xC0 & b[3])) {
+	    return b;
+	}
+	return b + 4;
+    }
+    return b;
+}
+
+// Valid multibyte characters are passed over. Anything else that is not a
+// plain byte, including the start of an invalid or incomplete character, is
+// left for the caller.
+static const byte*
+scan_str_scalar(const byte *b) {
+    const byte	*next;
+
+    while (true) {
+	if (plain_byte(*b)) {
+	    b++;
+	} else if (*b < 0x80 || (next = utf8_char(b)) == b) {
+	    return b;
+	} else {
+	    b = next;
+	}
+    }
+}
+
+// Backs up from b to the lead byte of a character that b might be in the
+// middle of without going before start.
+static inline const byte*
+char_start(const byte *start, const byte *b) {
+    for (int i = 0; i < 3 && start < b && 0x80 == (0xC0 & b[-1]); i++) {
+	b--;
+    }
+    if (start < b && 0xC0 <= b[-1]) {
+	b--;
+    }
+    return b;
+}
+
+static const byte*
+skip_space_scalar(const byte *b, int *lines, const byte **nl) {
+    for (; space_byte(*b); b++) {
+	if ('\n' == *b) {
+	    (*lines)++;
+	    *nl = b;
+	}
+    }
+    return b;
+}
+
+static void
+classify_scalar(const byte *b, ojMasks m) {
+    uint64_t	bit = 1;
+
+    m->quote = 0;
+    m->slash = 0;
+    m->space = 0;
+    m->op = 0;
+    for (const byte *end = b + 64; b < end; b++, bit <<= 1) {
+	switch (class_map[*b]) {
+	case 'q':
+	    m->quote |= bit;
+	    break;
+	case '\\':
+	    m->slash |= bit;
+	    break;
+	case 's':
+	    m->space |= bit;
+	    break;
+	case 'o':
+	    m->op |= bit;
+	    break;
+	}
+    }
+}
+
+#ifdef OJ_X86
+
+// Comparing as signed bytes against 0x20 picks up both the control
+// characters and, since they are negative, all the non-ASCII bytes. The '\0'
+// terminator is a control character so it stops the scan as well. Without a
+// byte shuffle there is no table lookup so multibyte characters are checked
+// one at a time.
+NO_ASAN static const byte*
+scan_str_sse2(const byte *b) {
+    const __m128i	quote = _mm_set1_epi8('"');
+    const __m128i	slash = _mm_set1_epi8('\\');
+    const __m128i	space = _mm_set1_epi8(0x20);
+    const byte		*next;
+    __m128i		v;
+    int			mask;
+
+    while (true) {
+	if (((uintptr_t)b & (PAGE_SIZE - 1)) <= PAGE_SIZE - 16) {
+	    v = _mm_loadu_si128((const __m128i*)b);
+	    mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+							       _mm_cmpeq_epi8(v, slash)),
+						  _mm_cmplt_epi8(v, space)));
+	    if (0 != mask) {
+		b += __builtin_ctz(mask);
+		if (*b < 0x80) {
+		    return b;
+		}
+		// Non-ASCII text tends to come in runs so the whole run is
+		// passed over before going back to the vector.
+		do {
+		    if ((next = utf8_char(b)) == b) {
+			return b;
+		    }
+		    b = next;
+		} while (0x80 <= *b);
+		continue;
+	    }
+	    b += 16;
+	    continue;
+	}
+	for (const byte *end = page_end(b); b < end; ) {
+	    if (plain_byte(*b)) {
+		b++;
+	    } else if (*b < 0x80 || (next = utf8_char(b)) == b) {
+		return b;
+	    } else {
+		b = next;
+	    }
+	}
+    }
+}
+
+// UTF-8 is checked 32 bytes at a time with the lookup tables of Keiser and
+// Lemire. The high nibble of each byte, and the high and low nibbles of the
+// byte before it, each pick a set of error bits that are and-ed together
+// so any bit left over is an error. Follow bytes two and three after a lead
+// are checked separately. The bits are from "Validating UTF-8 In Less Than
+// One Instruction Per Byte".
+#define TOO_SHORT	(1 << 0)
+#define TOO_LONG	(1 << 1)
+#define OVERLONG_3	(1 << 2)
+#define TOO_LARGE	(1 << 3)
+#define SURROGATE	(1 << 4)
+#define OVERLONG_2	(1 << 5)
+#define TOO_LARGE_1000	(1 << 6)
+#define OVERLONG_4	(1 << 6)
+#define TWO_CONTS	(1 << 7)
+#define CARRY		(TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+static const uint8_t	byte_1_high_tab[16] = {
+    // ASCII
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    // follow byte
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    // two byte lead
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    // three byte lead
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    // four byte lead
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+static const uint8_t	byte_1_low_tab[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+static const uint8_t	byte_2_high_tab[16] = {
+    // ASCII
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    // follow bytes 0x80-0x8F, 0x90-0x9F, and 0xA0-0xBF
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    // leads
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+
+// Each table is looked up in both 128 bit lanes.
+__attribute__((target("avx2")))
+static inline __m256i
+lookup16(const uint8_t *tab, __m256i index) {
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tab)), index);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+utf8_errors(__m256i v, __m256i prev) {
+    const __m256i	nibble = _mm256_set1_epi8(0x0F);
+    // The bytes before each byte of v, 1, 2, and 3 back, with prev before v.
+    __m256i		carry = _mm256_permute2x128_si256(prev, v, 0x21);
+    __m256i		prev1 = _mm256_alignr_epi8(v, carry, 15);
+    __m256i		prev2 = _mm256_alignr_epi8(v, carry, 14);
+    __m256i		prev3 = _mm256_alignr_epi8(v, carry, 13);
+    __m256i		special;
+    __m256i		must23;
+
+    special = _mm256_and_si256(_mm256_and_si256(lookup16(byte_1_high_tab, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+						lookup16(byte_1_low_tab, _mm256_and_si256(prev1, nibble))),
+			       lookup16(byte_2_high_tab, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+    // The high bit is set where a byte must be the second or third follow
+    // byte, after a three or four byte lead.
+    must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+			     _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+
+    return _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char)0x80)), special);
+}
+
+// Blocks with no non-ASCII bytes skip the UTF-8 check unless the block
+// before ended with an incomplete character. When the check finds an error
+// at or before the end of the string the scan backs up to the start of the
+// character the block started in and finishes one character at a time so it
+// stops on the same byte with or without the vector check. The last partial
+// page is also checked one character at a time.
+__attribute__((target("avx2")))
+NO_ASAN static const byte*
+scan_str_avx2(const byte *b) {
+    const __m256i	quote = _mm256_set1_epi8('"');
+    const __m256i	slash = _mm256_set1_epi8('\\');
+    const __m256i	space = _mm256_set1_epi8(0x20);
+    // Any byte over these in the last three places starts a character that
+    // does not fit in the block.
+    const __m256i	tail = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+						-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+						(char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const byte		*start = b;
+    const byte		*next;
+    __m256i		prev = _mm256_setzero_si256();
+    __m256i		v;
+    uint32_t		mask;
+    uint32_t		high;
+    uint32_t		err;
+    bool		partial = false;
+
+    while (true) {
+	if (((uintptr_t)b & (PAGE_SIZE - 1)) <= PAGE_SIZE - 32) {
+	    v = _mm256_loadu_si256((const __m256i*)b);
+	    // Control characters are below the space and not negative.
+	    mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+										  _mm256_cmpeq_epi8(v, slash)),
+								  _mm256_andnot_si256(v, _mm256_cmpgt_epi8(space, v))));
+	    high = (uint32_t)_mm256_movemask_epi8(v);
+	    if (0 != high || partial) {
+		err = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(utf8_errors(v, prev), _mm256_setzero_si256()));
+		if (0 != mask) {
+		    err &= (uint32_t)(((uint64_t)2 << __builtin_ctz(mask)) - 1);
+		}
+		if (0 != err) {
+		    return scan_str_scalar(char_start(start, b));
+		}
+		partial = !_mm256_testz_si256(_mm256_subs_epu8(v, tail), _mm256_subs_epu8(v, tail));
+	    } else {
+		partial = false;
+	    }
+	    if (0 != mask) {
+		return b + __builtin_ctz(mask);
+	    }
+	    prev = v;
+	    b += 32;
+	    continue;
+	}
+	b = char_start(start, b);
+	for (const byte *end = page_end(b); b < end; ) {
+	    if (plain_byte(*b)) {
+		b++;
+	    } else if (*b < 0x80 || (next = utf8_char(b)) == b) {
+		return b;
+	    } else {
+		b = next;
+	    }
+	}
+	prev = _mm256_setzero_si256();
+	partial = false;
+	start = b;
+    }
+}
+
+// Minified JSON rarely has more than one whitespace byte in a row so the
+// first byte is checked before paying for a vector load. The newlines before
+// the first non-space byte are counted with a popcount and the last one is
+// found from the highest bit.
+NO_ASAN static const byte*
+skip_space_sse2(const byte *b, int *lines, const byte **nl) {
+    const __m128i	sp = _mm_set1_epi8(' ');
+    const __m128i	tab = _mm_set1_epi8('\t');
+    const __m128i	cr = _mm_set1_epi8('\r');
+    const __m128i	lf = _mm_set1_epi8('\n');
+    __m128i		v;
+    __m128i		nlv;
+    uint32_t		space;
+    uint32_t		nls;
+
+    if (!space_byte(*b)) {
+	return b;
+    }
+    while (true) {
+	if (((uintptr_t)b & (PAGE_SIZE - 1)) <= PAGE_SIZE - 16) {
+	    v = _mm_loadu_si128((const __m128i*)b);
+	    nlv = _mm_cmpeq_epi8(v, lf);
+	    nls = (uint32_t)_mm_movemask_epi8(nlv);
+	    space = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), nlv),
+							     _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr))));
+	    if (0xFFFF != space) {
+		int	cnt = __builtin_ctz(~space);
+
+		nls &= (1U << cnt) - 1;
+		if (0 != nls) {
+		    *lines += __builtin_popcount(nls);
+		    *nl = b + 31 - __builtin_clz(nls);
+		}
+		return b + cnt;
+	    }
+	    if (0 != nls) {
+		*lines += __builtin_popcount(nls);
+		*nl = b + 31 - __builtin_clz(nls);
+	    }
+	    b += 16;
+	    continue;
+	}
+	for (const byte *end = page_end(b); b < end; b++) {
+	    if (!space_byte(*b)) {
+		return b;
+	    }
+	    if ('\n' == *b) {
+		(*lines)++;
+		*nl = b;
+	    }
+	}
+    }
+}
+
+__attribute__((target("avx2,popcnt")))
+NO_ASAN static const byte*
+skip_space_avx2(const byte *b, int *lines, const byte **nl) {
+    const __m256i	sp = _mm256_set1_epi8(' ');
+    const __m256i	tab = _mm256_set1_epi8('\t');
+    const __m256i	cr = _mm256_set1_epi8('\r');
+    const __m256i	lf = _mm256_set1_epi8('\n');
+    __m256i		v;
+    __m256i		nlv;
+    uint32_t		space;
+    uint32_t		nls;
+
+    if (!space_byte(*b)) {
+	return b;
+    }
+    while (true) {
+	if (((uintptr_t)b & (PAGE_SIZE - 1)) <= PAGE_SIZE - 32) {
+	    v = _mm256_loadu_si256((const __m256i*)b);
+	    nlv = _mm256_cmpeq_epi8(v, lf);
+	    nls = (uint32_t)_mm256_movemask_epi8(nlv);
+	    space = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), nlv),
+								   _mm256_or_si256(_mm256_cmpeq_epi8(v, tab),
+										   _mm256_cmpeq_epi8(v, cr))));
+	    if (0xFFFFFFFF != space) {
+		int	cnt = __builtin_ctz(~space);
+
+		nls &= (1U << cnt) - 1;
+		if (0 != nls) {
+		    *lines += __builtin_popcount(nls);
+		    *nl = b + 31 - __builtin_clz(nls);
+		}
+		return b + cnt;
+	    }
+	    if (0 != nls) {
+		*lines += __builtin_popcount(nls);
+		*nl = b + 31 - __builtin_clz(nls);
+	    }
+	    b += 32;
+	    continue;
+	}
+	for (const byte *end = page_end(b); b < end; b++) {
+	    if (!space_byte(*b)) {
+		return b;
+	    }
+	    if ('\n' == *b) {
+		(*lines)++;
+		*nl = b;
+	    }
+	}
+    }
+}
+
+// Or-ing in 0x20 folds '[' onto '{' and ']' onto '}' so four compares find
+// all six structural characters.
+static void
+classify_sse2(const byte *b, ojMasks m) {
+    const __m128i	quote = _mm_set1_epi8('"');
+    const __m128i	slash = _mm_set1_epi8('\\');
+    const __m128i	sp = _mm_set1_epi8(' ');
+    const __m128i	tab = _mm_set1_epi8('\t');
+    const __m128i	cr = _mm_set1_epi8('\r');
+    const __m128i	lf = _mm_set1_epi8('\n');
+    const __m128i	fold = _mm_set1_epi8(0x20);
+    const __m128i	open = _mm_set1_epi8('{');
+    const __m128i	close = _mm_set1_epi8('}');
+    const __m128i	comma = _mm_set1_epi8(',');
+    const __m128i	colon = _mm_set1_epi8(':');
+    __m128i		v;
+    __m128i		f;
+
+    m->quote = 0;
+    m->slash = 0;
+    m->space = 0;
+    m->op = 0;
+    for (int shift = 0; shift < 64; shift += 16, b += 16) {
+	v = _mm_loadu_si128((const __m128i*)b);
+	f = _mm_or_si128(v, fold);
+	m->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << shift;
+	m->slash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, slash)) << shift;
+	m->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp),
+										     _mm_cmpeq_epi8(v, lf)),
+									_mm_or_si128(_mm_cmpeq_epi8(v, tab),
+										     _mm_cmpeq_epi8(v, cr)))) << shift;
+	m->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(f, open),
+										  _mm_cmpeq_epi8(f, close)),
+								     _mm_or_si128(_mm_cmpeq_epi8(v, comma),
+										  _mm_cmpeq_epi8(v, colon)))) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static void
+classify_avx2(const byte *b, ojMasks m) {
+    const __m256i	quote = _mm256_set1_epi8('"');
+    const __m256i	slash = _mm256_set1_epi8('\\');
+    const __m256i	sp = _mm256_set1_epi8(' ');
+    const __m256i	tab = _mm256_set1_epi8('\t');
+    const __m256i	cr = _mm256_set1_epi8('\r');
+    const __m256i	lf = _mm256_set1_epi8('\n');
+    const __m256i	fold = _mm256_set1_epi8(0x20);
+    const __m256i	open = _mm256_set1_epi8('{');
+    const __m256i	close = _mm256_set1_epi8('}');
+    const __m256i	comma = _mm256_set1_epi8(',');
+    const __m256i	colon = _mm256_set1_epi8(':');
+    __m256i		v;
+    __m256i		f;
+
+    m->quote = 0;
+    m->slash = 0;
+    m->space = 0;
+    m->op = 0;
+    for (int shift = 0; shift < 64; shift += 32, b += 32) {
+	v = _mm256_loadu_si256((const __m256i*)b);
+	f = _mm256_or_si256(v, fold);
+	m->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << shift;
+	m->slash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, slash)) << shift;
+	m->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+											      _mm256_cmpeq_epi8(v, lf)),
+									     _mm256_or_si256(_mm256_cmpeq_epi8(v, tab),
+											      _mm256_cmpeq_epi8(v, cr)))) << shift;
+	m->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(f, open),
+											   _mm256_cmpeq_epi8(f, close)),
+									  _mm256_or_si256(_mm256_cmpeq_epi8(v, comma),
+											   _mm256_cmpeq_epi8(v, colon)))) << shift;
+    }
+}
+
+#endif
+
+ojSimd
+oj_simd_get() {
+    return simd;
+}
+
+void
+oj_simd_set(ojSimd level) {
+    if (simd_max < level) {
+	level = simd_max;
+    }
+    switch (level) {
+#ifdef OJ_X86
+    case OJ_SIMD_AVX2:
+	_oj_scan_str = scan_str_avx2;
+	_oj_skip_space = skip_space_avx2;
+	_oj_classify = classify_avx2;
+	break;
+    case OJ_SIMD_SSE:
+	_oj_scan_str = scan_str_sse2;
+	_oj_skip_space = skip_space_sse2;
+	_oj_classify = classify_sse2;
+	break;
+#endif
+    default:
+	level = OJ_SIMD_NONE;
+	_oj_scan_str = scan_str_scalar;
+	_oj_skip_space = skip_space_scalar;
+	_oj_classify = classify_scalar;
+	break;
+    }
+    simd = level;
+}
+
+// Pick the best kernels the CPU supports before any parsing starts.
+__attribute__((constructor))
+static void
+scan_init() {
+#ifdef OJ_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	simd_max = OJ_SIMD_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+	simd_max = OJ_SIMD_SSE;
+    }
+#endif
+    oj_simd_set(simd_max);
+}
@@ -15,6 +15,7 @@
 #include "intern.h"
 
 bool oj_thread_safe = false;
+bool oj_intern_keys = false;
 
 static ojVal		volatile free_head = NULL;
 static ojVal		volatile free_tail = NULL;
@@ -24,6 +25,32 @@ static ojS4k		volatile s4k_head = NULL;
 static ojS4k		volatile s4k_tail = NULL;
 static atomic_flag	s4k_busy = ATOMIC_FLAG_INIT;
 
+// Parallel parsers, caller pools, and ingest engines that are running.
+static atomic_int	thread_users = 0;
+
+// Interned keys are kept in an open addressed table that is looked up
+// without a lock. Adding a key takes the lock. A full table is replaced by
+// one twice the size but the old one is kept until oj_cleanup() since a
+// lookup may still be reading it.
+#define INTERN_MAX	64
+#define INTERN_MIN_CAP	1024
+
+typedef struct _Intern {
+    uint32_t	hash;
+    int		len;
+    char	str[];
+} *Intern;
+
+typedef struct _InternTable {
+    struct _InternTable	*prev;
+    uint32_t		mask;
+    uint32_t		cnt;
+    _Atomic(Intern)	slots[];
+} *InternTable;
+
+static _Atomic(InternTable)	intern_table = NULL;
+static atomic_flag		intern_busy = ATOMIC_FLAG_INIT;
+
 static uint32_t
 calc_hash(const char *key, size_t len) {
     uint32_t	h = 0;
@@ -37,6 +64,135 @@ calc_hash(const char *key, size_t len) {
     return h;
 }
 
+//// key interning
+
+// The hash is also the key hash used by objects in hash mode so it is
+// spread out before picking a slot.
+static inline uint32_t
+intern_slot(uint32_t hash) {
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6D;
+    hash ^= hash >> 12;
+
+    return hash;
+}
+
+static Intern
+intern_find(InternTable t, const char *key, int len, uint32_t hash) {
+    Intern	in;
+
+    for (uint32_t i = intern_slot(hash) & t->mask; ; i = (i + 1) & t->mask) {
+	if (NULL == (in = atomic_load_explicit(&t->slots[i], memory_order_acquire))) {
+	    return NULL;
+	}
+	if (hash == in->hash && len == in->len && 0 == memcmp(key, in->str, len)) {
+	    return in;
+	}
+    }
+}
+
+static void
+intern_put(InternTable t, Intern in) {
+    uint32_t	i = intern_slot(in->hash) & t->mask;
+
+    for (; NULL != atomic_load_explicit(&t->slots[i], memory_order_relaxed); i = (i + 1) & t->mask) {
+    }
+    atomic_store_explicit(&t->slots[i], in, memory_order_release);
+    t->cnt++;
+}
+
+static InternTable
+intern_table_create(uint32_t cap, InternTable prev) {
+    InternTable	t = (InternTable)OJ_CALLOC(1, sizeof(struct _InternTable) + cap * sizeof(Intern));
+
+    if (NULL != t) {
+	t->prev = prev;
+	t->mask = cap - 1;
+	if (NULL != prev) {
+	    for (uint32_t i = 0; i <= prev->mask; i++) {
+		Intern	in = atomic_load_explicit(&prev->slots[i], memory_order_relaxed);
+
+		if (NULL != in) {
+		    intern_put(t, in);
+		}
+	    }
+	}
+    }
+    return t;
+}
+
+// Returns the interned copy of the key, adding it if needed, or NULL if
+// out of memory.
+static Intern
+intern(const char *key, int len, uint32_t hash) {
+    InternTable	t = atomic_load_explicit(&intern_table, memory_order_acquire);
+    Intern	in;
+
+    if (NULL != t && NULL != (in = intern_find(t, key, len, hash))) {
+	return in;
+    }
+    while (atomic_flag_test_and_set(&intern_busy)) {
+    }
+    // Another thread may have added it or replaced the table.
+    t = atomic_load_explicit(&intern_table, memory_order_relaxed);
+    if (NULL != t && NULL != (in = intern_find(t, key, len, hash))) {
+	atomic_flag_clear(&intern_busy);
+	return in;
+    }
+    if (NULL == t || t->mask < t->cnt * 2) {
+	InternTable	nt = intern_table_create((NULL == t) ? INTERN_MIN_CAP : (t->mask + 1) * 2, t);
+
+	if (NULL == nt) {
+	    atomic_flag_clear(&intern_busy);
+	    return NULL;
+	}
+	atomic_store_explicit(&intern_table, nt, memory_order_release);
+	t = nt;
+    }
+    if (NULL != (in = (Intern)OJ_MALLOC(sizeof(struct _Intern) + len + 1))) {
+	in->hash = hash;
+	in->len = len;
+	memcpy(in->str, key, len);
+	in->str[len] = '\0';
+	intern_put(t, in);
+    }
+    atomic_flag_clear(&intern_busy);
+
+    return in;
+}
+
+static void
+intern_cleanup() {
+    InternTable	t = atomic_exchange(&intern_table, NULL);
+    InternTable	prev;
+
+    if (NULL != t) {
+	for (uint32_t i = 0; i <= t->mask; i++) {
+	    OJ_FREE(atomic_load_explicit(&t->slots[i], memory_order_relaxed));
+	}
+    }
+    for (; NULL != t; t = prev) {
+	prev = t->prev;
+	OJ_FREE(t);
+    }
+}
+
+void
+_oj_threads_begin() {
+    atomic_fetch_add(&thread_users, 1);
+}
+
+void
+_oj_threads_end() {
+    atomic_fetch_sub(&thread_users, 1);
+}
+
+// Read once by each function so a lock taken is always released.
+static inline bool
+thread_safe() {
+    return oj_thread_safe || 0 < atomic_load_explicit(&thread_users, memory_order_relaxed);
+}
+
 ojVal
 oj_val_create() {
     // Carelessly check to see if a new val is needed. It doesn't matter if we
@@ -44,7 +200,7 @@ oj_val_create() {
     if (NULL == free_head) {
 	return (ojVal)OJ_CALLOC(1, sizeof(struct _ojVal));
     }
-    if (!oj_thread_safe) {
+    if (!thread_safe()) {
 	ojVal	val = free_head;
 
 	free_head = free_head->free;
@@ -69,6 +225,7 @@ oj_val_create() {
 ojS4k
 s4k_create() {
     union _ojS4k	*s = NULL;
+    bool		safe = thread_safe();
 
     // Carelessly check to see if a new val is needed. It doesn't matter if we
     // get it wrong here.
@@ -77,7 +234,7 @@ s4k_create() {
     } else {
 	// Looks like we need to lock it down for a moment using the atomic busy
 	// flag.
-	if (oj_thread_safe) {
+	if (safe) {
 	    while (atomic_flag_test_and_set(&s4k_busy)) {
 	    }
 	}
@@ -85,15 +242,42 @@ s4k_create() {
 	    s = (ojS4k)OJ_CALLOC(1, sizeof(union _ojS4k));
 	} else {
 	    s = s4k_head;
-	    s4k_head = s4k_head->next;
+	    if (NULL == (s4k_head = s4k_head->next)) {
+		s4k_tail = NULL;
+	    }
 	}
-	if (oj_thread_safe) {
+	if (safe) {
 	    atomic_flag_clear(&s4k_busy);
 	}
     }
     return s;
 }
 
+// Puts a chain of s4k blocks back on the shared list. The list is taken from
+// by s4k_create() under the same lock so a block being handed out can't be
+// appended to.
+static void
+s4k_free(ojS4k h, ojS4k t) {
+    bool	safe = thread_safe();
+
+    if (NULL == h) {
+	return;
+    }
+    if (safe) {
+	while (atomic_flag_test_and_set(&s4k_busy)) {
+	}
+    }
+    if (NULL == s4k_head) {
+	s4k_head = h;
+    } else {
+	s4k_tail->next = h;
+    }
+    s4k_tail = t;
+    if (safe) {
+	atomic_flag_clear(&s4k_busy);
+    }
+}
+
 void
 oj_cleanup() {
     ojS4k	s4k;
@@ -110,6 +294,7 @@ oj_cleanup() {
 	OJ_FREE(val);
     }
     free_tail = NULL;
+    intern_cleanup();
 }
 
 static void
@@ -117,9 +302,11 @@ clear_key(ojVal v) {
     ojS4k	s4k_h = NULL;
     ojS4k	s4k_t = NULL;
 
-    if (sizeof(union _ojS4k) < v->key.len) {
+    if (v->key.borrow) {
+	v->key.borrow = false;
+    } else if (sizeof(union _ojS4k) <= v->key.len) {
 	OJ_FREE(v->key.ptr);
-    } else if (sizeof(v->key.raw) < v->key.len) {
+    } else if (sizeof(v->key.raw) <= v->key.len) {
 	v->key.s4k->next = NULL;
 	if (NULL == s4k_h) {
 	    s4k_h = v->key.s4k;
@@ -129,28 +316,7 @@ clear_key(ojVal v) {
 	s4k_t = v->key.s4k;
     }
     v->key.len = 0;
-    if (oj_thread_safe) {
-	while (atomic_flag_test_and_set(&val_busy)) {
-	}
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
-	atomic_flag_clear(&val_busy);
-    } else {
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
-    }
+    s4k_free(s4k_h, s4k_t);
 }
 
 static void
@@ -160,9 +326,11 @@ clear_value(ojVal v) {
 
     switch (v->type) {
     case OJ_STRING:
-	if (sizeof(union _ojS4k) < v->str.len) {
+	if (v->str.borrow) {
+	    v->str.borrow = false;
+	} else if (sizeof(union _ojS4k) <= v->str.len) {
 	    OJ_FREE(v->str.ptr);
-	} else if (sizeof(v->str.raw) < v->str.len) {
+	} else if (sizeof(v->str.raw) <= v->str.len) {
 	    v->str.s4k->next = NULL;
 	    if (NULL == s4k_h) {
 		s4k_h = v->str.s4k;
@@ -180,28 +348,7 @@ clear_value(ojVal v) {
 	v->key.len = 0;
 	break;
     }
-    if (oj_thread_safe) {
-	while (atomic_flag_test_and_set(&val_busy)) {
-	}
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
-	atomic_flag_clear(&val_busy);
-    } else {
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
-    }
+    s4k_free(s4k_h, s4k_t);
 }
 
 // code copied from clear_key and clear_value btu separate to avoid locking
@@ -211,9 +358,11 @@ _oj_val_clear(ojVal v) {
     ojS4k	s4k_h = NULL;
     ojS4k	s4k_t = NULL;
 
-    if (sizeof(union _ojS4k) < v->key.len) {
+    if (v->key.borrow) {
+	v->key.borrow = false;
+    } else if (sizeof(union _ojS4k) <= v->key.len) {
 	OJ_FREE(v->key.ptr);
-    } else if (sizeof(v->key.raw) < v->key.len) {
+    } else if (sizeof(v->key.raw) <= v->key.len) {
 	v->key.s4k->next = NULL;
 	if (NULL == s4k_h) {
 	    s4k_h = v->key.s4k;
@@ -225,9 +374,11 @@ _oj_val_clear(ojVal v) {
     v->key.len = 0;
     switch (v->type) {
     case OJ_STRING:
-	if (sizeof(union _ojS4k) < v->str.len) {
+	if (v->str.borrow) {
+	    v->str.borrow = false;
+	} else if (sizeof(union _ojS4k) <= v->str.len) {
 	    OJ_FREE(v->str.ptr);
-	} else if (sizeof(v->str.raw) < v->str.len) {
+	} else if (sizeof(v->str.raw) <= v->str.len) {
 	    v->str.s4k->next = NULL;
 	    if (NULL == s4k_h) {
 		s4k_h = v->str.s4k;
@@ -245,32 +396,13 @@ _oj_val_clear(ojVal v) {
 	v->key.len = 0;
 	break;
     }
-    if (oj_thread_safe) {
-	while (atomic_flag_test_and_set(&val_busy)) {
-	}
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
-	atomic_flag_clear(&val_busy);
-    } else {
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
-    }
+    s4k_free(s4k_h, s4k_t);
 }
 
-void
-oj_reuse(ojReuser reuser) {
+// The dig vals are cleared and moved to the head list. Unless keep is true
+// the head list then goes back on the free list.
+static void
+reuse(ojReuser reuser, bool keep) {
     ojVal	v;
     ojVal	next;
     ojS4k	s4k_h = NULL;
@@ -278,9 +410,11 @@ oj_reuse(ojReuser reuser) {
 
     for (v = reuser->dig; NULL != v; v = next) {
 	next = v->free;
-	if (sizeof(union _ojS4k) < v->key.len) {
+	if (v->key.borrow) {
+	    v->key.borrow = false;
+	} else if (sizeof(union _ojS4k) <= v->key.len) {
 	    OJ_FREE(v->key.ptr);
-	} else if (sizeof(v->key.raw) < v->key.len) {
+	} else if (sizeof(v->key.raw) <= v->key.len) {
 	    v->key.s4k->next = NULL;
 	    if (NULL == s4k_h) {
 		s4k_h = v->key.s4k;
@@ -291,9 +425,11 @@ oj_reuse(ojReuser reuser) {
 	}
 	switch (v->type) {
 	case OJ_STRING:
-	    if (sizeof(union _ojS4k) < v->str.len) {
+	    if (v->str.borrow) {
+		v->str.borrow = false;
+	    } else if (sizeof(union _ojS4k) <= v->str.len) {
 		OJ_FREE(v->str.ptr);
-	    } else if (sizeof(v->str.raw) < v->str.len) {
+	    } else if (sizeof(v->str.raw) <= v->str.len) {
 		v->str.s4k->next = NULL;
 		if (NULL == s4k_h) {
 		    s4k_h = v->str.s4k;
@@ -315,7 +451,12 @@ oj_reuse(ojReuser reuser) {
 	    reuser->tail = v;
 	}
     }
-    if (oj_thread_safe) {
+    reuser->dig = NULL;
+    s4k_free(s4k_h, s4k_t);
+    if (keep || NULL == reuser->head) {
+	return;
+    }
+    if (thread_safe()) {
 	while (atomic_flag_test_and_set(&val_busy)) {
 	}
 	if (NULL == free_head) {
@@ -324,14 +465,6 @@ oj_reuse(ojReuser reuser) {
 	    free_tail->free = reuser->head;
 	}
 	free_tail = reuser->tail;
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
 	atomic_flag_clear(&val_busy);
     } else {
 	if (NULL == free_head) {
@@ -340,17 +473,19 @@ oj_reuse(ojReuser reuser) {
 	    free_tail->free = reuser->head;
 	}
 	free_tail = reuser->tail;
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
     }
 }
 
+void
+oj_reuse(ojReuser reuser) {
+    reuse(reuser, false);
+}
+
+void
+_oj_reuse_keep(ojReuser reuser) {
+    reuse(reuser, true);
+}
+
 void
 oj_destroy(ojVal val) {
     ojVal	tail = val;
@@ -363,9 +498,11 @@ oj_destroy(ojVal val) {
     }
     val->free = NULL;
     for (; NULL != v; v = v->free) {
-	if (sizeof(union _ojS4k) < v->key.len) {
+	if (v->key.borrow) {
+	    v->key.borrow = false;
+	} else if (sizeof(union _ojS4k) <= v->key.len) {
 	    OJ_FREE(v->key.ptr);
-	} else if (sizeof(v->key.raw) < v->key.len) {
+	} else if (sizeof(v->key.raw) <= v->key.len) {
 	    v->key.s4k->next = NULL;
 	    if (NULL == s4k_h) {
 		s4k_h = v->key.s4k;
@@ -376,9 +513,11 @@ oj_destroy(ojVal val) {
 	}
 	switch (v->type) {
 	case OJ_STRING:
-	    if (sizeof(union _ojS4k) < v->str.len) {
+	    if (v->str.borrow) {
+		v->str.borrow = false;
+	    } else if (sizeof(union _ojS4k) <= v->str.len) {
 		OJ_FREE(v->str.ptr);
-	    } else if (sizeof(v->str.raw) < v->str.len) {
+	    } else if (sizeof(v->str.raw) <= v->str.len) {
 		v->str.s4k->next = NULL;
 		if (NULL == s4k_h) {
 		    s4k_h = v->str.s4k;
@@ -429,7 +568,8 @@ oj_destroy(ojVal val) {
 	}
 	v->type = OJ_NONE;
     }
-    if (oj_thread_safe) {
+    s4k_free(s4k_h, s4k_t);
+    if (thread_safe()) {
 	while (atomic_flag_test_and_set(&val_busy)) {
 	}
 	if (NULL == free_head) {
@@ -438,14 +578,6 @@ oj_destroy(ojVal val) {
 	    free_tail->free = val;
 	}
 	free_tail = tail;
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
 	atomic_flag_clear(&val_busy);
     } else {
 	if (NULL == free_head) {
@@ -454,14 +586,6 @@ oj_destroy(ojVal val) {
 	    free_tail->free = val;
 	}
 	free_tail = tail;
-	if (NULL != s4k_h) {
-	    if (NULL == s4k_head) {
-		s4k_head = s4k_h;
-	    } else {
-		s4k_tail->next = s4k_h;
-	    }
-	    s4k_tail = s4k_t;
-	}
     }
 }
 
@@ -484,6 +608,7 @@ oj_int_set(ojVal val, int64_t fixnum) {
     clear_value(val);
     val->type = OJ_INT;
     val->num.fixnum = fixnum;
+    val->num.calc = true;
     val->num.len = 0;
 }
 
@@ -492,6 +617,7 @@ oj_double_set(ojVal val, long double dub) {
     clear_value(val);
     val->type = OJ_DECIMAL;
     val->num.dub = dub;
+    val->num.calc = true;
     val->num.len = 0;
 }
 
@@ -499,6 +625,8 @@ ojStatus
 oj_str_set(ojErr err, ojVal val, const char *s, size_t len) {
     clear_value(val);
     val->type = OJ_STRING;
+    val->str.len = len;
+    val->str.borrow = false;
     if (len < sizeof(val->str.raw)) {
 	memcpy(val->str.raw, s, len);
 	val->str.raw[len] = '\0';
@@ -682,6 +810,7 @@ oj_int_create(ojErr err, int64_t fixnum) {
     } else {
 	val->type = OJ_INT;
 	val->num.fixnum = fixnum;
+	val->num.calc = true;
 	val->num.len = 0;
     }
     return val;
@@ -696,6 +825,7 @@ oj_double_create(ojErr err, long double dub) {
     } else {
 	val->type = OJ_DECIMAL;
 	val->num.dub = dub;
+	val->num.calc = true;
 	val->num.len = 0;
     }
     return val;
@@ -751,7 +881,9 @@ oj_key(ojVal val) {
     const char	*k = NULL;
 
     if (NULL != val) {
-	if (val->key.len < sizeof(val->key.raw)) {
+	if (val->key.borrow) {
+	    k = val->key.ptr;
+	} else if (val->key.len < sizeof(val->key.raw)) {
 	    k = val->key.raw;
 	} else if (val->key.len < sizeof(union _ojS4k)) {
 	    k = val->key.s4k->str;
@@ -767,7 +899,9 @@ oj_str_get(ojVal val) {
     const char	*s = NULL;
 
     if (NULL != val && OJ_STRING == val->type) {
-	if (val->str.len < sizeof(val->str.raw)) {
+	if (val->str.borrow) {
+	    s = val->str.ptr;
+	} else if (val->str.len < sizeof(val->str.raw)) {
 	    s = val->str.raw;
 	} else if (val->str.len < sizeof(union _ojS4k)) {
 	    s = val->str.s4k->str;
@@ -783,6 +917,9 @@ oj_int_get(ojVal val) {
     int64_t	i = 0;
 
     if (NULL != val && OJ_INT == val->type) {
+	if (!val->num.calc) {
+	    _oj_calc_num(val);
+	}
 	i = val->num.fixnum;
     }
     return i;
@@ -793,6 +930,9 @@ oj_double_get(ojVal val, bool prec) {
     long double	d = 0.0;
 
     if (NULL != val && OJ_DECIMAL == val->type) {
+	if (!val->num.calc) {
+	    _oj_calc_num(val);
+	}
 	d = val->num.dub;
     }
     return d;
@@ -806,12 +946,18 @@ oj_bignum_get(ojVal val) {
 	switch (val->type) {
 	case OJ_INT:
 	    if (0 == val->num.len) {
+		if (!val->num.calc) {
+		    _oj_calc_num(val);
+		}
 		val->num.len = snprintf(val->num.raw, sizeof(val->num.raw), "%lld", (long long)val->num.fixnum);
 	    }
 	    s = val->num.raw;
 	    break;
 	case OJ_DECIMAL:
 	    if (0 == val->num.len) {
+		if (!val->num.calc) {
+		    _oj_calc_num(val);
+		}
 		val->num.len = snprintf(val->num.raw, sizeof(val->num.raw), "%Lg", val->num.dub);
 	    }
 	    s = val->num.raw;
@@ -904,10 +1050,27 @@ static ojVal
 object_get(ojVal val, const char *key, int len) {
     uint32_t	kh = calc_hash(key, len);
     ojVal	v = val->hash[kh & 0x0000000F];
+    InternTable	t;
+    const char	*ik = NULL;
+
+    // An interned member key matches only the interned copy of the key so
+    // pointers are compared instead of the keys.
+    if (oj_intern_keys && NULL != (t = atomic_load_explicit(&intern_table, memory_order_acquire))) {
+	Intern	in = intern_find(t, key, len, kh);
 
+	if (NULL != in) {
+	    ik = in->str;
+	}
+    }
     for (; NULL != v; v = v->next) {
-	if (v->kh == kh && len == v->key.len && 0 == strncmp(key, oj_key(v), len)) {
-	    break;
+	if (v->kh == kh && len == v->key.len) {
+	    if (NULL != ik && v->key.borrow && v->key.intern) {
+		if (v->key.ptr == ik) {
+		    break;
+		}
+	    } else if (0 == strncmp(key, oj_key(v), len)) {
+		break;
+	    }
 	}
     }
     return v;
@@ -926,7 +1089,9 @@ oj_object_get(ojVal val, const char *key, int len) {
 	    memset(val->hash, 0, sizeof(val->hash));
 	    for (; NULL != v; v = next) {
 		next = v->next;
-		v->kh = calc_hash(oj_key(v), v->key.len);
+		if (!v->key.borrow || !v->key.intern) {
+		    v->kh = calc_hash(oj_key(v), v->key.len);
+		}
 		u = v->kh & 0x0000000F;
 		v->next = val->hash[u];
 		val->hash[u] = v;
@@ -974,6 +1139,23 @@ _oj_val_set_key(ojVal val, const char *s, size_t len) {
 	val->key.ptr[len] = '\0';
     }
     val->key.len = len;
+    val->key.borrow = false;
+}
+
+void
+_oj_val_intern_key(ojVal val, const char *s, size_t len) {
+    uint32_t	hash;
+    Intern	in;
+
+    if (INTERN_MAX < len || NULL == (in = intern(s, (int)len, (hash = calc_hash(s, len))))) {
+	_oj_val_set_key(val, s, len);
+	return;
+    }
+    val->key.ptr = in->str;
+    val->key.len = (int)len;
+    val->key.borrow = true;
+    val->key.intern = true;
+    val->kh = hash;
 }
 
 void
@@ -994,6 +1176,7 @@ _oj_val_set_str(ojVal val, const char *s, size_t len) {
 	val->str.ptr[len] = '\0';
     }
     val->str.len = len;
+    val->str.borrow = false;
 }
 
 void
@@ -1084,12 +1267,7 @@ _oj_append_str(ojErr err, ojStr str, const byte *s, size_t len) {
 	    memcpy(ptr + str->len, s, len);
 	    ptr[nl] = '\0';
 	    str->s4k->next = NULL;
-	    if (NULL == s4k_head) {
-		s4k_head = str->s4k;
-	    } else {
-		s4k_tail->next = str->s4k;
-	    }
-	    s4k_tail = str->s4k;
+	    s4k_free(str->s4k, str->s4k);
 	    str->cap = cap;
 	    str->ptr = ptr;
 	}
@@ -0,0 +1,75 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "oj.h"
+#include "intern.h"
+
+// Waits spin for a while since the other thread is usually only a few
+// microseconds behind and then park on a futex so a slow callback or a
+// slow disk doesn't keep a core busy.
+
+int	oj_wait_spin = 1000;
+
+static int	cpu_cnt = 0;
+
+// Spinning can't help when the other thread needs the only CPU.
+static int
+spin_limit() {
+    if (0 == cpu_cnt) {
+	cpu_cnt = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    return (1 < cpu_cnt) ? oj_wait_spin : 0;
+}
+
+static inline void
+relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+static void
+futex_wait(atomic_uint *addr, unsigned val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void
+futex_wake(atomic_uint *addr, int cnt) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, cnt, NULL, NULL, 0);
+}
+
+void
+_oj_wait(ojPark pk, bool (*ready)(void *ctx), void *ctx) {
+    unsigned	seq;
+
+    for (int i = spin_limit(); 0 < i; i--) {
+	if (ready(ctx)) {
+	    return;
+	}
+	relax();
+    }
+    while (!ready(ctx)) {
+	// The waiter count is raised before the sequence is read so a wake
+	// after the check either changes the sequence or sees the waiter.
+	atomic_fetch_add(&pk->waiters, 1);
+	seq = atomic_load(&pk->seq);
+	if (!ready(ctx)) {
+	    futex_wait(&pk->seq, seq);
+	}
+	atomic_fetch_sub(&pk->waiters, 1);
+    }
+}
+
+void
+_oj_wake(ojPark pk) {
+    atomic_fetch_add(&pk->seq, 1);
+    if (0 < atomic_load(&pk->waiters)) {
+	futex_wake(&pk->seq, INT_MAX);
+    }
+}
@@ -61,7 +61,29 @@ build_test() {
     oj_destroy(b.top);
 }
 
+static void
+build_string_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    char		big[200];
+    char		buf[256];
+    ojVal		v;
+
+    memset(big, 'x', sizeof(big));
+    v = oj_str_create(&err, "ab", 2);
+    oj_fill(&err, v, 0, buf, sizeof(buf));
+    ut_same("\"ab\"", buf);
+
+    // Setting a string replaces any earlier one and its length.
+    oj_str_set(&err, v, big, sizeof(big));
+    ut_same_int(sizeof(big), strlen(oj_str_get(v)), "long length");
+    ut_same_int(OJ_OK, oj_str_set(&err, v, "cd", 2), "set");
+    oj_fill(&err, v, 0, buf, sizeof(buf));
+    ut_same("\"cd\"", buf);
+    oj_destroy(v);
+}
+
 void
 append_build_tests(Test tests) {
     ut_append(tests, "build", build_test);
+    ut_append(tests, "build.string", build_string_test);
 }
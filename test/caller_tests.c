@@ -0,0 +1,252 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "oj/oj.h"
+#include "oj/buf.h"
+#include "ut.h"
+
+#define DOC_CNT	20000
+
+struct _calls {
+    atomic_llong	cnt;
+    atomic_llong	sum;
+    atomic_llong	pos;
+    atomic_int		active;
+    bool		overlap;
+    long		*order;
+    long		stop_at;
+};
+
+static ojCallbackOp
+call_cb(ojVal val, void *ctx) {
+    struct _calls	*cc = (struct _calls*)ctx;
+    long		id = (long)oj_int_get(oj_object_get(val, "id", 2));
+
+    ojCallbackOp	op = OJ_DESTROY;
+
+    if (0 != atomic_fetch_add(&cc->active, 1)) {
+	cc->overlap = true;
+    }
+    if (NULL != cc->order) {
+	cc->order[atomic_fetch_add(&cc->pos, 1)] = id;
+    }
+    atomic_fetch_add(&cc->cnt, 1);
+    atomic_fetch_add(&cc->sum, id);
+    if (id == cc->stop_at) {
+	op |= OJ_STOP;
+    }
+    // Gives the other workers a chance to call back at the same time.
+    if (0 == id % 500) {
+	usleep(100);
+    }
+    atomic_fetch_sub(&cc->active, 1);
+
+    return op;
+}
+
+static char*
+call_json() {
+    struct _ojBuf	buf;
+    char		rec[128];
+    int			len;
+
+    oj_buf_init(&buf, 0);
+    for (int i = 0; i < DOC_CNT; i++) {
+	len = snprintf(rec, sizeof(rec), "{\"id\":%d,\"name\":\"doc %d\",\"list\":[%d,true,\"x\"]}\n", i, i, i);
+	oj_buf_append_string(&buf, rec, len);
+    }
+    oj_buf_append(&buf, '\0');
+    if (buf.base == buf.head) {
+	return strdup(buf.head);
+    }
+    return buf.head;
+}
+
+static void
+call_eval(int workers, bool ordered) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+    struct _calls	cc = { .stop_at = -1 };
+    char		*json = call_json();
+
+    if (ordered) {
+	cc.order = (long*)calloc(DOC_CNT, sizeof(long));
+    }
+    if (0 == workers) {
+	oj_caller_start(&err, &caller, call_cb, &cc);
+	oj_thread_safe = true;
+    } else {
+	oj_caller_start_pool(&err, &caller, workers, ordered, call_cb, &cc);
+    }
+    if (ut_handle_oj_error(&err)) {
+	free(json);
+	free(cc.order);
+	return;
+    }
+    oj_parse_str_call(&err, json, &caller);
+    oj_caller_wait(&caller);
+    if (!ut_handle_oj_error(&err)) {
+	ut_same_int(DOC_CNT, cc.cnt, "document count");
+	ut_same_int((long)DOC_CNT * (DOC_CNT - 1) / 2, cc.sum, "id sum");
+    }
+    if (ordered) {
+	// Each callback returns before the next one is made.
+	ut_true(!cc.overlap);
+	for (long i = 0; i < DOC_CNT; i++) {
+	    if (cc.order[i] != i) {
+		ut_print("document %ld called back at %ld\n", cc.order[i], i);
+		ut_true(false);
+		break;
+	    }
+	}
+	free(cc.order);
+    }
+    free(json);
+}
+
+static void
+caller_single_test() {
+    call_eval(0, false);
+}
+
+static void
+caller_pool_test() {
+    call_eval(4, false);
+    call_eval(1, false);
+}
+
+static void
+caller_pool_ordered_test() {
+    call_eval(2, true);
+    call_eval(3, true);
+    call_eval(4, true);
+}
+
+static void
+stop_eval(bool ordered) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+    struct _calls	cc = { .stop_at = 1000 };
+    char		*json = call_json();
+
+    oj_caller_start_pool(&err, &caller, 4, ordered, call_cb, &cc);
+    if (ut_handle_oj_error(&err)) {
+	free(json);
+	return;
+    }
+    oj_parse_str_call(&err, json, &caller);
+    oj_caller_wait(&caller);
+    ut_true(cc.cnt < DOC_CNT);
+    if (ordered) {
+	// Every earlier document gets a callback and no later one does.
+	ut_same_int(1001, cc.cnt, "callbacks");
+	ut_same_int(1000L * 1001 / 2, cc.sum, "id sum");
+    }
+    free(json);
+}
+
+static void
+caller_pool_stop_test() {
+    stop_eval(false);
+    stop_eval(true);
+}
+
+struct _lockstep {
+    struct _calls	cc;
+    int			wd;
+    int			cnt;
+    bool		stalled;
+};
+
+// Writes one document at a time and waits for its callback before the
+// next so an open group is only handed over at the end of a read.
+static void*
+lockstep_write(void *ctx) {
+    struct _lockstep	*ls = (struct _lockstep*)ctx;
+    char		rec[64];
+    int			len;
+
+    for (int i = 0; i < ls->cnt; i++) {
+	len = snprintf(rec, sizeof(rec), "{\"id\":%d}\n", i);
+	if (write(ls->wd, rec, len) < 0) {
+	    break;
+	}
+	for (int w = 0; atomic_load(&ls->cc.cnt) <= i; w++) {
+	    if (2000 < w) {
+		ls->stalled = true;
+		close(ls->wd);
+		return NULL;
+	    }
+	    usleep(1000);
+	}
+    }
+    close(ls->wd);
+
+    return NULL;
+}
+
+static void
+caller_group_flush_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+    struct _lockstep	ls = { .cc = { .stop_at = -1 }, .cnt = 50 };
+    int			fds[2];
+    pthread_t		t;
+
+    if (0 != pipe(fds)) {
+	ut_handle_errno();
+	return;
+    }
+    ls.wd = fds[1];
+    oj_caller_start(&err, &caller, call_cb, &ls.cc);
+    oj_thread_safe = true;
+    caller.group_usec = 1000000;
+    pthread_create(&t, NULL, lockstep_write, &ls);
+    oj_parse_fd_call(&err, fds[0], &caller);
+    oj_caller_wait(&caller);
+    pthread_join(t, NULL);
+    close(fds[0]);
+    ut_true(!ls.stalled);
+    ut_same_int(ls.cnt, ls.cc.cnt, "document count");
+}
+
+// Workers left idle long enough to park must still shut down.
+static void
+caller_shutdown_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+    struct _calls	cc = { .stop_at = -1 };
+
+    oj_caller_start(&err, &caller, call_cb, &cc);
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    usleep(50000);
+    oj_caller_shutdown(&caller);
+
+    for (int ordered = 0; ordered < 2; ordered++) {
+	oj_caller_start_pool(&err, &caller, 3, (bool)ordered, call_cb, &cc);
+	if (ut_handle_oj_error(&err)) {
+	    return;
+	}
+	usleep(50000);
+	oj_caller_shutdown(&caller);
+    }
+    ut_same_int(0, cc.cnt, "callbacks");
+}
+
+void
+append_caller_tests(Test tests) {
+    ut_append(tests, "caller.single", caller_single_test);
+    ut_append(tests, "caller.pool", caller_pool_test);
+    ut_append(tests, "caller.pool_ordered", caller_pool_ordered_test);
+    ut_append(tests, "caller.pool_stop", caller_pool_stop_test);
+    ut_append(tests, "caller.group_flush", caller_group_flush_test);
+    ut_append(tests, "caller.shutdown", caller_shutdown_test);
+}
@@ -1,6 +1,10 @@
 // Copyright (c) 2020, Peter Ohler, All rights reserved.
 
+#include <fcntl.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -131,6 +135,711 @@ chunk_decimal_test() {
     eval_data(&data);
 }
 
+static void
+chunk_top_number_test() {
+    const char		*input[] = {"  -12", "3.", "5", NULL};
+    struct _data	data = {
+	.input = input,
+	.expect = "-123.5",
+	.status = OJ_OK,
+    };
+    eval_data(&data);
+}
+
+static ojCallbackOp
+collect_cb(ojVal val, void *ctx) {
+    oj_buf((ojBuf)ctx, val, 0, 0);
+    oj_buf_append((ojBuf)ctx, '\n');
+
+    return OJ_DESTROY;
+}
+
+// Builds a file larger than the mapping limit with records that put every
+// kind of token across the small window edges. If pad is true the file is
+// padded to end exactly on a page.
+static char*
+map_file(char *path, bool pad) {
+    struct _ojBuf	buf;
+    char		rec[256];
+    char		name[64];
+    int			len;
+    int			fd;
+    char		*json;
+
+    memset(name, 'x', sizeof(name));
+    oj_buf_init(&buf, 0);
+    for (int i = 0; oj_buf_len(&buf) < 150000; i++) {
+	len = snprintf(rec, sizeof(rec),
+		       "{\"id\":%d,\"name\":\"%.*s\",\"esc\":\"a\\u00e9\\n\\\"\",\"num\":-%d.%de%d,"
+		       "\"big\":1234567890123456789012%d,\"list\":[true,false,null,[]]}\n",
+		       i, i % 61, name, i, i % 1000, i % 7, i % 10);
+	oj_buf_append_string(&buf, rec, len);
+    }
+    if (pad) {
+	for (long page = sysconf(_SC_PAGESIZE); 0 != oj_buf_len(&buf) % page; ) {
+	    oj_buf_append(&buf, ' ');
+	}
+    }
+    strcpy(path, "/tmp/oj_map_XXXXXX");
+    if (0 > (fd = mkstemp(path))) {
+	ut_handle_errno();
+	oj_buf_cleanup(&buf);
+	return NULL;
+    }
+    if (write(fd, buf.head, oj_buf_len(&buf)) < 0) {
+	ut_handle_errno();
+    }
+    close(fd);
+    oj_buf_append(&buf, '\0');
+    json = strdup(buf.head);
+    oj_buf_cleanup(&buf);
+
+    return json;
+}
+
+static void
+map_eval(bool pad, bool skip_first) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojBuf	expect;
+    struct _ojBuf	actual;
+    size_t		orig = oj_map_window;
+    char		path[64];
+    char		*json = map_file(path, pad);
+    off_t		skip = 0;
+    int			fd;
+
+    if (NULL == json) {
+	return;
+    }
+    if (skip_first) {
+	skip = strchr(json, '\n') - json + 1;
+    }
+    oj_buf_init(&expect, 0);
+    oj_buf_init(&actual, 0);
+    oj_parse_str_cb(&err, json + skip, collect_cb, &expect);
+    oj_buf_append(&expect, '\0');
+
+    oj_map_window = 1;
+    fd = open(path, O_RDONLY);
+    if (0 < skip) {
+	lseek(fd, skip, SEEK_SET);
+    }
+    oj_parse_fd_cb(&err, fd, collect_cb, &actual);
+    close(fd);
+    oj_buf_append(&actual, '\0');
+    oj_map_window = orig;
+
+    if (!ut_handle_oj_error(&err)) {
+	ut_same(expect.head, actual.head);
+    }
+    oj_buf_cleanup(&expect);
+    oj_buf_cleanup(&actual);
+    unlink(path);
+    free(json);
+}
+
+static void
+chunk_map_test() {
+    map_eval(false, false);
+}
+
+static void
+chunk_map_page_test() {
+    map_eval(true, false);
+}
+
+// The fd is left just past the first record as if the caller had already
+// read it.
+static void
+chunk_map_offset_test() {
+    map_eval(false, true);
+}
+
+// Writes cnt one line documents with increasing ids. A bad line is written
+// instead of the document at bad if bad is not negative.
+static bool
+par_file(char *path, int cnt, int bad, bool newline) {
+    struct _ojBuf	buf;
+    char		rec[256];
+    int			len;
+    int			fd;
+
+    oj_buf_init(&buf, 0);
+    for (int i = 0; i < cnt; i++) {
+	if (i == bad) {
+	    len = snprintf(rec, sizeof(rec), "{\"id\":%d,\"bad\":[1,}\n", i);
+	} else {
+	    len = snprintf(rec, sizeof(rec),
+			   "{\"id\":%d,\"name\":\"record %d\",\"vals\":[%d.5,true,null],\"sub\":{\"x\":\"%0*d\"}}\n",
+			   i, i, i, i % 150, i);
+	}
+	oj_buf_append_string(&buf, rec, len);
+    }
+    if (!newline) {
+	buf.tail--;
+    }
+    strcpy(path, "/tmp/oj_par_XXXXXX");
+    if (0 > (fd = mkstemp(path))) {
+	ut_handle_errno();
+	oj_buf_cleanup(&buf);
+	return false;
+    }
+    if (write(fd, buf.head, oj_buf_len(&buf)) < 0) {
+	ut_handle_errno();
+    }
+    close(fd);
+    oj_buf_cleanup(&buf);
+
+    return true;
+}
+
+struct _par {
+    atomic_long	cnt;
+    atomic_long	sum;
+    long	next;
+    bool	in_order;
+    long	stop_at;
+};
+
+static ojCallbackOp
+par_cb(ojVal val, void *ctx) {
+    struct _par	*pp = (struct _par*)ctx;
+    long	id = (long)oj_int_get(oj_object_get(val, "id", 2));
+
+    if (id != pp->next) {
+	pp->in_order = false;
+    }
+    pp->next = id + 1;
+    atomic_fetch_add(&pp->cnt, 1);
+    atomic_fetch_add(&pp->sum, id);
+    if (id == pp->stop_at) {
+	return OJ_STOP | OJ_DESTROY;
+    }
+    return OJ_DESTROY;
+}
+
+static void
+par_eval(int cnt, bool ordered, bool newline) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _par		pd = { .in_order = true, .stop_at = -1 };
+    char		path[64];
+
+    if (!par_file(path, cnt, -1, newline)) {
+	return;
+    }
+    oj_parse_file_parallel(&err, path, 4, ordered, par_cb, &pd);
+    if (!ut_handle_oj_error(&err)) {
+	ut_same_int(cnt, pd.cnt, "document count");
+	ut_same_int((long)cnt * (cnt - 1) / 2, pd.sum, "id sum");
+	if (ordered) {
+	    ut_true(pd.in_order);
+	}
+    }
+    unlink(path);
+}
+
+static void
+chunk_parallel_test() {
+    par_eval(40000, true, true);
+}
+
+static void
+chunk_parallel_unordered_test() {
+    par_eval(40000, false, true);
+}
+
+static void
+chunk_parallel_no_newline_test() {
+    par_eval(40000, true, false);
+    par_eval(3, false, false);
+}
+
+static void
+chunk_parallel_error_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _par		pd = { .in_order = true, .stop_at = -1 };
+    char		path[64];
+
+    if (!par_file(path, 40000, 31234, true)) {
+	return;
+    }
+    oj_parse_file_parallel(&err, path, 4, true, par_cb, &pd);
+    ut_same_int(OJ_ERR_PARSE, err.code, "error code");
+    ut_same_int(31235, err.line, "error line");
+    ut_same("unexpected character '}' in ',' mode", err.msg);
+    ut_true(pd.cnt <= 31234);
+    unlink(path);
+}
+
+static void
+chunk_parallel_stop_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _par		pd = { .in_order = true, .stop_at = 1000 };
+    char		path[64];
+
+    if (!par_file(path, 40000, -1, true)) {
+	return;
+    }
+    oj_parse_file_parallel(&err, path, 4, true, par_cb, &pd);
+    if (!ut_handle_oj_error(&err)) {
+	ut_same_int(1001, pd.cnt, "document count");
+    }
+    unlink(path);
+}
+
+// Each read mode must give the same documents. A stop or error part way
+// through has to leave the reader with reads still outstanding.
+static void
+chunk_read_modes_test() {
+    ojReadMode	modes[] = { OJ_READ_AUTO, OJ_READ_BLOCK, OJ_READ_MAP, OJ_READ_THREAD, OJ_READ_URING };
+    ojReadMode	save = oj_read_mode;
+    char	path[64];
+    char	bad_path[64];
+
+    if (!par_file(path, 40000, -1, true)) {
+	return;
+    }
+    if (!par_file(bad_path, 40000, 31234, true)) {
+	unlink(path);
+	return;
+    }
+    for (int i = 0; i < (int)(sizeof(modes) / sizeof(*modes)); i++) {
+	struct _ojErr	err = OJ_ERR_INIT;
+	struct _par	pd = { .in_order = true, .stop_at = -1 };
+
+	oj_read_mode = modes[i];
+	oj_parse_file_cb(&err, path, par_cb, &pd);
+	if (ut_handle_oj_error(&err)) {
+	    break;
+	}
+	ut_same_int(40000, pd.cnt, "document count");
+	ut_same_int(40000L * 39999 / 2, pd.sum, "id sum");
+	ut_true(pd.in_order);
+
+	memset(&pd, 0, sizeof(pd));
+	pd.stop_at = 1000;
+	oj_parse_file_cb(&err, path, par_cb, &pd);
+	if (ut_handle_oj_error(&err)) {
+	    break;
+	}
+	ut_same_int(1001, pd.cnt, "stopped document count");
+
+	memset(&pd, 0, sizeof(pd));
+	pd.stop_at = -1;
+	oj_parse_file_cb(&err, bad_path, par_cb, &pd);
+	ut_same_int(OJ_ERR_PARSE, err.code, "error code");
+	ut_same_int(31235, err.line, "error line");
+	ut_same_int(31234, pd.cnt, "documents before error");
+	oj_err_init(&err);
+    }
+    oj_read_mode = save;
+    unlink(path);
+    unlink(bad_path);
+}
+
+struct _feed {
+    const char	*path;
+    int		wd;
+};
+
+static void*
+feed_pipe(void *ctx) {
+    struct _feed	*f = (struct _feed*)ctx;
+    int			fd = open(f->path, O_RDONLY);
+    char		buf[5000];
+    ssize_t		cnt;
+
+    while (0 < (cnt = read(fd, buf, sizeof(buf)))) {
+	if (write(f->wd, buf, cnt) < 0) {
+	    break;
+	}
+    }
+    close(fd);
+    close(f->wd);
+
+    return NULL;
+}
+
+// io_uring reads need offsets so a pipe is read on a thread even when
+// io_uring is asked for.
+static void
+chunk_read_pipe_test() {
+    ojReadMode	modes[] = { OJ_READ_AUTO, OJ_READ_BLOCK, OJ_READ_MAP, OJ_READ_THREAD, OJ_READ_URING };
+    ojReadMode	save = oj_read_mode;
+    char	path[64];
+
+    if (!par_file(path, 20000, -1, true)) {
+	return;
+    }
+    for (int i = 0; i < (int)(sizeof(modes) / sizeof(*modes)); i++) {
+	struct _ojErr	err = OJ_ERR_INIT;
+	struct _par	pd = { .in_order = true, .stop_at = -1 };
+	struct _feed	f = { .path = path };
+	int		fds[2];
+	pthread_t	t;
+
+	if (0 != pipe(fds)) {
+	    ut_handle_errno();
+	    break;
+	}
+	f.wd = fds[1];
+	pthread_create(&t, NULL, feed_pipe, &f);
+	oj_read_mode = modes[i];
+	oj_parse_fd_cb(&err, fds[0], par_cb, &pd);
+	pthread_join(t, NULL);
+	close(fds[0]);
+	if (ut_handle_oj_error(&err)) {
+	    break;
+	}
+	ut_same_int(20000, pd.cnt, "document count");
+	ut_true(pd.in_order);
+    }
+    oj_read_mode = save;
+    unlink(path);
+}
+
+static ojCallbackOp
+lines_cb(ojVal val, void *ctx) {
+    return OJ_DESTROY;
+}
+
+// Writes good lines, a line longer than a read block, and then the bad
+// document to a file and returns the contents.
+static char*
+lines_file(char *path, const char *bad) {
+    struct _ojBuf	buf;
+    char		rec[64];
+    int			len;
+    int			fd;
+    char		*json;
+
+    oj_buf_init(&buf, 0);
+    for (int i = 0; i < 3000; i++) {
+	len = snprintf(rec, sizeof(rec), "{\"id\":%d, \"list\":[1, 2],  \"s\":\"abc\"}\n%s", i, (0 == i % 10) ? "\n" : "");
+	oj_buf_append_string(&buf, rec, len);
+    }
+    oj_buf_append(&buf, '[');
+    for (int i = 0; i < 5000; i++) {
+	oj_buf_append_string(&buf, "12345678,", 9);
+    }
+    oj_buf_append_string(&buf, "0]\n", 3);
+    oj_buf_append_string(&buf, bad, strlen(bad));
+    json = strdup(buf.head);
+    oj_buf_cleanup(&buf);
+
+    strcpy(path, "/tmp/oj_lines_XXXXXX");
+    if (0 > (fd = mkstemp(path))) {
+	ut_handle_errno();
+	free(json);
+	return NULL;
+    }
+    if (write(fd, json, strlen(json)) < 0) {
+	ut_handle_errno();
+    }
+    close(fd);
+
+    return json;
+}
+
+static void
+lines_check(ojErr expect, ojErr err, const char *label) {
+    if (expect->code != err->code || expect->line != err->line || expect->col != err->col) {
+	ut_print("%s: expected %d %d:%d, not %d %d:%d %s\n", label,
+		 expect->code, expect->line, expect->col, err->code, err->line, err->col, err->msg);
+	ut_fail();
+    }
+    ut_same(expect->msg, err->msg);
+}
+
+// Errors must be placed the same with or without oj_lazy_lines when the
+// input is a string, fed to a push parser, read a block at a time, or
+// split into chunks for parallel parsing. The expected position is from a
+// push parse that counts lines as it goes. Only the push parser reports a
+// document left open at the end of the input.
+static void
+chunk_lazy_lines_test() {
+    struct {
+	const char	*bad;
+	bool		one_line;
+	bool		open;
+    } cases[] = {
+	{ "{\"id\":1,\n  \"x\":[1,2}]}\n", false, false },
+	{ "{\"id\":1,\"x\":\n\n   nul}\n", false, false },
+	{ "{\"id\":1,\"x\":[\"a\\q\"]}\n", true, false },
+	{ "{\"id\":1,\"x\":[1,2]}\n  \t \n    ]\n", false, false },
+	{ "[1,2,\n3,\n", false, true },
+	{ "[1,\n nu\nll]\n", false, false },
+	{ "{\"id\":1,\"x\":tr\nue}\n", false, false },
+	{ NULL, false, false },
+    };
+    ojReadMode		modes[] = { OJ_READ_BLOCK, OJ_READ_MAP, OJ_READ_THREAD, OJ_READ_URING };
+    ojReadMode		save = oj_read_mode;
+    size_t		sizes[] = { 7, 1000, 70000 };
+    struct _ojErr	expect;
+    struct _ojErr	str_err;
+    struct _ojErr	err;
+    char		path[64];
+    char		*json;
+    size_t		len;
+    ojParser		p;
+
+    for (int i = 0; NULL != cases[i].bad; i++) {
+	if (NULL == (json = lines_file(path, cases[i].bad))) {
+	    break;
+	}
+	len = strlen(json);
+	oj_lazy_lines = false;
+	oj_err_init(&str_err);
+	if (!cases[i].open) {
+	    oj_parse_str_cb(&str_err, json, lines_cb, NULL);
+	}
+	oj_err_init(&expect);
+	p = oj_parser_create_cb(&expect, lines_cb, NULL);
+	oj_parser_feed(&expect, p, json, len);
+	oj_parser_finish(&expect, p);
+	oj_parser_destroy(p);
+	ut_same_int(OJ_ERR_PARSE, expect.code, cases[i].bad);
+	if (!cases[i].open) {
+	    lines_check(&expect, &str_err, "push");
+	}
+	for (int lazy = 0; lazy < 2; lazy++) {
+	    oj_lazy_lines = (bool)lazy;
+	    if (!cases[i].open) {
+		oj_err_init(&err);
+		oj_parse_str_cb(&err, json, lines_cb, NULL);
+		lines_check(&str_err, &err, "string");
+	    }
+	    for (size_t *sp = sizes; sp < sizes + sizeof(sizes) / sizeof(*sizes); sp++) {
+		oj_err_init(&err);
+		p = oj_parser_create_cb(&err, lines_cb, NULL);
+		for (size_t k = 0; k < len; k += *sp) {
+		    oj_parser_feed(&err, p, json + k, (len - k < *sp) ? len - k : *sp);
+		}
+		oj_parser_finish(&err, p);
+		oj_parser_destroy(p);
+		lines_check(&expect, &err, "feed");
+	    }
+	    for (ojReadMode *mp = modes; !cases[i].open && mp < modes + sizeof(modes) / sizeof(*modes); mp++) {
+		oj_read_mode = *mp;
+		oj_err_init(&err);
+		oj_parse_file_cb(&err, path, lines_cb, NULL);
+		lines_check(&expect, &err, "file");
+	    }
+	    oj_read_mode = save;
+	    if (cases[i].one_line) {
+		oj_err_init(&err);
+		oj_parse_file_parallel(&err, path, 4, true, lines_cb, NULL);
+		lines_check(&expect, &err, "parallel");
+	    }
+	}
+	oj_lazy_lines = false;
+	free(json);
+	unlink(path);
+    }
+}
+
+// Writes an array with cnt elements. The strings hold brackets, commas, and
+// escaped quotes and backslashes so a split is only correct if the string
+// state is tracked. If pretty each element is on its own line.
+static char*
+array_file(char *path, int cnt, bool pretty) {
+    struct _ojBuf	buf;
+    char		rec[512];
+    int			len;
+    int			fd;
+    char		*json;
+
+    oj_buf_init(&buf, 0);
+    oj_buf_append(&buf, '[');
+    for (int i = 0; i < cnt; i++) {
+	len = snprintf(rec, sizeof(rec),
+		       "%s%s{\"id\":%d,\"s\":\"],[{\\\",\\\\\",\"list\":[%d,\"\\\\\\\"]\",{\"a\":[]}],\"n\":%d.25}",
+		       0 < i ? "," : "", pretty ? "\n  " : "", i, i, i);
+	oj_buf_append_string(&buf, rec, len);
+	if (i % 7 == 0) {
+	    // Scalars at the top depth.
+	    len = snprintf(rec, sizeof(rec), ",%d,\"x,]\",true,null,-1.5e3", i);
+	    oj_buf_append_string(&buf, rec, len);
+	}
+    }
+    oj_buf_append_string(&buf, "]\n", 2);
+    strcpy(path, "/tmp/oj_arr_XXXXXX");
+    if (0 > (fd = mkstemp(path))) {
+	ut_handle_errno();
+	oj_buf_cleanup(&buf);
+	return NULL;
+    }
+    if (write(fd, buf.head, oj_buf_len(&buf)) < 0) {
+	ut_handle_errno();
+    }
+    close(fd);
+    oj_buf_append(&buf, '\0');
+    json = strdup(buf.head);
+    oj_buf_cleanup(&buf);
+
+    return json;
+}
+
+static void
+array_eval(bool pretty) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojReuser	reuser;
+    char		path[64];
+    char		*json = array_file(path, 20000, pretty);
+    ojVal		val;
+    char		*expect;
+    char		*actual;
+
+    if (NULL == json) {
+	return;
+    }
+    val = oj_parse_str(&err, json, NULL);
+    expect = oj_to_str(val, 0);
+    oj_destroy(val);
+
+    val = oj_parse_file_array(&err, path, 4, &reuser);
+    if (!ut_handle_oj_error(&err)) {
+	actual = oj_to_str(val, 0);
+	ut_same(expect, actual);
+	free(actual);
+	oj_reuse(&reuser);
+    }
+    free(expect);
+    free(json);
+    unlink(path);
+}
+
+static void
+chunk_array_test() {
+    array_eval(false);
+}
+
+static void
+chunk_array_pretty_test() {
+    array_eval(true);
+}
+
+static ojCallbackOp
+element_cb(ojVal val, void *ctx) {
+    struct _par	*pp = (struct _par*)ctx;
+
+    if (OJ_OBJECT == val->type) {
+	long	id = (long)oj_int_get(oj_object_get(val, "id", 2));
+
+	if (id != pp->next) {
+	    pp->in_order = false;
+	}
+	pp->next = id + 1;
+	atomic_fetch_add(&pp->sum, id);
+    }
+    atomic_fetch_add(&pp->cnt, 1);
+
+    return OJ_DESTROY;
+}
+
+static void
+chunk_array_cb_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _par		pd = { .in_order = true, .stop_at = -1 };
+    char		path[64];
+    char		*json = array_file(path, 20000, false);
+
+    if (NULL == json) {
+	return;
+    }
+    oj_parse_file_array_cb(&err, path, 4, element_cb, &pd);
+    if (!ut_handle_oj_error(&err)) {
+	ut_same_int(20000 + 2858 * 5, pd.cnt, "element count");
+	ut_same_int(20000L * 19999 / 2, pd.sum, "id sum");
+	ut_true(pd.in_order);
+    }
+    free(json);
+    unlink(path);
+}
+
+static void
+chunk_array_error_test() {
+    struct _tail {
+	const char	*tail;
+	int		line;
+	int		col;
+	const char	*msg;
+    } cases[] = {
+	{ .tail = ",[1}]\n", .line = 1, .col = 4, .msg = "unexpected object close" },
+	{ .tail = ",]\n", .line = 1, .col = 2, .msg = "unexpected character ']' in ',' mode" },
+	{ .tail = ",[1,2\n", .line = 1, .col = 6, .msg = "incomplete JSON" },
+	{ .tail = "] [3]\n", .line = 1, .col = 3, .msg = "unexpected character '[' in 'R' mode" },
+	{ .tail = NULL },
+    };
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojBuf	buf;
+    char		path[64];
+    int			fd;
+    int			col;
+
+    for (struct _tail *dp = cases; NULL != dp->tail; dp++) {
+	oj_buf_init(&buf, 0);
+	oj_buf_append(&buf, '[');
+	for (int i = 0; i < 40000; i++) {
+	    oj_buf_append_string(&buf, 0 == i ? "[1,\"a\"]" : ",[1,\"a\"]", 0 == i ? 7 : 8);
+	}
+	col = (int)oj_buf_len(&buf);
+	oj_buf_append_string(&buf, dp->tail, strlen(dp->tail));
+	strcpy(path, "/tmp/oj_arr_XXXXXX");
+	if (0 > (fd = mkstemp(path))) {
+	    ut_handle_errno();
+	    oj_buf_cleanup(&buf);
+	    return;
+	}
+	if (write(fd, buf.head, oj_buf_len(&buf)) < 0) {
+	    ut_handle_errno();
+	}
+	close(fd);
+	oj_buf_cleanup(&buf);
+
+	ut_true(NULL == oj_parse_file_array(&err, path, 4, NULL));
+	ut_same_int(OJ_ERR_PARSE, err.code, "error code");
+	ut_same_int(dp->line, err.line, "error line");
+	ut_same_int((1 == dp->line ? col : 0) + dp->col, err.col, "error column");
+	ut_same(dp->msg, err.msg);
+	oj_err_init(&err);
+	unlink(path);
+    }
+}
+
+// Small arrays and other documents take the same path.
+static void
+chunk_array_small_test() {
+    const char		*jsons[] = { " [] ", "[1]", "[[],{}]", "{\"a\":[1,2]}", "7", NULL };
+    struct _ojErr	err = OJ_ERR_INIT;
+    char		path[64];
+    int			fd;
+    ojVal		val;
+    char		*actual;
+
+    for (const char **jp = jsons; NULL != *jp; jp++) {
+	strcpy(path, "/tmp/oj_arr_XXXXXX");
+	if (0 > (fd = mkstemp(path))) {
+	    ut_handle_errno();
+	    return;
+	}
+	if (write(fd, *jp, strlen(*jp)) < 0) {
+	    ut_handle_errno();
+	}
+	close(fd);
+	val = oj_parse_file_array(&err, path, 2, NULL);
+	if (ut_handle_oj_error(&err)) {
+	    ut_print("%s failed\n", *jp);
+	    return;
+	}
+	actual = oj_to_str(val, 0);
+	ut_same(' ' == **jp ? "[]" : *jp, actual);
+	free(actual);
+	oj_destroy(val);
+	unlink(path);
+    }
+}
+
 void
 append_chunk_tests(Test tests) {
     ut_append(tests, "chunk.null", chunk_null_test);
@@ -139,4 +848,21 @@ append_chunk_tests(Test tests) {
     ut_append(tests, "chunk.string", chunk_string_test);
     ut_append(tests, "chunk.int", chunk_int_test);
     ut_append(tests, "chunk.decimal", chunk_decimal_test);
+    ut_append(tests, "chunk.top_number", chunk_top_number_test);
+    ut_append(tests, "chunk.map", chunk_map_test);
+    ut_append(tests, "chunk.map_page", chunk_map_page_test);
+    ut_append(tests, "chunk.map_offset", chunk_map_offset_test);
+    ut_append(tests, "chunk.parallel", chunk_parallel_test);
+    ut_append(tests, "chunk.parallel_unordered", chunk_parallel_unordered_test);
+    ut_append(tests, "chunk.parallel_no_newline", chunk_parallel_no_newline_test);
+    ut_append(tests, "chunk.parallel_error", chunk_parallel_error_test);
+    ut_append(tests, "chunk.parallel_stop", chunk_parallel_stop_test);
+    ut_append(tests, "chunk.read_modes", chunk_read_modes_test);
+    ut_append(tests, "chunk.read_pipe", chunk_read_pipe_test);
+    ut_append(tests, "chunk.lazy_lines", chunk_lazy_lines_test);
+    ut_append(tests, "chunk.array", chunk_array_test);
+    ut_append(tests, "chunk.array_pretty", chunk_array_pretty_test);
+    ut_append(tests, "chunk.array_cb", chunk_array_cb_test);
+    ut_append(tests, "chunk.array_error", chunk_array_error_test);
+    ut_append(tests, "chunk.array_small", chunk_array_small_test);
 }
@@ -0,0 +1,209 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj/oj.h"
+#include "oj/buf.h"
+#include "ut.h"
+
+static const char	*route_json = "{\n\
+  \"route\": \"orders/new\",\n\
+  \"meta\": {\"trace\": [1, {\"span\": \"a\\\"b\"}], \"tags\": []},\n\
+  \"id\": 12345,\n\
+  \"rate\": -2.5e-1,\n\
+  \"ok\": true,\n\
+  \"body\": {\"items\": [1, 2, 3], \"note\": \"caf\\u00e9\"}\n\
+}";
+
+// Writes the current value and everything in it using only the cursor.
+static void
+walk(ojCursor c, ojBuf buf) {
+    const char	*s;
+    int		len;
+    bool	first = true;
+    char	num[32];
+
+    switch (oj_cursor_type(c)) {
+    case OJ_OBJECT:
+	oj_buf_append(buf, '{');
+	for (bool more = oj_cursor_enter(c); more; more = oj_cursor_next(c)) {
+	    if (!first) {
+		oj_buf_append(buf, ',');
+	    }
+	    first = false;
+	    s = oj_cursor_key(c, &len);
+	    oj_buf_append(buf, '"');
+	    oj_buf_append_string(buf, s, len);
+	    oj_buf_append_string(buf, "\":", 2);
+	    walk(c, buf);
+	}
+	oj_buf_append(buf, '}');
+	break;
+    case OJ_ARRAY:
+	oj_buf_append(buf, '[');
+	for (bool more = oj_cursor_enter(c); more; more = oj_cursor_next(c)) {
+	    if (!first) {
+		oj_buf_append(buf, ',');
+	    }
+	    first = false;
+	    walk(c, buf);
+	}
+	oj_buf_append(buf, ']');
+	break;
+    case OJ_INT:
+	snprintf(num, sizeof(num), "%lld", (long long)oj_cursor_int(c));
+	oj_buf_append_string(buf, num, strlen(num));
+	break;
+    case OJ_DECIMAL:
+	snprintf(num, sizeof(num), "%g", oj_cursor_double(c));
+	oj_buf_append_string(buf, num, strlen(num));
+	break;
+    case OJ_STRING: {
+	struct _ojErr	err = OJ_ERR_INIT;
+	ojVal		v;
+	char		*str;
+
+	s = oj_cursor_str(c, &len);
+	v = oj_str_create(&err, s, len);
+	str = oj_to_str(v, 0);
+	oj_buf_append_string(buf, str, strlen(str));
+	free(str);
+	oj_destroy(v);
+	break;
+    }
+    case OJ_TRUE:
+    case OJ_FALSE:
+	if (oj_cursor_bool(c)) {
+	    oj_buf_append_string(buf, "true", 4);
+	} else {
+	    oj_buf_append_string(buf, "false", 5);
+	}
+	break;
+    default:
+	s = oj_cursor_skip(c, &len);
+	oj_buf_append_string(buf, s, len);
+	break;
+    }
+}
+
+static void
+cursor_walk_test() {
+    const char		*docs[] = {
+	"{\"a\":[1,2.5,true,false,null,\"x\"],\"b\":{},\"c\":[],\"d\":{\"e\":[[{}]]}}",
+	"[\"caf\\u00e9 \\\"q\\\" \\t\",-0,1e2,123456789012]",
+	"  \"top\"  ",
+	"7",
+	route_json,
+	NULL,
+    };
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCursor	c;
+    struct _ojBuf	buf;
+
+    for (const char **dp = docs; NULL != *dp; dp++) {
+	ojVal	val = oj_parse_str(&err, *dp, NULL);
+	char	*expect = oj_to_str(val, 0);
+
+	oj_buf_init(&buf, 0);
+	oj_cursor_init(&c, *dp);
+	walk(&c, &buf);
+	ut_false(oj_cursor_next(&c));
+	if (ut_handle_oj_error(&c.err)) {
+	    ut_print("walking %s\n", *dp);
+	} else {
+	    ut_same(expect, buf.head);
+	}
+	oj_cursor_cleanup(&c);
+	oj_buf_cleanup(&buf);
+	free(expect);
+	oj_destroy(val);
+    }
+}
+
+static void
+cursor_find_test() {
+    struct _ojCursor	c;
+    const char		*s;
+    int			len;
+
+    oj_cursor_init(&c, route_json);
+    ut_true(oj_cursor_enter(&c));
+    ut_true(oj_cursor_find(&c, "route", 5));
+    s = oj_cursor_str(&c, &len);
+    ut_same_int(10, len, "route length");
+    ut_true(0 == strncmp("orders/new", s, len));
+
+    ut_true(oj_cursor_find(&c, "id", 2));
+    ut_same_int(12345, oj_cursor_int(&c), "id");
+
+    ut_true(oj_cursor_find(&c, "rate", 4));
+    ut_true(-0.25 == oj_cursor_double(&c));
+
+    ut_true(oj_cursor_find(&c, "body", 4));
+    s = oj_cursor_skip(&c, &len);
+    ut_same_int(41, len, "body length");
+    ut_true(0 == strncmp("{\"items\": [1, 2, 3], \"note\": \"caf\\u00e9\"}", s, len));
+
+    // Forward only so an earlier key is not found.
+    ut_false(oj_cursor_find(&c, "route", 5));
+    ut_false(oj_cursor_next(&c));
+    ut_same_int(OJ_OK, c.err.code, "status");
+    oj_cursor_cleanup(&c);
+
+    // A key with escapes still matches.
+    oj_cursor_init(&c, "{\"x\":{\"y\":1},\"k\\u0065y\":\"v\\/w\"}");
+    oj_cursor_enter(&c);
+    ut_true(oj_cursor_find(&c, "key", 3));
+    s = oj_cursor_str(&c, &len);
+    ut_same("v/w", s);
+    ut_same_int(3, len, "string length");
+    oj_cursor_cleanup(&c);
+}
+
+struct _bad {
+    const char	*json;
+    int		code;
+    int		line;
+    int		col;
+    const char	*msg;
+};
+
+static void
+cursor_error_test() {
+    struct _bad		cases[] = {
+	{ "{\"a\":[1,2}],\"b\":1}", OJ_ERR_PARSE, 1, 10, "unexpected object close" },
+	{ "{\"a\":\n  [1,tru],\"b\":1}", OJ_ERR_PARSE, 2, 7, "expected true" },
+	{ "{\"a\":{\"x\" 1},\"b\":1}", OJ_ERR_PARSE, 1, 11, "unexpected character '1'" },
+	{ "{\"a\":\"x\\q\",\"b\":1}", OJ_ERR_PARSE, 1, 9, "unexpected character 'q'" },
+	{ "{\"a\":1.,\"b\":1}", OJ_ERR_PARSE, 1, 8, "unexpected character ','" },
+	{ "{\"a\":[1,2", OJ_ERR_PARSE, 1, 10, "incomplete JSON" },
+	{ "{\"a\":1,\"b\":\"s\"}", OJ_ERR_TYPE, 1, 12, "not a number" },
+	{ "{\"a\":1,\"b\":1.5}", OJ_ERR_TYPE, 1, 12, "not an integer" },
+	{ NULL },
+    };
+    struct _ojCursor	c;
+
+    for (struct _bad *bp = cases; NULL != bp->json; bp++) {
+	oj_cursor_init(&c, bp->json);
+	oj_cursor_enter(&c);
+	if (oj_cursor_find(&c, "b", 1)) {
+	    oj_cursor_int(&c);
+	}
+	ut_same_int(bp->code, c.err.code, bp->json);
+	ut_same_int(bp->line, c.err.line, "line");
+	ut_same_int(bp->col, c.err.col, "column");
+	ut_same(bp->msg, c.err.msg);
+	ut_true(OJ_NONE == oj_cursor_type(&c));
+	ut_false(oj_cursor_next(&c));
+	oj_cursor_cleanup(&c);
+    }
+}
+
+void
+append_cursor_tests(Test tests) {
+    ut_append(tests, "cursor.walk", cursor_walk_test);
+    ut_append(tests, "cursor.find", cursor_find_test);
+    ut_append(tests, "cursor.error", cursor_error_test);
+}
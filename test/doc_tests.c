@@ -0,0 +1,106 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj/oj.h"
+#include "ut.h"
+
+struct _data {
+    const char		*json;
+    ojStatus		status;
+    struct _ojErr	err;
+};
+
+// The tape is written out and compared to the same JSON parsed into an
+// ojVal tree.
+static void
+doc_parse_test() {
+    struct _data	cases[] = {
+	{.json = "null", .status = OJ_OK },
+	{.json = "[true,false,null]", .status = OJ_OK },
+	{.json = " [ 1 , -2.5 , 3e2, -0.0, 1.5e-3 ] ", .status = OJ_OK },
+	{.json = "{\"a\":{\"b\":[]},\"c\":{},\"d\":[[1],[2,[3]]]}", .status = OJ_OK },
+	{.json = "\"a\\\"b\\\\\\u00e9\"", .status = OJ_OK },
+	{.json = "[123456789012345678901234,-1.12345678901234567890123]", .status = OJ_OK },
+	{.json = "{\"a\\u0062\":\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\\t\"}", .status = OJ_OK },
+	{.json = "[1,]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 4, .msg = "unexpected character ']'"}},
+	{.json = "{\"a\":[1}", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 8, .msg = "unexpected object close"}},
+	{.json = "[\"a\\x\"]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 5, .msg = "unexpected character 'x'"}},
+	{.json = "{\"a\":1", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 7, .msg = "incomplete JSON"}},
+	{.json = "[1] [2]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 5, .msg = "unexpected character '['"}},
+	{.json = NULL }};
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojDoc		doc;
+    ojVal		val;
+    char		*expect;
+    char		*actual;
+
+    for (struct _data *dp = cases; NULL != dp->json; dp++) {
+	doc = oj_doc_parse(&err, dp->json);
+	if (OJ_OK == dp->status) {
+	    if (ut_handle_oj_error(&err)) {
+		ut_print("%s: error at %d:%d\n", dp->json, err.line, err.col);
+		return;
+	    }
+	    val = oj_parse_str(&err, dp->json, NULL);
+	    expect = oj_to_str(val, 0);
+	    actual = oj_doc_to_str(doc, oj_doc_root(doc));
+	    ut_same(expect, actual);
+	    free(expect);
+	    free(actual);
+	    oj_destroy(val);
+	} else {
+	    ut_true(NULL == doc);
+	    ut_same_int(dp->status, err.code, "error code");
+	    ut_same_int(dp->err.line, err.line, "error line");
+	    ut_same_int(dp->err.col, err.col, "error column");
+	    ut_same(dp->err.msg, err.msg);
+	    oj_err_init(&err);
+	}
+	oj_doc_destroy(doc);
+    }
+}
+
+static bool
+sum_cb(ojDoc doc, ojEntry e, void *ctx) {
+    *(int64_t*)ctx += oj_doc_int(e);
+
+    return true;
+}
+
+static void
+doc_access_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojDoc		doc = oj_doc_parse(&err, "{\"x\":[1,{\"y\":[]},2,3],\"name\":\"tape\",\"num\":1.25,\"big\":1e9999}");
+    ojEntry		root = oj_doc_root(doc);
+    ojEntry		list;
+    int64_t		sum = 0;
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    ut_same_int(OJ_OBJECT, root->type, "root type");
+    ut_same_int(4, oj_doc_len(root), "root length");
+    list = oj_doc_object_get(doc, root, "x", 1);
+    ut_same_int(OJ_ARRAY, list->type, "x type");
+    ut_same_int(4, oj_doc_len(list), "x length");
+    ut_same_int(2, oj_doc_int(oj_doc_array_nth(doc, list, 2)), "x[2]");
+    ut_same_int(OJ_OBJECT, oj_doc_array_nth(doc, list, 1)->type, "x[1] type");
+    ut_true(NULL == oj_doc_array_nth(doc, list, 4));
+    ut_same("x", oj_doc_key(doc, list));
+    ut_same("tape", oj_doc_str(doc, oj_doc_object_get(doc, root, "name", 4)));
+    ut_same_double(1.25, oj_doc_double(oj_doc_object_get(doc, root, "num", 3)), 0.0001, "num");
+    ut_same("1e9999", oj_doc_bignum(doc, oj_doc_object_get(doc, root, "big", 3)));
+    ut_true(NULL == oj_doc_object_get(doc, root, "nam", 3));
+    ut_true(NULL == oj_doc_each(doc, list, sum_cb, &sum));
+    ut_same_int(6, sum, "sum");
+
+    oj_doc_destroy(doc);
+}
+
+void
+append_doc_tests(Test tests) {
+    ut_append(tests, "doc.parse", doc_parse_test);
+    ut_append(tests, "doc.access", doc_access_test);
+}
@@ -0,0 +1,221 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj/oj.h"
+#include "oj/buf.h"
+#include "ut.h"
+
+static const char	*feed_json = "\
+{\"a\":[1,2.5,-3e2,true,false,null],\"b\":{\"c\":\"x\\\"y\\u00e9\\ud83d\\ude00\"}}\n\
+[123456789012345678901234567890, 0.5e-3]\n\
+\"just a string\" 12 -7.25\n\
+  {\"\":\"\", \"long key that is more than a few bytes\":\"long value that is more than a few bytes too\"}\n\
+42";
+
+struct _collect {
+    struct _ojBuf	buf;
+    int			cnt;
+    int			stop_at;
+};
+
+static ojCallbackOp
+collect_cb(ojVal val, void *ctx) {
+    struct _collect	*c = (struct _collect*)ctx;
+
+    oj_buf(&c->buf, val, 0, 0);
+    oj_buf_append(&c->buf, '\n');
+    c->cnt++;
+    if (c->cnt == c->stop_at) {
+	return OJ_STOP | OJ_DESTROY;
+    }
+    return OJ_DESTROY;
+}
+
+// Feeds json in pieces of size bytes and returns the status of the finish.
+static ojStatus
+feed_pieces(ojErr err, ojParser p, const char *json, size_t size) {
+    size_t	len = strlen(json);
+    size_t	n;
+    ojStatus	status = OJ_OK;
+
+    for (; 0 < len && OJ_OK == status; json += n, len -= n) {
+	n = (size < len) ? size : len;
+	status = oj_parser_feed(err, p, json, n);
+    }
+    if (OJ_OK == status) {
+	status = oj_parser_finish(err, p);
+    }
+    return status;
+}
+
+static void
+feed_split_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _collect	expect = { .stop_at = -1 };
+    struct _collect	c = { .stop_at = -1 };
+    size_t		sizes[] = { 1, 2, 3, 7, 13, 64, 100000 };
+
+    oj_buf_init(&expect.buf, 0);
+    oj_parse_str_cb(&err, feed_json, collect_cb, &expect);
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    ut_same_int(7, expect.cnt, "document count");
+
+    ojParser	p = oj_parser_create_cb(&err, collect_cb, &c);
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    // The same parser is reused for each split.
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+	oj_buf_init(&c.buf, 0);
+	c.cnt = 0;
+	feed_pieces(&err, p, feed_json, sizes[i]);
+	if (ut_handle_oj_error(&err)) {
+	    ut_print("split by %ld\n", (long)sizes[i]);
+	    break;
+	}
+	ut_same(expect.buf.head, c.buf.head);
+	oj_buf_cleanup(&c.buf);
+    }
+    oj_parser_destroy(p);
+    oj_buf_cleanup(&expect.buf);
+}
+
+static void
+feed_number_end_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _collect	c = { .stop_at = -1 };
+    ojParser		p = oj_parser_create_cb(&err, collect_cb, &c);
+
+    oj_buf_init(&c.buf, 0);
+    oj_parser_feed(&err, p, "1", 1);
+    oj_parser_feed(&err, p, "23 4", 4);
+    oj_parser_feed(&err, p, "5", 1);
+    ut_same("123\n", c.buf.head);
+    oj_parser_finish(&err, p);
+    ut_same("123\n45\n", c.buf.head);
+    oj_parser_destroy(p);
+    oj_buf_cleanup(&c.buf);
+}
+
+static void
+error_eval(const char *json, size_t size, const char *msg) {
+    struct _ojErr	expect = OJ_ERR_INIT;
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _collect	c = { .stop_at = -1 };
+    ojParser		p = oj_parser_create_cb(&err, collect_cb, &c);
+
+    oj_buf_init(&c.buf, 0);
+    oj_parse_str(&expect, json, NULL);
+    ut_same_int(OJ_ERR_PARSE, feed_pieces(&err, p, json, size), "status");
+    if (NULL != msg) {
+	ut_same(msg, err.msg);
+    } else {
+	ut_same(expect.msg, err.msg);
+	ut_same_int(expect.line, err.line, "line");
+	ut_same_int(expect.col, err.col, "column");
+    }
+    oj_parser_destroy(p);
+    oj_buf_cleanup(&c.buf);
+}
+
+static void
+feed_error_test() {
+    error_eval("[1,2,\n  3,x]", 1, NULL);
+    error_eval("{\"a\":tru}", 2, NULL);
+    error_eval("[1,2", 1, "incomplete JSON");
+    error_eval("{\"a\":\"abc", 3, "incomplete JSON");
+}
+
+static void
+feed_nul_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _collect	c = { .stop_at = -1 };
+    ojParser		p = oj_parser_create_cb(&err, collect_cb, &c);
+
+    oj_buf_init(&c.buf, 0);
+    ut_same_int(OJ_ERR_PARSE, oj_parser_feed(&err, p, "[1]\n[\0]", 7), "status");
+    ut_same("invalid JSON character 0x00", err.msg);
+    ut_same_int(2, err.line, "line");
+    ut_same("[1]\n", c.buf.head);
+    oj_parser_destroy(p);
+    oj_buf_cleanup(&c.buf);
+}
+
+static void
+feed_reset_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _collect	c = { .stop_at = 2 };
+    ojParser		p = oj_parser_create_cb(&err, collect_cb, &c);
+
+    oj_buf_init(&c.buf, 0);
+    ut_same_int(OJ_ABORT, oj_parser_feed(&err, p, "[1] [2] [3]", 11), "status");
+    ut_same_int(OJ_ABORT, oj_parser_feed(&err, p, "[4]", 3), "status");
+    ut_same("[1]\n[2]\n", c.buf.head);
+
+    oj_parser_reset(p);
+    ut_same_int(OJ_ERR_PARSE, oj_parser_feed(&err, p, "{\"a\":[1,{\"b\":x", 14), "status");
+
+    oj_err_init(&err);
+    oj_parser_reset(p);
+    c.stop_at = -1;
+    ut_same_int(OJ_OK, oj_parser_feed(&err, p, "{\"a\":[1,{\"b\":3}]}", 17), "status");
+    ut_same_int(OJ_OK, oj_parser_finish(&err, p), "status");
+    ut_same("[1]\n[2]\n{\"a\":[1,{\"b\":3}]}\n", c.buf.head);
+
+    // A partial document is dropped by a reset.
+    oj_parser_feed(&err, p, "[\"abc\",{\"d\":", 12);
+    oj_parser_reset(p);
+    oj_parser_feed(&err, p, "true", 4);
+    ut_same_int(OJ_OK, oj_parser_finish(&err, p), "status");
+    ut_same("[1]\n[2]\n{\"a\":[1,{\"b\":3}]}\ntrue\n", c.buf.head);
+
+    oj_parser_destroy(p);
+    oj_buf_cleanup(&c.buf);
+}
+
+static atomic_int	call_cnt;
+
+static ojCallbackOp
+count_cb(ojVal val, void *ctx) {
+    atomic_fetch_add(&call_cnt, 1);
+
+    return OJ_DESTROY;
+}
+
+static void
+feed_caller_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+
+    atomic_store(&call_cnt, 0);
+    oj_caller_start(&err, &caller, count_cb, NULL);
+    oj_thread_safe = true;
+
+    ojParser	p = oj_parser_create_call(&err, &caller);
+
+    for (int i = 0; i < 500; i++) {
+	feed_pieces(&err, p, feed_json, 5);
+    }
+    oj_parser_destroy(p);
+    oj_caller_wait(&caller);
+    if (!ut_handle_oj_error(&err)) {
+	ut_same_int(3500, atomic_load(&call_cnt), "document count");
+    }
+}
+
+void
+append_feed_tests(Test tests) {
+    ut_append(tests, "feed.split", feed_split_test);
+    ut_append(tests, "feed.number_end", feed_number_end_test);
+    ut_append(tests, "feed.error", feed_error_test);
+    ut_append(tests, "feed.nul", feed_nul_test);
+    ut_append(tests, "feed.reset", feed_reset_test);
+    ut_append(tests, "feed.caller", feed_caller_test);
+}
@@ -0,0 +1,269 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "oj/oj.h"
+#include "oj/buf.h"
+#include "ut.h"
+
+static const char	*log_paths[] = { "level", "timestamp", "attachment.user.id", NULL };
+
+static const char	*log_json = "\
+{\"timestamp\":\"2020-10-01T12:00:00Z\",\"host\":{\"name\":\"web-1\",\"tags\":[\"a\",\"b\",{\"c\":[]}]},\
+\"level\":\"warn\",\"msg\":\"slow \\\"request\\\" \\u00e9\\ud83d\\ude00 caf\xc3\xa9\",\
+\"nums\":[0,-1,2.5,-3.25e-2,1E10,12345678901234567890123,0.0],\"flags\":[true,false,null],\
+\"attachment\":{\"size\":12,\"user\":{\"name\":\"x\",\"id\":7,\"roles\":[\"r\"]},\"user2\":{\"id\":8}},\
+\"empty\":{},\"none\":[]}";
+
+struct _case {
+    const char	*json;
+    const char	*expect;
+};
+
+static void
+filter_eval(const char **paths, struct _case *cases) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojFilter		f = oj_filter_create(&err, paths);
+    struct _ojBuf	buf;
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    for (; NULL != cases->json; cases++) {
+	ojVal	val = oj_parse_str_filter(&err, cases->json, f, NULL);
+
+	if (ut_handle_oj_error(&err)) {
+	    ut_print("parsing %s\n", cases->json);
+	    break;
+	}
+	oj_buf_init(&buf, 0);
+	oj_buf(&buf, val, 0, 0);
+	ut_same(cases->expect, buf.head);
+	oj_buf_cleanup(&buf);
+	oj_destroy(val);
+    }
+    oj_filter_destroy(f);
+}
+
+static void
+filter_paths_test() {
+    struct _case	cases[] = {
+	{ .json = log_json,
+	  .expect = "{\"timestamp\":\"2020-10-01T12:00:00Z\",\"level\":\"warn\",\"attachment\":{\"user\":{\"id\":7}}}" },
+	{ .json = "{\"level\":{\"a\":[1,{\"b\":2}]},\"x\":1}", .expect = "{\"level\":{\"a\":[1,{\"b\":2}]}}" },
+	{ .json = "{\"x\":1}", .expect = "{}" },
+	{ .json = "{\"attachment\":7,\"level\":1}", .expect = "{\"attachment\":7,\"level\":1}" },
+	{ .json = "{\"le\\u0076el\":1,\"lev\\u0065x\":2,\"timestamp\":3}", .expect = "{\"level\":1,\"timestamp\":3}" },
+	{ .json = "[{\"level\":1,\"x\":2},3,{\"y\":[4]}]", .expect = "[{\"level\":1},3,{}]" },
+	{ .json = "12.5", .expect = "12.5" },
+	{ .json = NULL },
+    };
+    filter_eval(log_paths, cases);
+}
+
+static void
+filter_prefix_test() {
+    const char		*paths[] = { "a.b", "a", "c.d.e", NULL };
+    struct _case	cases[] = {
+	{ .json = "{\"a\":{\"b\":1,\"x\":2},\"c\":{\"d\":{\"e\":[1],\"f\":2},\"g\":3}}",
+	  .expect = "{\"a\":{\"b\":1,\"x\":2},\"c\":{\"d\":{\"e\":[1]}}}" },
+	{ .json = NULL },
+    };
+    filter_eval(paths, cases);
+
+    const char		*all[] = { "", NULL };
+    struct _case	all_cases[] = {
+	{ .json = "{\"a\":{\"b\":1},\"c\":[2]}", .expect = "{\"a\":{\"b\":1},\"c\":[2]}" },
+	{ .json = NULL },
+    };
+    filter_eval(all, all_cases);
+}
+
+static ojCallbackOp
+collect_cb(ojVal val, void *ctx) {
+    oj_buf((ojBuf)ctx, val, 0, 0);
+    oj_buf_append((ojBuf)ctx, '\n');
+
+    return OJ_DESTROY;
+}
+
+// A push parser is fed the input in pieces so every skipped value is split
+// at every place.
+static void
+filter_split_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojFilter		f = oj_filter_create(&err, log_paths);
+    struct _ojBuf	expect;
+    struct _ojBuf	buf;
+    char		json[4096];
+    size_t		len;
+
+    len = snprintf(json, sizeof(json), "%s\n%s\n{\"level\":1,\"x\":tru", log_json, log_json);
+    oj_buf_init(&expect, 0);
+    ut_same_int(OJ_ERR_PARSE, oj_parse_str_filter_cb(&err, json, f, collect_cb, &expect), "status");
+    oj_err_init(&err);
+
+    ojParser	p = oj_parser_create_cb(&err, collect_cb, &buf);
+
+    oj_parser_set_filter(p, f);
+    for (size_t size = 1; size < 40; size++) {
+	oj_buf_init(&buf, 0);
+	oj_parser_reset(p);
+	for (size_t i = 0; i < len; i += size) {
+	    oj_parser_feed(&err, p, json + i, (len - i < size) ? len - i : size);
+	}
+	if (ut_handle_oj_error(&err)) {
+	    ut_print("split by %ld\n", (long)size);
+	    break;
+	}
+	ut_same(expect.head, buf.head);
+	ut_same_int(OJ_ERR_PARSE, oj_parser_finish(&err, p), "status");
+	oj_err_init(&err);
+	oj_buf_cleanup(&buf);
+    }
+    oj_parser_destroy(p);
+    oj_buf_cleanup(&expect);
+    oj_filter_destroy(f);
+}
+
+static void
+filter_error_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojFilter		f = oj_filter_create(&err, log_paths);
+    const char		*bad[] = {
+	"{\"x\":[1,2,}],\"level\":1}",
+	"{\"x\":[1,2},\"level\":1}",
+	"{\"x\":{\"a\":1]}",
+	"{\"x\":nul,\"level\":1}",
+	"{\"x\":\"abc\\q\"}",
+	"{\"x\":1.e5}",
+	"{\"x\":[\"a\" \"b\"]}",
+	"{\"x\":[nul,1],\"level\":1}",
+	NULL,
+    };
+    for (const char **sp = bad; NULL != *sp; sp++) {
+	ojVal	val = oj_parse_str_filter(&err, *sp, f, NULL);
+
+	if (NULL != val) {
+	    ut_print("no error for %s\n", *sp);
+	    oj_destroy(val);
+	}
+	ut_same_int(OJ_ERR_PARSE, err.code, "status");
+	oj_err_init(&err);
+    }
+    oj_filter_destroy(f);
+}
+
+static ojCallbackOp
+count_cb(ojVal val, void *ctx) {
+    (*(int*)ctx)++;
+
+    return OJ_DESTROY;
+}
+
+// Input that ends in a value being skipped, often a number, is incomplete
+// and no document is given to the callback.
+static void
+filter_incomplete_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojFilter		f = oj_filter_create(&err, log_paths);
+    const char		*cases[] = {
+	"{\"c\":1",
+	"{\"level\":5,\"c\":[1.5",
+	"{\"c\":[1",
+	"{\"c\":-1e5",
+	"{\"c\":tr",
+	"{\"c\":\"ab",
+	"{\"level\":5",
+	"{\"level\":5}\n{\"c\":{\"d\":2",
+	NULL,
+    };
+    ojParser		p;
+    int			cnt;
+    int			fds[2];
+
+    for (const char **sp = cases; NULL != *sp; sp++) {
+	bool	multi = (NULL != strchr(*sp, '\n'));
+
+	if (!multi) {
+	    ojVal	val = oj_parse_str_filter(&err, *sp, f, NULL);
+
+	    ut_true(NULL == val);
+	    ut_same_int(OJ_ERR_PARSE, err.code, *sp);
+	    ut_same("incomplete JSON", err.msg);
+	    oj_err_init(&err);
+	}
+	// Only a document before the incomplete one gets a callback.
+	cnt = 0;
+	ut_same_int(OJ_ERR_PARSE, oj_parse_str_filter_cb(&err, *sp, f, count_cb, &cnt), *sp);
+	ut_same_int(multi ? 1 : 0, cnt, "callbacks");
+	oj_err_init(&err);
+
+	cnt = 0;
+	p = oj_parser_create_cb(&err, count_cb, &cnt);
+	oj_parser_set_filter(p, f);
+	oj_parser_feed(&err, p, *sp, strlen(*sp));
+	ut_same_int(OJ_ERR_PARSE, oj_parser_finish(&err, p), *sp);
+	ut_same_int(multi ? 1 : 0, cnt, "callbacks");
+	oj_parser_destroy(p);
+	oj_err_init(&err);
+
+	if (0 != pipe(fds)) {
+	    ut_handle_errno();
+	    break;
+	}
+	if (write(fds[1], *sp, strlen(*sp)) < 0) {
+	    ut_handle_errno();
+	}
+	close(fds[1]);
+	cnt = 0;
+	ut_same_int(OJ_ERR_PARSE, oj_parse_fd_filter_cb(&err, fds[0], f, count_cb, &cnt), *sp);
+	ut_same_int(multi ? 1 : 0, cnt, "callbacks");
+	close(fds[0]);
+	oj_err_init(&err);
+    }
+    oj_filter_destroy(f);
+}
+
+// An error in a skipped value is reported where the unfiltered parser
+// reports it.
+static void
+filter_error_position_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojErr	expect = OJ_ERR_INIT;
+    ojFilter		f = oj_filter_create(&err, log_paths);
+    const char		*bad[] = {
+	"{\"b\":f lse}",
+	"{\"b\":tre}",
+	"{\"b\":nu\"l}",
+	"{\"b\":[1,\n nu\nll]}",
+	"{\"b\":{\"x\":[true,fals]}}",
+	"{\"b\":[1,2}",
+	"{\"b\":\n  [1.,2]}",
+	NULL,
+    };
+    for (const char **sp = bad; NULL != *sp; sp++) {
+	oj_parse_str(&expect, *sp, NULL);
+	oj_parse_str_filter(&err, *sp, f, NULL);
+	ut_same_int(expect.code, err.code, *sp);
+	ut_same_int(expect.line, err.line, "line");
+	ut_same_int(expect.col, err.col, "column");
+	ut_same(expect.msg, err.msg);
+	oj_err_init(&err);
+	oj_err_init(&expect);
+    }
+    oj_filter_destroy(f);
+}
+
+void
+append_filter_tests(Test tests) {
+    ut_append(tests, "filter.paths", filter_paths_test);
+    ut_append(tests, "filter.prefix", filter_prefix_test);
+    ut_append(tests, "filter.split", filter_split_test);
+    ut_append(tests, "filter.error", filter_error_test);
+    ut_append(tests, "filter.incomplete", filter_incomplete_test);
+    ut_append(tests, "filter.error_position", filter_error_position_test);
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oj/oj.h"
+#include "ut.h"
+
+struct _data {
+    const char		*json;
+    const char		*expect;
+    ojStatus		status;
+    struct _ojErr	err;
+};
+
+static void
+indexed_jsons(struct _data *dp) {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojReuser	reuser;
+    ojVal		val;
+    char		*actual;
+
+    for (; NULL != dp->json; dp++) {
+	val = oj_parse_indexed(&err, dp->json, &reuser);
+	if (OJ_OK == dp->status) {
+	    if (ut_handle_oj_error(&err)) {
+		ut_print("%s: error at %d:%d\n", dp->json, err.line, err.col);
+		return;
+	    }
+	    actual = oj_to_str(val, 0);
+	    ut_same(NULL == dp->expect ? dp->json : dp->expect, actual);
+	    free(actual);
+	} else {
+	    ut_same_int(dp->status, err.code, "error code");
+	    ut_same_int(dp->err.line, err.line, "error line");
+	    ut_same_int(dp->err.col, err.col, "error column");
+	    ut_same(dp->err.msg, err.msg);
+	    oj_err_init(&err);
+	}
+	oj_reuse(&reuser);
+    }
+}
+
+static void
+indexed_parse_test() {
+    struct _data	cases[] = {
+	{.json = "null", .status = OJ_OK },
+	{.json = "[true,false,null]", .status = OJ_OK },
+	{.json = " [ 1 , -2.5 , 3e2 ] ", .expect = "[1,-2.5,300]", .status = OJ_OK },
+	{.json = "{\"a\":{\"b\":[]},\"c\":{}}", .status = OJ_OK },
+	{.json = "\"a\\\"b\\\\\\u00e9\"", .expect = "\"a\\\"b\\\\é\"", .status = OJ_OK },
+	{.json = "123456789012345678901234", .status = OJ_OK },
+	{.json = "0.12345678901234567890123", .status = OJ_OK },
+	{.json = "[1,]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 4, .msg = "unexpected character ']'"}},
+	{.json = "{\"a\":1,}", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 8, .msg = "unexpected character '}'"}},
+	{.json = "[01]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 3, .msg = "unexpected character '1'"}},
+	{.json = "[1.e3]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 4, .msg = "unexpected character 'e'"}},
+	{.json = "[\n  true,\n    nul]", .status = OJ_ERR_PARSE, .err = {.line = 3, .col = 9, .msg = "expected null"}},
+	{.json = "[truex]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 6, .msg = "unexpected character 'x'"}},
+	{.json = "{\"a\" 1}", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 6, .msg = "unexpected character '1'"}},
+	{.json = "[1}", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 3, .msg = "unexpected object close"}},
+	{.json = "\"a\x01\"", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 3, .msg = "invalid JSON character 0x01"}},
+	{.json = "\"a\xf8z\"", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 3, .msg = "invalid JSON character 0xf8"}},
+	{.json = "[1,2", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 5, .msg = "incomplete JSON"}},
+	{.json = "\"abc", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 5, .msg = "incomplete JSON"}},
+	{.json = "[1] [2]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 5, .msg = "unexpected character '['"}},
+	{.json = NULL }};
+
+    indexed_jsons(cases);
+}
+
+// Runs of backslashes and quotes are moved across the 64 byte block
+// boundaries of the index for each SIMD level and the result compared to
+// the regular parser.
+static void
+indexed_block_test() {
+    ojSimd		orig = oj_simd_get();
+    ojSimd		levels[] = { OJ_SIMD_NONE, OJ_SIMD_SSE, OJ_SIMD_AVX2 };
+    const char		*inserts[] = { "\\\\", "\\\"", "\\\\\\\"", "\",\"", "\\u00e9", "\xc3\xa9" };
+    struct _ojErr	err = OJ_ERR_INIT;
+    char		json[256];
+    char		*expect;
+    char		*actual;
+    ojVal		val;
+
+    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+	oj_simd_set(*lp);
+	for (const char **ip = inserts; ip < inserts + sizeof(inserts) / sizeof(*inserts); ip++) {
+	    for (int pos = 50; pos < 140; pos++) {
+		memset(json, ' ', pos);
+		json[0] = '[';
+		json[1] = '"';
+		memset(json + 2, 'a', pos - 2);
+		strcpy(json + pos, *ip);
+		strcat(json, "b\",{\"k\":[1,-2.5,true]}]");
+		val = oj_parse_str(&err, json, NULL);
+		expect = oj_to_str(val, 0);
+		oj_destroy(val);
+		if (NULL == (val = oj_parse_indexed(&err, json, NULL))) {
+		    ut_print("level %d: %s failed. %s\n", *lp, json, err.msg);
+		    ut_fail();
+		    free(expect);
+		    oj_simd_set(orig);
+		    return;
+		}
+		actual = oj_to_str(val, 0);
+		if (!ut_same(expect, actual)) {
+		    ut_print("level %d: %s\n", *lp, json);
+		}
+		free(expect);
+		free(actual);
+		oj_destroy(val);
+	    }
+	}
+    }
+    oj_simd_set(orig);
+}
+
+static ojCallbackOp
+count_cb(ojVal val, void *ctx) {
+    *(int*)ctx = *(int*)ctx + 1;
+
+    return OJ_DESTROY;
+}
+
+static void
+indexed_multiple_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    int			cnt = 0;
+
+    oj_parse_indexed_cb(&err, "{\"a\":1}[2]\n3 \"x\" true\n[[]]", count_cb, &cnt);
+    ut_same_int(OJ_OK, err.code, "error code");
+    ut_same_int(6, cnt, "document count");
+}
+
+void
+append_indexed_tests(Test tests) {
+    ut_append(tests, "indexed.parse", indexed_parse_test);
+    ut_append(tests, "indexed.block", indexed_block_test);
+    ut_append(tests, "indexed.multiple", indexed_multiple_test);
+}
@@ -0,0 +1,250 @@
+// Copyright (c) 2020, Peter Ohler, All rights reserved.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "oj/oj.h"
+#include "ut.h"
+
+#define CONN_CNT	40
+#define DOC_CNT		500
+
+struct _conn {
+    atomic_long		cnt;
+    atomic_long		sum;
+    atomic_int		code;
+    atomic_bool		ended;
+    int			wd;
+};
+
+static ojCallbackOp
+conn_cb(ojVal val, void *ctx) {
+    struct _conn	*c = (struct _conn*)ctx;
+
+    atomic_fetch_add(&c->cnt, 1);
+    atomic_fetch_add(&c->sum, (long)oj_int_get(oj_object_get(val, "id", 2)));
+
+    return OJ_DESTROY;
+}
+
+static void
+conn_end(int fd, ojErr err, void *ctx) {
+    struct _conn	*c = (struct _conn*)ctx;
+
+    atomic_store(&c->code, err->code);
+    atomic_store(&c->ended, true);
+}
+
+// Writes the documents to every connection a few bytes at a time taking
+// turns so the documents are split at different places on each.
+static void*
+write_conns(void *ctx) {
+    struct _conn	*conns = (struct _conn*)ctx;
+    char		rec[CONN_CNT][64];
+    int			len[CONN_CNT];
+    int			off[CONN_CNT];
+
+    for (int d = 0; d < DOC_CNT; d++) {
+	for (int i = 0; i < CONN_CNT; i++) {
+	    len[i] = snprintf(rec[i], sizeof(rec[i]), "{\"id\":%d,\"conn\":%d}\n", d, i);
+	    off[i] = 0;
+	}
+	for (bool more = true; more;) {
+	    more = false;
+	    for (int i = 0; i < CONN_CNT; i++) {
+		int	n = 1 + (d + i) % 7;
+
+		if (len[i] - off[i] < n) {
+		    n = len[i] - off[i];
+		}
+		if (0 < n && write(conns[i].wd, rec[i] + off[i], n) < 0) {
+		    return NULL;
+		}
+		off[i] += n;
+		more = more || off[i] < len[i];
+	    }
+	}
+    }
+    for (int i = 0; i < CONN_CNT; i++) {
+	close(conns[i].wd);
+    }
+    return NULL;
+}
+
+static bool
+wait_ended(struct _conn *conns, int cnt) {
+    for (int w = 0; w < 5000; w++) {
+	int	i;
+
+	for (i = 0; i < cnt && atomic_load(&conns[i].ended); i++) {
+	}
+	if (cnt <= i) {
+	    return true;
+	}
+	usleep(1000);
+    }
+    return false;
+}
+
+static struct _conn*
+conns_open(ojErr err, ojIngest ing, ojCaller caller) {
+    struct _conn	*conns = (struct _conn*)calloc(CONN_CNT, sizeof(struct _conn));
+    int			sv[2];
+
+    for (int i = 0; i < CONN_CNT; i++) {
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+	    ut_handle_errno();
+	    break;
+	}
+	conns[i].wd = sv[0];
+	if (NULL == caller) {
+	    oj_ingest_add(err, ing, sv[1], conn_cb, conn_end, conns + i);
+	} else {
+	    oj_ingest_add_call(err, ing, sv[1], caller, conn_end, conns + i);
+	}
+    }
+    return conns;
+}
+
+static void
+ingest_many_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojIngest		ing = oj_ingest_start(&err, 3);
+    struct _conn	*conns;
+    pthread_t		t;
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    conns = conns_open(&err, ing, NULL);
+    if (ut_handle_oj_error(&err)) {
+	oj_ingest_stop(ing);
+	free(conns);
+	return;
+    }
+    pthread_create(&t, NULL, write_conns, conns);
+    pthread_join(t, NULL);
+    ut_true(wait_ended(conns, CONN_CNT));
+    oj_ingest_stop(ing);
+    for (int i = 0; i < CONN_CNT; i++) {
+	ut_same_int(OJ_OK, conns[i].code, "connection status");
+	ut_same_int(DOC_CNT, conns[i].cnt, "document count");
+	ut_same_int((long)DOC_CNT * (DOC_CNT - 1) / 2, conns[i].sum, "id sum");
+    }
+    free(conns);
+}
+
+static atomic_long	call_cnt;
+
+static ojCallbackOp
+count_cb(ojVal val, void *ctx) {
+    atomic_fetch_add(&call_cnt, 1);
+
+    return OJ_DESTROY;
+}
+
+static void
+ingest_caller_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojCaller	caller;
+    ojIngest		ing = oj_ingest_start(&err, 2);
+    struct _conn	*conns;
+    pthread_t		t;
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    atomic_store(&call_cnt, 0);
+    oj_caller_start(&err, &caller, count_cb, NULL);
+    conns = conns_open(&err, ing, &caller);
+    pthread_create(&t, NULL, write_conns, conns);
+    pthread_join(t, NULL);
+    ut_true(wait_ended(conns, CONN_CNT));
+    oj_ingest_stop(ing);
+    oj_caller_wait(&caller);
+    ut_same_int((long)CONN_CNT * DOC_CNT, atomic_load(&call_cnt), "document count");
+    free(conns);
+}
+
+static void
+ingest_error_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojIngest		ing = oj_ingest_start(&err, 1);
+    struct _conn	conns[3];
+    const char		*input[3] = {
+	"{\"id\":1}\n{\"id\":2}\n",
+	"{\"id\":1}\n{\"id\":x}\n",
+	"{\"id\":1}\n{\"id\":",
+    };
+    int			sv[2];
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    memset(conns, 0, sizeof(conns));
+    for (int i = 0; i < 3; i++) {
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+	    ut_handle_errno();
+	    return;
+	}
+	oj_ingest_add(&err, ing, sv[1], conn_cb, conn_end, conns + i);
+	if (write(sv[0], input[i], strlen(input[i])) < 0) {
+	    ut_handle_errno();
+	}
+	close(sv[0]);
+    }
+    ut_true(wait_ended(conns, 3));
+    oj_ingest_stop(ing);
+    ut_same_int(OJ_OK, conns[0].code, "connection status");
+    ut_same_int(2, conns[0].cnt, "document count");
+    ut_same_int(OJ_ERR_PARSE, conns[1].code, "bad document status");
+    ut_same_int(1, conns[1].cnt, "document count");
+    ut_same_int(OJ_ERR_PARSE, conns[2].code, "incomplete document status");
+    ut_same_int(1, conns[2].cnt, "document count");
+}
+
+static void
+ingest_stop_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojIngest		ing = oj_ingest_start(&err, 2);
+    struct _conn	conns[4];
+    int			wds[4];
+    int			sv[2];
+
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    memset(conns, 0, sizeof(conns));
+    for (int i = 0; i < 4; i++) {
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+	    ut_handle_errno();
+	    return;
+	}
+	wds[i] = sv[0];
+	oj_ingest_add(&err, ing, sv[1], conn_cb, conn_end, conns + i);
+	if (write(sv[0], "{\"id\":3}", 8) < 0) {
+	    ut_handle_errno();
+	}
+    }
+    usleep(10000);
+    oj_ingest_stop(ing);
+    for (int i = 0; i < 4; i++) {
+	ut_true(conns[i].ended);
+	ut_same_int(OJ_ABORT, conns[i].code, "connection status");
+	ut_same_int(1, conns[i].cnt, "document count");
+	close(wds[i]);
+    }
+}
+
+void
+append_ingest_tests(Test tests) {
+    ut_append(tests, "ingest.many", ingest_many_test);
+    ut_append(tests, "ingest.caller", ingest_caller_test);
+    ut_append(tests, "ingest.error", ingest_error_test);
+    ut_append(tests, "ingest.stop", ingest_stop_test);
+}
@@ -7,7 +7,14 @@
 extern void	append_validate_tests(Test tests);
 extern void	append_pushpop_tests(Test tests);
 extern void	append_parse_tests(Test tests);
+extern void	append_indexed_tests(Test tests);
+extern void	append_doc_tests(Test tests);
 extern void	append_chunk_tests(Test tests);
+extern void	append_caller_tests(Test tests);
+extern void	append_feed_tests(Test tests);
+extern void	append_ingest_tests(Test tests);
+extern void	append_filter_tests(Test tests);
+extern void	append_cursor_tests(Test tests);
 extern void	append_write_tests(Test tests);
 extern void	append_build_tests(Test tests);
 
@@ -20,7 +27,14 @@ main(int argc, char **argv) {
     append_validate_tests(tests);
     append_pushpop_tests(tests);
     append_parse_tests(tests);
+    append_indexed_tests(tests);
+    append_doc_tests(tests);
     append_chunk_tests(tests);
+    append_caller_tests(tests);
+    append_feed_tests(tests);
+    append_ingest_tests(tests);
+    append_filter_tests(tests);
+    append_cursor_tests(tests);
     append_write_tests(tests);
     append_build_tests(tests);
 
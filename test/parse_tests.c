@@ -1,6 +1,10 @@
 // Copyright (c) 2020, Peter Ohler, All rights reserved.
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "oj/oj.h"
 #include "oj/buf.h"
@@ -122,6 +126,265 @@ parse_string_test() {
     parse_jsons(cases);
 }
 
+// Moves an escape, a multi-byte character, and the closing quote through
+// every offset of the vector width for each SIMD level.
+static void
+parse_string_simd_test() {
+    ojSimd		orig = oj_simd_get();
+    ojSimd		levels[] = { OJ_SIMD_NONE, OJ_SIMD_SSE, OJ_SIMD_AVX2 };
+    struct _ojErr	err = OJ_ERR_INIT;
+    char		json[128];
+    char		expect[128];
+    char		*actual;
+    ojVal		val;
+    struct _ojReuser	reuser;
+
+    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+	oj_simd_set(*lp);
+	for (int len = 0; len < 70; len++) {
+	    for (int pos = 0; pos <= len; pos++) {
+		char	*j = json;
+		char	*e = expect;
+
+		*j++ = '[';
+		*j++ = '"';
+		*e++ = '[';
+		*e++ = '"';
+		for (int i = 0; i < len; i++) {
+		    if (i == pos) {
+			if (0 == len % 2) {
+			    strcpy(j, "\\t");
+			    j += 2;
+			    strcpy(e, "\\t");
+			    e += 2;
+			} else {
+			    strcpy(j, "\xc3\xa9");
+			    j += 2;
+			    strcpy(e, "\xc3\xa9");
+			    e += 2;
+			}
+		    }
+		    *j++ = 'a' + i % 26;
+		    *e++ = 'a' + i % 26;
+		}
+		strcpy(j, "\",\"x\"]");
+		strcpy(e, "\",\"x\"]");
+		if (NULL == (val = oj_parse_str(&err, json, NULL))) {
+		    ut_print("%s: %s\n", json, err.msg);
+		    ut_fail();
+		    oj_simd_set(orig);
+		    return;
+		}
+		actual = oj_to_str(val, 0);
+		if (0 != strcmp(expect, actual)) {
+		    ut_print("level %d: expected %s, not %s\n", *lp, expect, actual);
+		    ut_fail();
+		}
+		free(actual);
+		oj_destroy(val);
+		if (OJ_OK != oj_validate_str(&err, json)) {
+		    ut_print("level %d: %s failed validation. %s\n", *lp, json, err.msg);
+		    ut_fail();
+		}
+	    }
+	}
+	// A control character must be reported at the same column for all levels.
+	memset(json, 'x', 80);
+	json[0] = '"';
+	json[50] = '\x01';
+	json[79] = '"';
+	json[80] = '\0';
+	oj_err_init(&err);
+	oj_parse_str(&err, json, &reuser);
+	oj_reuse(&reuser);
+	ut_same_int(OJ_ERR_PARSE, err.code, "control character code");
+	ut_same_int(51, err.col, "control character column");
+	oj_err_init(&err);
+    }
+    oj_simd_set(orig);
+}
+
+// Valid and invalid UTF-8 is moved through every offset of the vector width.
+// Errors must be reported the same way at every SIMD level.
+static void
+parse_utf8_simd_test() {
+    ojSimd		orig = oj_simd_get();
+    ojSimd		levels[] = { OJ_SIMD_NONE, OJ_SIMD_SSE, OJ_SIMD_AVX2 };
+    const char		*good[] = { "\xc3\xa9", "\xe6\x97\xa5\xe6\x9c\xac", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf", NULL };
+    const char		*bad[] = { "\x83", "\xe3\x81", "\xc0\x80", "\xed\xa0\x80", "\xf5\x80\x80\x80", "\xc3", NULL };
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojErr	expect[2];
+    char		json[128];
+    char		*actual;
+    ojVal		val;
+    struct _ojReuser	reuser;
+
+    for (int len = 0; len < 70; len++) {
+	for (const char **gp = good; NULL != *gp; gp++) {
+	    char	*j = json;
+
+	    *j++ = '[';
+	    *j++ = '"';
+	    memset(j, 'a', len);
+	    j += len;
+	    strcpy(j, *gp);
+	    j += strlen(*gp);
+	    strcpy(j, "z\"]");
+	    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+		oj_simd_set(*lp);
+		if (NULL == (val = oj_parse_str(&err, json, NULL))) {
+		    ut_print("level %d: %s: %s\n", *lp, json, err.msg);
+		    ut_fail();
+		    oj_simd_set(orig);
+		    return;
+		}
+		actual = oj_to_str(val, 0);
+		ut_same(json, actual);
+		free(actual);
+		oj_destroy(val);
+		ut_same_int(OJ_OK, oj_validate_str(&err, json), "validate");
+	    }
+	}
+	for (const char **bp = bad; NULL != *bp; bp++) {
+	    char	*j = json;
+
+	    *j++ = '[';
+	    *j++ = '"';
+	    memset(j, 'a', len);
+	    j += len;
+	    strcpy(j, *bp);
+	    j += strlen(*bp);
+	    strcpy(j, "z\"]");
+	    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+		oj_simd_set(*lp);
+		oj_err_init(&err);
+		oj_parse_str(&err, json, &reuser);
+		oj_reuse(&reuser);
+		if (OJ_SIMD_NONE == *lp) {
+		    expect[0] = err;
+		} else {
+		    ut_same_int(expect[0].code, err.code, "parse code");
+		    ut_same_int(expect[0].line, err.line, "parse line");
+		    ut_same_int(expect[0].col, err.col, "parse column");
+		    ut_same(expect[0].msg, err.msg);
+		}
+		oj_err_init(&err);
+		oj_validate_str(&err, json);
+		if (OJ_SIMD_NONE == *lp) {
+		    expect[1] = err;
+		} else {
+		    ut_same_int(expect[1].code, err.code, "validate code");
+		    ut_same_int(expect[1].col, err.col, "validate column");
+		}
+	    }
+	}
+    }
+    // A stray follow byte is reported where it is.
+    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+	oj_simd_set(*lp);
+	oj_err_init(&err);
+	oj_parse_str(&err, "[\"abc\x83\"]", &reuser);
+	oj_reuse(&reuser);
+	ut_same_int(OJ_ERR_PARSE, err.code, "stray code");
+	ut_same_int(6, err.col, "stray column");
+	ut_same("invalid JSON character 0x83", err.msg);
+    }
+    oj_simd_set(orig);
+}
+
+// A string that ends right before an unreadable page must not be over read.
+static void
+parse_string_page_test() {
+    long		psize = sysconf(_SC_PAGESIZE);
+    char		*page = mmap(NULL, psize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ojSimd		orig = oj_simd_get();
+    ojSimd		levels[] = { OJ_SIMD_NONE, OJ_SIMD_SSE, OJ_SIMD_AVX2 };
+    struct _ojErr	err = OJ_ERR_INIT;
+    ojVal		val;
+
+    if (MAP_FAILED == page) {
+	ut_handle_errno();
+	return;
+    }
+    mprotect(page + psize, psize, PROT_NONE);
+    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+	oj_simd_set(*lp);
+	for (int len = 1; len < 70; len++) {
+	    char	*json = page + psize - len - 3;
+
+	    json[0] = '"';
+	    memset(json + 1, 'q', len);
+	    json[len + 1] = '"';
+	    json[len + 2] = '\0';
+	    val = oj_parse_str(&err, json, NULL);
+	    ut_same_int(len, (int64_t)strlen(oj_str_get(val)), "string length");
+	    oj_destroy(val);
+	    ut_same_int(OJ_OK, oj_validate_str(&err, json), "validate");
+	    // unterminated
+	    json[len + 1] = '\0';
+	    oj_validate_str(&err, json);
+	    oj_err_init(&err);
+	}
+    }
+    oj_simd_set(orig);
+    munmap(page, psize * 2);
+}
+
+// Runs of whitespace with newlines mixed in must leave the same line and
+// column for all SIMD levels.
+static void
+parse_space_simd_test() {
+    ojSimd		orig = oj_simd_get();
+    ojSimd		levels[] = { OJ_SIMD_NONE, OJ_SIMD_SSE, OJ_SIMD_AVX2 };
+    struct _ojErr	err = OJ_ERR_INIT;
+    char		json[256];
+    struct _ojReuser	reuser;
+
+    for (ojSimd *lp = levels; lp < levels + sizeof(levels) / sizeof(*levels); lp++) {
+	oj_simd_set(*lp);
+	for (int len = 0; len < 70; len++) {
+	    for (int pos = 0; pos <= len; pos += 3) {
+		char	*j = json;
+		int	line = 1;
+		int	col;
+		char	*nl = NULL;
+
+		*j++ = '[';
+		*j++ = '1';
+		for (int i = 0; i < len; i++) {
+		    if (i == pos || i == len / 2 || i == len - 1) {
+			nl = j;
+			*j++ = '\n';
+			line++;
+		    } else {
+			*j++ = " \t\r"[i % 3];
+		    }
+		}
+		*j++ = ',';
+		*j++ = '2';
+		*j++ = ']';
+		*j = '\0';
+		ut_same_int(OJ_OK, oj_validate_str(&err, json), "validate");
+		oj_parse_str(&err, json, &reuser);
+		ut_same_int(OJ_OK, err.code, "parse");
+		oj_reuse(&reuser);
+
+		// Another close makes an error after the whitespace.
+		*j++ = ']';
+		*j = '\0';
+		col = (int)(j - (NULL == nl ? json : nl));
+		oj_parse_str(&err, json, &reuser);
+		oj_reuse(&reuser);
+		ut_same_int(OJ_ERR_PARSE, err.code, "error code");
+		ut_same_int(line, err.line, "error line");
+		ut_same_int(col, err.col, "error column");
+		oj_err_init(&err);
+	    }
+	}
+    }
+    oj_simd_set(orig);
+}
+
 static void
 parse_int_test() {
     struct _ojErr	err = OJ_ERR_INIT;
@@ -164,6 +427,277 @@ parse_decimal_test() {
     oj_destroy(val);
 }
 
+// Decimals that fit a double must match strtod() exactly.
+static void
+parse_decimal_round_test() {
+    const char	*cases[] = {
+	"0.1", "1.0", "-2.5e-3", "9007199254740993", "9007199254740993.0",
+	"2.2250738585072011e-308", "2.2250738585072014e-308", "4.9406564584124654e-324",
+	"1.7976931348623157e308", "7.3177701707893310e15", "0.31877601146700002",
+	"1e23", "8.41e21", "5e-324", "123456789012345678e-20",
+	NULL };
+    struct _ojErr	err = OJ_ERR_INIT;
+    char		str[64];
+    uint64_t		r = 7;
+    ojVal		val;
+    double		x;
+    double		d;
+
+    for (const char **cp = cases; NULL != *cp; cp++) {
+	if (NULL == (val = oj_parse_str(&err, *cp, NULL))) {
+	    ut_print("%s: %s\n", *cp, err.msg);
+	    ut_fail();
+	    return;
+	}
+	x = OJ_INT == val->type ? (double)oj_int_get(val) : (double)oj_double_get(val, true);
+	d = strtod(*cp, NULL);
+	if (!ut_true(0 == memcmp(&x, &d, sizeof(d)))) {
+	    ut_print("%s: %.17g != %.17g\n", *cp, x, d);
+	}
+	oj_destroy(val);
+    }
+    for (int i = 0; i < 10000; i++) {
+	r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+	snprintf(str, sizeof(str), "%llu.%llue%d",
+		 (unsigned long long)(r >> 44), (unsigned long long)(r & 0xFFFFFFF), (int)(r >> 20) % 300);
+	if (NULL == (val = oj_parse_str(&err, str, NULL))) {
+	    ut_print("%s: %s\n", str, err.msg);
+	    ut_fail();
+	    return;
+	}
+	x = (double)oj_double_get(val, true);
+	d = strtod(str, NULL);
+	oj_destroy(val);
+	if (0 != memcmp(&x, &d, sizeof(d))) {
+	    ut_print("%s: %.17g != %.17g\n", str, x, d);
+	    ut_fail();
+	    return;
+	}
+    }
+}
+
+static void
+parse_lazy_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    const char		*json = "[-12,3.25,-1.5e2,7,12345678901234567890123]";
+    ojVal		val;
+    ojVal		v;
+    char		*actual;
+
+    oj_lazy_num = true;
+    val = oj_parse_str(&err, json, NULL);
+    oj_lazy_num = false;
+    if (ut_handle_oj_error(&err)) {
+	return;
+    }
+    v = oj_array_nth(val, 0);
+    ut_true(!v->num.calc);
+    ut_same_int(-12, oj_int_get(v), "lazy int");
+    ut_true(v->num.calc);
+    ut_same_int(-12, oj_int_get(v), "lazy int again");
+
+    v = oj_array_nth(val, 1);
+    ut_true(!v->num.calc);
+    ut_same_double(3.25, oj_double_get(v, false), 0.0001, "lazy decimal");
+    ut_same("-150", oj_bignum_get(oj_array_nth(val, 2)));
+
+    // The rest are converted by the writer.
+    actual = oj_to_str(val, 0);
+    ut_same("[-12,3.25,-150,7,12345678901234567890123]", actual);
+    free(actual);
+    oj_destroy(val);
+
+    val = oj_parse_indexed(&err, json, NULL);
+    oj_lazy_num = true;
+    v = oj_parse_indexed(&err, json, NULL);
+    oj_lazy_num = false;
+    ut_true(!oj_array_nth(v, 3)->num.calc);
+    for (int i = 0; i < 4; i++) {
+	ut_same_double(oj_double_get(oj_array_nth(val, i), false), oj_double_get(oj_array_nth(v, i), false), 0.0001, "indexed lazy");
+	ut_same_int(oj_int_get(oj_array_nth(val, i)), oj_int_get(oj_array_nth(v, i)), "indexed lazy");
+    }
+    oj_destroy(val);
+    oj_destroy(v);
+}
+
+static void
+parse_intern_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    const char		*json = "{\"level\":1,\"msg\":{\"level\":2},\"le\\u0076elx\":3,\
+\"a_key_that_is_longer_than_sixty_four_bytes_so_that_it_is_not_interned\":4}";
+    struct _ojBuf	buf;
+    ojVal		val;
+    ojVal		v2;
+    ojVal		v3;
+    char		*expect;
+    char		*actual;
+
+    val = oj_parse_str(&err, json, NULL);
+    expect = oj_to_str(val, 0);
+    oj_destroy(val);
+
+    oj_intern_keys = true;
+    val = oj_parse_str(&err, json, NULL);
+    v2 = oj_parse_indexed(&err, json, NULL);
+    if (ut_handle_oj_error(&err)) {
+	oj_intern_keys = false;
+	free(expect);
+	return;
+    }
+    actual = oj_to_str(val, 0);
+    ut_same(expect, actual);
+    free(actual);
+    actual = oj_to_str(v2, 0);
+    ut_same(expect, actual);
+    free(actual);
+
+    // The same key in different objects and documents is shared.
+    ut_true(oj_key(oj_object_get(val, "level", 5)) == oj_key(oj_object_get(oj_object_get(val, "msg", 3), "level", 5)));
+    ut_true(oj_key(oj_object_get(val, "level", 5)) == oj_key(oj_object_get(v2, "level", 5)));
+    ut_same_int(2, oj_int_get(oj_object_get(oj_object_get(v2, "msg", 3), "level", 5)), "nested");
+    ut_same_int(4, oj_int_get(oj_object_get(val, "a_key_that_is_longer_than_sixty_four_bytes_so_that_it_is_not_interned", 69)), "long key");
+    ut_same_int(3, oj_int_get(oj_object_get(val, "levelx", 6)), "escaped key");
+    ut_true(NULL == oj_object_get(val, "lev", 3));
+    oj_destroy(v2);
+
+    // Enough keys to grow the table more than once.
+    oj_buf_init(&buf, 0);
+    oj_buf_append(&buf, '{');
+    for (int i = 0; i < 3000; i++) {
+	char	member[32];
+
+	oj_buf_append_string(&buf, member, snprintf(member, sizeof(member), "%s\"key%d\":%d", (0 < i) ? "," : "", i, i));
+    }
+    oj_buf_append(&buf, '}');
+    v3 = oj_parse_str(&err, buf.head, NULL);
+    for (int i = 0; i < 3000; i++) {
+	char	key[16];
+	int	len = snprintf(key, sizeof(key), "key%d", i);
+
+	if (i != oj_int_get(oj_object_get(v3, key, len))) {
+	    ut_same_int(i, oj_int_get(oj_object_get(v3, key, len)), "member %s", key);
+	    break;
+	}
+    }
+    oj_destroy(v3);
+    // Keys added before the table grew are still shared.
+    v3 = oj_parse_str(&err, "{\"level\":0}", NULL);
+    ut_true(oj_key(oj_object_get(val, "level", 5)) == oj_key(oj_object_get(v3, "level", 5)));
+    oj_intern_keys = false;
+
+    oj_buf_cleanup(&buf);
+    oj_destroy(v3);
+    oj_destroy(val);
+    free(expect);
+}
+
+// Writes each document and the level member found with oj_object_get().
+static ojCallbackOp
+shape_collect(ojVal val, void *ctx) {
+    ojBuf	buf = (ojBuf)ctx;
+    ojVal	level = oj_object_get(val, "level", 5);
+
+    oj_buf(buf, val, 0, 0);
+    if (NULL != level) {
+	char	num[32];
+
+	oj_buf_append_string(buf, num, snprintf(num, sizeof(num), " level=%lld", (long long)oj_int_get(level)));
+    }
+    oj_buf_append(buf, '\n');
+
+    return OJ_DESTROY;
+}
+
+// Documents that match, partly match, and don't match the keys of the ones
+// before them must come out the same as when each is parsed alone.
+static void
+parse_shape_test() {
+    const char		*docs[] = {
+	"{\"level\":1,\"msg\":\"a\",\"tags\":[{\"k\":1,\"v\":2},{\"k\":3,\"v\":4}],\"meta\":{\"host\":\"h\",\"pid\":7}}",
+	"{\"level\":2,\"msg\":\"b\",\"tags\":[{\"k\":5,\"v\":6}],\"meta\":{\"host\":\"i\",\"pid\":8}}",
+	"{\"level\":3,\"ms\":\"c\",\"tags\":[{\"k\":1}],\"meta\":{\"host\":\"h\"}}",
+	"{\"level\":4,\"msgx\":\"d\",\"tags\":[],\"meta\":{\"pid\":1,\"host\":\"x\"}}",
+	"{\"le\\u0076el\":5,\"msg\":\"e\"}",
+	"{\"\":0,\"level\":6,\"msg\":{}}",
+	"{\"a_key_that_is_longer_than_sixty_four_bytes_so_that_it_is_not_predicted\":7,\"level\":7}",
+	"{\"a_key_that_is_longer_than_sixty_four_bytes_so_that_it_is_not_predicted\":8,\"level\":8}",
+	"[{\"level\":9},{\"level\":10,\"x\":[[{\"a\":1}]]},7]",
+	"{\"level\":1,\"msg\":\"a\",\"tags\":[{\"k\":1,\"v\":2},{\"k\":3,\"v\":4}],\"meta\":{\"host\":\"h\",\"pid\":7}}",
+	NULL,
+    };
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojBuf	json;
+    struct _ojBuf	expect;
+    struct _ojBuf	buf;
+    char		member[32];
+
+    oj_buf_init(&json, 0);
+    for (const char **dp = docs; NULL != *dp; dp++) {
+	oj_buf_append_string(&json, *dp, strlen(*dp));
+	oj_buf_append(&json, '\n');
+    }
+    // More members than are predicted, twice.
+    for (int n = 0; n < 2; n++) {
+	oj_buf_append(&json, '{');
+	for (int i = 0; i < 40; i++) {
+	    oj_buf_append_string(&json, member, snprintf(member, sizeof(member), "%s\"m%d\":%d", (0 < i) ? "," : "", i, i + n));
+	}
+	oj_buf_append_string(&json, "}\n", 2);
+    }
+    // Deeper than the predictions go, twice.
+    for (int n = 0; n < 2; n++) {
+	for (int i = 0; i < 40; i++) {
+	    oj_buf_append_string(&json, "{\"a\":", 5);
+	}
+	oj_buf_append_string(&json, member, snprintf(member, sizeof(member), "{\"level\":%d}", n));
+	for (int i = 0; i < 40; i++) {
+	    oj_buf_append(&json, '}');
+	}
+	oj_buf_append(&json, '\n');
+    }
+    oj_buf_init(&expect, 0);
+    for (char *start = json.head, *end; '\0' != *start; start = end + 1) {
+	end = strchr(start, '\n');
+	*end = '\0';
+
+	ojVal	val = oj_parse_str(&err, start, NULL);
+
+	*end = '\n';
+	if (ut_handle_oj_error(&err)) {
+	    oj_buf_cleanup(&expect);
+	    oj_buf_cleanup(&json);
+	    return;
+	}
+	shape_collect(val, &expect);
+	oj_destroy(val);
+    }
+    for (int intern = 0; intern < 2; intern++) {
+	oj_intern_keys = (bool)intern;
+	oj_buf_init(&buf, 0);
+	oj_parse_str_cb(&err, json.head, shape_collect, &buf);
+	ut_handle_oj_error(&err);
+	ut_same(expect.head, buf.head);
+	oj_buf_cleanup(&buf);
+
+	// Keys cut off at the end of each piece.
+	ojParser	p = oj_parser_create_cb(&err, shape_collect, &buf);
+	size_t		len = oj_buf_len(&json);
+
+	oj_buf_init(&buf, 0);
+	for (size_t i = 0; i < len; i += 7) {
+	    oj_parser_feed(&err, p, json.head + i, (len - i < 7) ? len - i : 7);
+	}
+	oj_parser_finish(&err, p);
+	ut_handle_oj_error(&err);
+	ut_same(expect.head, buf.head);
+	oj_buf_cleanup(&buf);
+	oj_parser_destroy(p);
+    }
+    oj_intern_keys = false;
+    oj_buf_cleanup(&expect);
+    oj_buf_cleanup(&json);
+}
+
 static void
 parse_bignum_test() {
     struct _ojErr	err = OJ_ERR_INIT;
@@ -221,17 +755,99 @@ parse_invalid_test() {
     struct _data	cases[] = {
 	{.json = "{\"x\":true]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 10, .msg = "unexpected array close"}},
 	{.json = "[true}", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 6, .msg = "unexpected object close"}},
+	{.json = "]", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 1, .msg = "unexpected array close"}},
+	{.json = "1,", .status = OJ_ERR_PARSE, .err = {.line = 1, .col = 2, .msg = "unexpected comma"}},
 	{.json = NULL }};
 
     parse_jsons(cases);
 }
 
+// Strings without escapes should be left in the buffer while escaped ones
+// are decoded into the val as usual.
+static void
+parse_insitu_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojReuser	reuser;
+    char		json[6000];
+    char		*end;
+    char		*expect;
+    char		*actual;
+    ojVal		val;
+    ojVal		v;
+    const char		*s;
+    size_t		len;
+
+    strcpy(json, "{\"short\":\"abc\",\"esc\":\"a\\tb\",\"k\\u0062\":[\"x\",1],\"long\":\"");
+    len = strlen(json);
+    memset(json + len, 'a', 5000);
+    strcpy(json + len + 5000, "\"}");
+
+    val = oj_parse_str(&err, json, NULL);
+    expect = oj_to_str(val, 0);
+    oj_destroy(val);
+
+    for (int i = 0; i < 2; i++) {
+	char	copy[sizeof(json)];
+
+	strcpy(copy, json);
+	end = copy + sizeof(copy);
+	if (0 == i) {
+	    val = oj_parse_str_insitu(&err, copy, &reuser);
+	} else {
+	    char	*jp = copy;
+
+	    val = oj_parse_strp_insitu(&err, &jp, &reuser);
+	}
+	if (ut_handle_oj_error(&err)) {
+	    free(expect);
+	    return;
+	}
+	actual = oj_to_str(val, 0);
+	ut_same(expect, actual);
+	free(actual);
+
+	v = oj_object_get(val, "short", 5);
+	s = oj_str_get(v);
+	ut_same("abc", s);
+	ut_true(copy < s && s < end);
+	ut_true(copy < oj_key(v) && oj_key(v) < end);
+
+	s = oj_str_get(oj_object_get(val, "esc", 3));
+	ut_same("a\tb", s);
+	ut_true(s < copy || end <= s);
+
+	v = oj_object_get(val, "kb", 2);
+	ut_same_int(OJ_ARRAY, v->type, "kb type");
+	ut_same("x", oj_str_get(v->list.head));
+
+	v = oj_object_get(val, "long", 4);
+	ut_same_int(5000, v->str.len, "long length");
+	ut_true(copy < oj_str_get(v) && oj_str_get(v) < end);
+
+	if (0 == i) {
+	    oj_reuse(&reuser);
+	} else {
+	    oj_destroy(val);
+	}
+    }
+    free(expect);
+}
+
 void
 append_parse_tests(Test tests) {
     ut_append(tests, "parse.string", parse_string_test);
+    ut_append(tests, "parse.string.simd", parse_string_simd_test);
+    ut_append(tests, "parse.utf8.simd", parse_utf8_simd_test);
+    ut_append(tests, "parse.string.page", parse_string_page_test);
+    ut_append(tests, "parse.space.simd", parse_space_simd_test);
     ut_append(tests, "parse.int", parse_int_test);
     ut_append(tests, "parse.decimal", parse_decimal_test);
+    ut_append(tests, "parse.decimal.round", parse_decimal_round_test);
+    ut_append(tests, "parse.lazy", parse_lazy_test);
+    ut_append(tests, "parse.intern", parse_intern_test);
+    ut_append(tests, "parse.shape", parse_shape_test);
     ut_append(tests, "parse.bignum", parse_bignum_test);
     ut_append(tests, "parse.mixed", parse_mixed_test);
     ut_append(tests, "parse.invalid", parse_invalid_test);
+    ut_append(tests, "parse.insitu", parse_insitu_test);
 }
@@ -1,6 +1,10 @@
 // Copyright (c) 2020, Peter Ohler, All rights reserved.
 
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "oj/oj.h"
 #include "oj/buf.h"
@@ -128,6 +132,145 @@ validate_mixed_test() {
     validate_jsons(cases);
 }
 
+static void
+validate_incomplete_test() {
+    struct _data	cases[] = {
+	{.json = "12", .status = OJ_OK },
+	{.json = "1.5e3", .status = OJ_OK },
+	{.json = "{", .status = OJ_ERR_PARSE },
+	{.json = "[1,2", .status = OJ_ERR_PARSE },
+	{.json = "{\"a\":", .status = OJ_ERR_PARSE },
+	{.json = "\"abc", .status = OJ_ERR_PARSE },
+	{.json = "tru", .status = OJ_ERR_PARSE },
+	{.json = "1.", .status = OJ_ERR_PARSE },
+	{.json = "1,2", .status = OJ_ERR_PARSE },
+	{.json = "[1]]", .status = OJ_ERR_PARSE },
+	{.json = "]", .status = OJ_ERR_PARSE },
+	{.json = NULL }};
+
+    validate_jsons(cases);
+}
+
+static void
+validate_deep_test() {
+    struct _ojErr	err = OJ_ERR_INIT;
+    struct _ojBuf	buf;
+
+    oj_buf_init(&buf, 0);
+    for (int i = 0; i < 5000; i++) {
+	oj_buf_append_string(&buf, "[{\"a\":", 6);
+    }
+    oj_buf_append(&buf, '1');
+    for (int i = 0; i < 5000; i++) {
+	oj_buf_append_string(&buf, "}]", 2);
+    }
+    ut_same_int(OJ_OK, oj_validate_str(&err, buf.head), "deep");
+    buf.tail[-1] = '}';
+    ut_same_int(OJ_ERR_PARSE, oj_validate_str(&err, buf.head), "mismatched");
+    ut_same("unexpected object close", err.msg);
+    oj_buf_cleanup(&buf);
+}
+
+// Writes a file of documents with every kind of token so some cross the
+// edges of the blocks read. An error or a '\0' is put on the bad line.
+static char*
+validate_file(char *path, int bad, const char *bad_doc) {
+    struct _ojBuf	buf;
+    char		rec[256];
+    int			fd;
+    char		*json;
+
+    oj_buf_init(&buf, 0);
+    for (int i = 0; i < 3000; i++) {
+	if (i == bad) {
+	    oj_buf_append_string(&buf, bad_doc, strlen(bad_doc));
+	}
+	oj_buf_append_string(&buf, rec, snprintf(rec, sizeof(rec),
+						 "{\"id\":%d,\"s\":\"caf\xc3\xa9 \\u00e9\\n\\\"%*s\",\"n\":-%d.%de%d,"
+						 "\"list\":[true,false,null,[{}],12345678901234567890]}\n",
+						 i, i % 37, "", i, i % 1000, i % 7));
+    }
+    strcpy(path, "/tmp/oj_validate_XXXXXX");
+    if (0 > (fd = mkstemp(path))) {
+	ut_handle_errno();
+	oj_buf_cleanup(&buf);
+	return NULL;
+    }
+    if (write(fd, buf.head, oj_buf_len(&buf)) < 0) {
+	ut_handle_errno();
+    }
+    close(fd);
+    oj_buf_append(&buf, '\0');
+    json = strdup(buf.head);
+    oj_buf_cleanup(&buf);
+
+    return json;
+}
+
+// Every read mode must give the same result as validating the whole
+// string, including the position of an error.
+static void
+validate_fd_test() {
+    ojReadMode	modes[] = { OJ_READ_AUTO, OJ_READ_BLOCK, OJ_READ_MAP, OJ_READ_THREAD, OJ_READ_URING };
+    ojReadMode	save = oj_read_mode;
+    size_t	window = oj_map_window;
+    const char	*bad_docs[] = { "{\"a\":[1,2}\n", "[tru]\n", "{\"a\":1\n", NULL };
+    char	path[64];
+    char	*json;
+
+    oj_map_window = 1;
+    for (int i = 0; i < (int)(sizeof(modes) / sizeof(*modes)); i++) {
+	struct _ojErr	err = OJ_ERR_INIT;
+
+	oj_read_mode = modes[i];
+	if (NULL == (json = validate_file(path, -1, NULL))) {
+	    break;
+	}
+	oj_validate_file(&err, path);
+	ut_handle_oj_error(&err);
+	unlink(path);
+	free(json);
+
+	for (const char **bp = bad_docs; NULL != *bp; bp++) {
+	    struct _ojErr	expect = OJ_ERR_INIT;
+
+	    if (NULL == (json = validate_file(path, 1234, *bp))) {
+		break;
+	    }
+	    oj_validate_str(&expect, json);
+	    oj_validate_file(&err, path);
+	    ut_same_int(OJ_ERR_PARSE, err.code, "status");
+	    ut_same(expect.msg, err.msg);
+	    ut_same_int(expect.line, err.line, "line");
+	    ut_same_int(expect.col, err.col, "column");
+	    oj_err_init(&err);
+	    unlink(path);
+	    free(json);
+	}
+	// A '\0' in a file is an error rather than the end. It is at the same
+	// place as any other bad character.
+	if (NULL == (json = validate_file(path, 2000, "{#\n"))) {
+	    break;
+	}
+	struct _ojErr	expect = OJ_ERR_INIT;
+	int		fd = open(path, O_RDWR);
+
+	oj_validate_str(&expect, json);
+	if (pwrite(fd, "\0", 1, strchr(json, '#') - json) < 0) {
+	    ut_handle_errno();
+	}
+	close(fd);
+	ut_same_int(OJ_ERR_PARSE, oj_validate_file(&err, path), "nul");
+	ut_same_int(2001, err.line, "nul line");
+	ut_same_int(expect.col, err.col, "nul column");
+	oj_err_init(&err);
+	unlink(path);
+	free(json);
+    }
+    oj_read_mode = save;
+    oj_map_window = window;
+}
+
 void
 append_validate_tests(Test tests) {
     ut_append(tests, "validate.null", validate_null_test);
@@ -138,4 +281,7 @@ append_validate_tests(Test tests) {
     ut_append(tests, "validate.array", validate_array_test);
     ut_append(tests, "validate.object", validate_object_test);
     ut_append(tests, "validate.mixed", validate_mixed_test);
+    ut_append(tests, "validate.incomplete", validate_incomplete_test);
+    ut_append(tests, "validate.deep", validate_deep_test);
+    ut_append(tests, "validate.fd", validate_fd_test);
 }